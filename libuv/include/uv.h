@@ -222,6 +222,7 @@ extern "C"
   typedef struct uv_check_s uv_check_t;
   typedef struct uv_idle_s uv_idle_t;
   typedef struct uv_async_s uv_async_t;
+  typedef struct uv_channel_s uv_channel_t;
   typedef struct uv_process_s uv_process_t;
   typedef struct uv_fs_event_s uv_fs_event_t;
   typedef struct uv_fs_poll_s uv_fs_poll_t;
@@ -237,6 +238,7 @@ extern "C"
   typedef struct uv_udp_send_s uv_udp_send_t;
   typedef struct uv_fs_s uv_fs_t;
   typedef struct uv_work_s uv_work_t;
+  typedef struct uv_work_batch_s uv_work_batch_t;
 
   /* None of the above. */
   typedef struct uv_env_item_s uv_env_item_t;
@@ -246,10 +248,21 @@ extern "C"
   typedef struct uv_passwd_s uv_passwd_t;
   typedef struct uv_utsname_s uv_utsname_t;
   typedef struct uv_statfs_s uv_statfs_t;
+  typedef struct uv_metrics_s uv_metrics_t;
+  typedef struct uv_tcp_group_s uv_tcp_group_t;
+  typedef struct uv_tcp_group_options_s uv_tcp_group_options_t;
+  typedef struct uv_threadpool_s uv_threadpool_t;
+  typedef struct uv_threadpool_options_s uv_threadpool_options_t;
 
   typedef enum
   {
-    UV_LOOP_BLOCK_SIGNAL
+    UV_LOOP_BLOCK_SIGNAL,
+    UV_LOOP_USE_IO_URING,
+    UV_LOOP_USE_EDGE_TRIGGERED,
+    UV_LOOP_ENABLE_METRICS,
+    UV_LOOP_USE_TIMER_WHEEL,
+    UV_LOOP_USE_HRTIME,
+    UV_LOOP_BUSY_POLL
   } uv_loop_option;
 
   typedef enum
@@ -305,6 +318,38 @@ extern "C"
   UV_EXTERN int uv_backend_fd(const uv_loop_t *);
   UV_EXTERN int uv_backend_timeout(const uv_loop_t *);
 
+  UV_EXTERN uint64_t uv_metrics_saved_syscalls(const uv_loop_t *);
+
+  typedef enum
+  {
+    UV_LOOP_PHASE_TIMERS,
+    UV_LOOP_PHASE_PENDING,
+    UV_LOOP_PHASE_IDLE,
+    UV_LOOP_PHASE_PREPARE,
+    UV_LOOP_PHASE_POLL,
+    UV_LOOP_PHASE_CHECK,
+    UV_LOOP_PHASE_CLOSING,
+    UV_LOOP_PHASE_MAX
+  } uv_loop_phase;
+
+  struct uv_metrics_s
+  {
+    uint64_t loop_count;
+    uint64_t poll_count;
+    uint64_t events;
+    uint64_t idle_time;
+    uint64_t saved_syscalls;
+    uint64_t phase_time[UV_LOOP_PHASE_MAX];
+    uint64_t phase_callbacks[UV_LOOP_PHASE_MAX];
+    uint64_t spin_hits;
+    uint64_t spin_blocks;
+    /* private */
+    uint64_t reserved[6];
+  };
+
+  UV_EXTERN int uv_metrics_info(uv_loop_t *loop, uv_metrics_t *metrics);
+  UV_EXTERN uint64_t uv_metrics_idle_time(uv_loop_t *loop);
+
   typedef void (*uv_alloc_cb)(uv_handle_t *handle,
                               size_t suggested_size,
                               uv_buf_t *buf);
@@ -313,12 +358,18 @@ extern "C"
                              const uv_buf_t *buf);
   typedef void (*uv_write_cb)(uv_write_t *req, int status);
   typedef void (*uv_connect_cb)(uv_connect_t *req, int status);
+  typedef void (*uv_tcp_transfer_cb)(uv_tcp_t *handle, int status);
   typedef void (*uv_shutdown_cb)(uv_shutdown_t *req, int status);
   typedef void (*uv_connection_cb)(uv_stream_t *server, int status);
   typedef void (*uv_close_cb)(uv_handle_t *handle);
   typedef void (*uv_poll_cb)(uv_poll_t *handle, int status, int events);
   typedef void (*uv_timer_cb)(uv_timer_t *handle);
   typedef void (*uv_async_cb)(uv_async_t *handle);
+  typedef void (*uv_defer_cb)(uv_loop_t *loop, void *arg);
+  typedef void (*uv_channel_cb)(uv_channel_t *channel,
+                                void **msgs,
+                                unsigned int nmsgs);
+  typedef void (*uv_channel_close_cb)(uv_channel_t *channel);
   typedef void (*uv_prepare_cb)(uv_prepare_t *handle);
   typedef void (*uv_check_cb)(uv_check_t *handle);
   typedef void (*uv_idle_cb)(uv_idle_t *handle);
@@ -327,6 +378,7 @@ extern "C"
   typedef void (*uv_fs_cb)(uv_fs_t *req);
   typedef void (*uv_work_cb)(uv_work_t *req);
   typedef void (*uv_after_work_cb)(uv_work_t *req, int status);
+  typedef void (*uv_after_work_batch_cb)(uv_work_batch_t *batch);
   typedef void (*uv_getaddrinfo_cb)(uv_getaddrinfo_t *req,
                                     int status,
                                     struct addrinfo *res);
@@ -456,6 +508,7 @@ extern "C"
   UV_EXTERN int uv_is_active(const uv_handle_t *handle);
 
   UV_EXTERN void uv_walk(uv_loop_t *loop, uv_walk_cb walk_cb, void *arg);
+  UV_EXTERN int uv_loop_defer(uv_loop_t *loop, uv_defer_cb cb, void *arg);
 
   /* Helpers for ad hoc debugging, no API/ABI stability guaranteed. */
   UV_EXTERN void uv_print_all_handles(uv_loop_t *loop, FILE *stream);
@@ -557,7 +610,13 @@ extern "C"
   enum uv_tcp_flags
   {
     /* Used with uv_tcp_bind, when an IPv6 address is used. */
-    UV_TCP_IPV6ONLY = 1
+    UV_TCP_IPV6ONLY = 1,
+    /*
+     * Used with uv_tcp_bind. Sets SO_REUSEPORT (SO_REUSEPORT_LB on FreeBSD) so
+     * that several sockets can listen on the same address, with the kernel
+     * spreading incoming connections across them.
+     */
+    UV_TCP_REUSEPORT = 2
   };
 
   UV_EXTERN int uv_tcp_bind(uv_tcp_t *handle,
@@ -570,6 +629,9 @@ extern "C"
                                    struct sockaddr *name,
                                    int *namelen);
   UV_EXTERN int uv_tcp_close_reset(uv_tcp_t *handle, uv_close_cb close_cb);
+  UV_EXTERN int uv_tcp_transfer(uv_tcp_t *handle,
+                                uv_loop_t *loop,
+                                uv_tcp_transfer_cb cb);
   UV_EXTERN int uv_tcp_connect(uv_connect_t *req,
                                uv_tcp_t *handle,
                                const struct sockaddr *addr,
@@ -584,6 +646,52 @@ extern "C"
     UV_CONNECT_PRIVATE_FIELDS
   };
 
+  /*
+ * Listener group: one SO_REUSEPORT listen socket and loop per thread.
+ */
+
+  enum uv_tcp_group_flags
+  {
+    /* Pin the thread of loop N to the N-th CPU the process may run on. */
+    UV_TCP_GROUP_PIN_THREADS = 1,
+    /*
+     * Hand each connection to the loop that runs on the CPU that received it.
+     * Implies UV_TCP_GROUP_PIN_THREADS.
+     */
+    UV_TCP_GROUP_STEER_CPU = 2
+  };
+
+  typedef void (*uv_tcp_group_loop_cb)(uv_tcp_group_t *group,
+                                       uv_loop_t *loop,
+                                       unsigned int index);
+
+  struct uv_tcp_group_options_s
+  {
+    unsigned int flags;
+    unsigned int nloops;      /* 0 means one loop per available CPU. */
+    int backlog;              /* 0 means SOMAXCONN. */
+    unsigned int bind_flags;  /* Extra uv_tcp_bind() flags. */
+    uv_tcp_group_loop_cb loop_cb;
+    /* More fields may be added at any time. */
+  };
+
+  struct uv_tcp_group_s
+  {
+    void *data;
+    /* read-only */
+    unsigned int nloops;
+    /* private */
+    void *members;
+    uv_connection_cb connection_cb;
+    uv_tcp_group_loop_cb loop_cb;
+  };
+
+  UV_EXTERN int uv_tcp_group_start(uv_tcp_group_t *group,
+                                   const struct sockaddr *addr,
+                                   const uv_tcp_group_options_t *options,
+                                   uv_connection_cb cb);
+  UV_EXTERN int uv_tcp_group_stop(uv_tcp_group_t *group);
+
   /*
  * UDP support.
  */
@@ -822,6 +930,24 @@ extern "C"
                               uv_async_cb async_cb);
   UV_EXTERN int uv_async_send(uv_async_t *async);
 
+  /*
+ * uv_channel_t is opaque and allocated by libuv, it is not a handle.
+ *
+ * A queue of pointers that any thread can send to. The loop thread receives
+ * them in batches.
+ */
+  UV_EXTERN int uv_channel_create(uv_loop_t *loop,
+                                  uv_channel_t **channel,
+                                  size_t capacity,
+                                  uv_channel_cb channel_cb);
+  UV_EXTERN int uv_channel_send(uv_channel_t *channel, void *msg);
+  UV_EXTERN int uv_channel_send_wait(uv_channel_t *channel, void *msg);
+  UV_EXTERN void uv_channel_close(uv_channel_t *channel,
+                                  uv_channel_close_cb close_cb);
+  UV_EXTERN uv_loop_t *uv_channel_get_loop(const uv_channel_t *channel);
+  UV_EXTERN void *uv_channel_get_data(const uv_channel_t *channel);
+  UV_EXTERN void uv_channel_set_data(uv_channel_t *channel, void *data);
+
   /*
  * uv_timer_t is a subclass of uv_handle_t.
  *
@@ -838,10 +964,16 @@ extern "C"
                                uv_timer_cb cb,
                                uint64_t timeout,
                                uint64_t repeat);
+  UV_EXTERN int uv_timer_start_ns(uv_timer_t *handle,
+                                  uv_timer_cb cb,
+                                  uint64_t timeout,
+                                  uint64_t repeat);
   UV_EXTERN int uv_timer_stop(uv_timer_t *handle);
   UV_EXTERN int uv_timer_again(uv_timer_t *handle);
   UV_EXTERN void uv_timer_set_repeat(uv_timer_t *handle, uint64_t repeat);
   UV_EXTERN uint64_t uv_timer_get_repeat(const uv_timer_t *handle);
+  UV_EXTERN void uv_timer_set_slack(uv_timer_t *handle, uint64_t slack);
+  UV_EXTERN uint64_t uv_timer_get_slack(const uv_timer_t *handle);
 
   /*
  * uv_getaddrinfo_t is a subclass of uv_req_t.
@@ -1050,8 +1182,181 @@ extern "C"
                               uv_work_cb work_cb,
                               uv_after_work_cb after_work_cb);
 
+  typedef enum
+  {
+    UV_WORK_PRIORITY_HIGH,
+    UV_WORK_PRIORITY_NORMAL,
+    UV_WORK_PRIORITY_LOW
+  } uv_work_priority;
+
+  typedef struct uv_work_options_s
+  {
+    uv_work_priority priority;
+    /* Milliseconds the work may wait in the queue, 0 means no limit. */
+    uint64_t timeout;
+    /* More fields may be added at any time. */
+  } uv_work_options_t;
+
+  UV_EXTERN int uv_queue_work_ex(uv_loop_t *loop,
+                                 uv_work_t *req,
+                                 const uv_work_options_t *options,
+                                 uv_work_cb work_cb,
+                                 uv_after_work_cb after_work_cb);
+
+  struct uv_work_batch_s
+  {
+    void *data;
+    /* read-only */
+    unsigned int nreqs;
+    /* Requests that completed with an error, e.g. UV_ECANCELED. */
+    unsigned int nfailed;
+    /* private */
+    unsigned int npending;
+    uv_after_work_batch_cb batch_cb;
+  };
+
+  UV_EXTERN int uv_queue_work_batch(uv_loop_t *loop,
+                                    uv_work_t *reqs[],
+                                    unsigned int nreqs,
+                                    const uv_work_options_t *options,
+                                    uv_work_cb work_cb,
+                                    uv_after_work_cb after_work_cb,
+                                    uv_work_batch_t *batch,
+                                    uv_after_work_batch_cb batch_cb);
+
   UV_EXTERN int uv_cancel(uv_req_t *req);
 
+  /*
+ * Thread pools a loop can send its work to instead of the global one.
+ */
+
+  typedef enum
+  {
+    UV_WORK_CPU,      /* uv_queue_work() */
+    UV_WORK_FAST_IO,  /* uv_fs_*() and the other file system requests. */
+    UV_WORK_SLOW_IO,  /* uv_getaddrinfo() and uv_getnameinfo() */
+    UV_WORK_KIND_MAX
+  } uv_work_kind;
+
+  enum uv_threadpool_flags
+  {
+    /*
+     * Give every thread its own queue and let idle threads steal work from
+     * busy ones, instead of sharing one queue and lock between all threads.
+     */
+    UV_THREADPOOL_WORK_STEALING = 1,
+    /*
+     * Start min_threads threads, start more when work queues up, up to
+     * nthreads, and stop the extra ones again after they were idle for a
+     * while. Can't be combined with UV_THREADPOOL_WORK_STEALING.
+     */
+    UV_THREADPOOL_ELASTIC = 2,
+    /*
+     * Time how long work waits in the queue and runs, see
+     * uv_threadpool_metrics().
+     */
+    UV_THREADPOOL_ENABLE_METRICS = 4,
+    /*
+     * Pin every thread to one of the CPUs the process may run on, spread
+     * round-robin over the NUMA nodes.
+     */
+    UV_THREADPOOL_PIN_THREADS = 8,
+    /*
+     * Hand work to a thread on the NUMA node of the submitting thread.
+     * Implies UV_THREADPOOL_PIN_THREADS, needs UV_THREADPOOL_WORK_STEALING.
+     */
+    UV_THREADPOOL_NUMA_LOCAL = 16,
+    /*
+     * Let threads that run out of work spin for spin_us before they sleep,
+     * work submitted meanwhile doesn't have to wake a thread.
+     */
+    UV_THREADPOOL_SPIN = 32
+  };
+
+  struct uv_threadpool_options_s
+  {
+    unsigned int flags;
+    unsigned int nthreads;  /* 0 means 4. */
+    const char *name;       /* Name of the worker threads, may be NULL. */
+    /* Only used with UV_THREADPOOL_ELASTIC. */
+    unsigned int min_threads;
+    unsigned int grow_queue_depth;  /* 0 means 1. */
+    unsigned int grow_wait_ms;      /* 0 means don't grow on wait time. */
+    unsigned int idle_timeout_ms;   /* 0 means 10000. */
+    /* Share of the threads slow I/O work may use, in percent. 0 means 50. */
+    unsigned int slow_io_percent;
+    /* Only used with UV_THREADPOOL_SPIN. 0 means 50. */
+    unsigned int spin_us;
+    /* More fields may be added at any time. */
+  };
+
+  struct uv_threadpool_s
+  {
+    void *data;
+    /* read-only */
+    unsigned int nthreads;  /* Maximum number of threads. */
+    /* private */
+    void *internal;
+  };
+
+  UV_EXTERN int uv_threadpool_init(uv_threadpool_t *pool,
+                                   const uv_threadpool_options_t *options);
+  UV_EXTERN int uv_threadpool_close(uv_threadpool_t *pool);
+  UV_EXTERN int uv_threadpool_set_limits(uv_threadpool_t *pool,
+                                         unsigned int min_threads,
+                                         unsigned int max_threads);
+  UV_EXTERN unsigned int
+  uv_threadpool_running_threads(const uv_threadpool_t *pool);
+  UV_EXTERN int uv_loop_set_threadpool(uv_loop_t *loop,
+                                       uv_work_kind kind,
+                                       uv_threadpool_t *pool);
+  UV_EXTERN uv_threadpool_t *uv_loop_get_threadpool(const uv_loop_t *loop,
+                                                    uv_work_kind kind);
+
+#define UV_WORK_HISTOGRAM_BUCKETS 32
+
+  /*
+   * buckets[0] counts times under 1 us, buckets[i] times from 2^(i-1) us up
+   * to 2^i us, and the last bucket everything longer.
+   */
+  typedef struct uv_work_histogram_s
+  {
+    uint64_t count;
+    uint64_t total;  /* Nanoseconds. */
+    uint64_t max;    /* Nanoseconds. */
+    uint64_t buckets[UV_WORK_HISTOGRAM_BUCKETS];
+  } uv_work_histogram_t;
+
+  typedef struct uv_threadpool_metrics_s
+  {
+    /* Only with UV_THREADPOOL_ENABLE_METRICS. */
+    uv_work_histogram_t queue_time[UV_WORK_KIND_MAX];
+    uv_work_histogram_t run_time[UV_WORK_KIND_MAX];
+    /* Current values. */
+    unsigned int queued;  /* Including slow_io_queued. */
+    unsigned int slow_io_queued;
+    unsigned int slow_io_running;
+    unsigned int idle_threads;
+    unsigned int threads;
+  } uv_threadpool_metrics_t;
+
+  UV_EXTERN int uv_threadpool_metrics(const uv_threadpool_t *pool,
+                                      uv_threadpool_metrics_t *metrics);
+
+  typedef struct uv_work_timing_s
+  {
+    uv_work_kind kind;
+    uint64_t queue_time;  /* Submitted until a thread took it, in ns. */
+    uint64_t run_time;    /* Ran on the thread, in ns. */
+    uint64_t done_time;   /* Finished until the loop picked it up, in ns. */
+  } uv_work_timing_t;
+
+  typedef void (*uv_work_timing_cb)(uv_req_t *req,
+                                    const uv_work_timing_t *timing);
+
+  UV_EXTERN int uv_loop_set_work_timing_cb(uv_loop_t *loop,
+                                           uv_work_timing_cb cb);
+
   struct uv_cpu_times_s
   {
     uint64_t user;
@@ -1688,13 +1993,32 @@ extern "C"
   typedef enum
   {
     UV_THREAD_NO_FLAGS = 0x00,
-    UV_THREAD_HAS_STACK_SIZE = 0x01
+    UV_THREAD_HAS_STACK_SIZE = 0x01,
+    UV_THREAD_HAS_AFFINITY = 0x02,
+    UV_THREAD_HAS_NAME = 0x04,
+    UV_THREAD_HAS_SCHED = 0x08
   } uv_thread_create_flags;
 
+  typedef enum
+  {
+    UV_THREAD_SCHED_OTHER,
+    UV_THREAD_SCHED_BATCH,  /* Linux only. */
+    UV_THREAD_SCHED_IDLE,   /* Linux only. */
+    UV_THREAD_SCHED_FIFO,
+    UV_THREAD_SCHED_RR
+  } uv_thread_sched_policy;
+
   struct uv_thread_options_s
   {
     unsigned int flags;
     size_t stack_size;
+    /* CPUs the thread may run on, cpumask[i] != 0 allows CPU i. */
+    const char *cpumask;
+    size_t mask_size;  /* At least uv_cpumask_size(). */
+    /* Truncated to 15 characters, only used on Linux. */
+    const char *name;
+    uv_thread_sched_policy sched_policy;
+    int sched_priority;
     /* More fields may be added at any time. */
   };
 
@@ -1707,6 +2031,15 @@ extern "C"
   UV_EXTERN uv_thread_t uv_thread_self(void);
   UV_EXTERN int uv_thread_join(uv_thread_t *tid);
   UV_EXTERN int uv_thread_equal(const uv_thread_t *t1, const uv_thread_t *t2);
+  UV_EXTERN int uv_cpumask_size(void);
+  UV_EXTERN int uv_thread_setaffinity(uv_thread_t *tid,
+                                      char *cpumask,
+                                      char *oldmask,
+                                      size_t mask_size);
+  UV_EXTERN int uv_thread_getaffinity(uv_thread_t *tid,
+                                      char *cpumask,
+                                      size_t mask_size);
+  UV_EXTERN int uv_thread_getcpu(void);
 
 /* The presence of these unions force similar struct layout. */
 #define XX(_, name) uv_##name##_t name;
@@ -1731,9 +2064,11 @@ extern "C"
     void *handle_queue[2];
     // 活动请求
     union {
-      void *unused[2];
+      void *unused;
       unsigned int count;
     } active_reqs;
+    /* Internal storage for future extensions. */
+    void *internal_fields;
     /* Internal flag to signal loop stop. */
     // 主循环是否停止
     unsigned int stop_flag;
@@ -246,7 +246,7 @@ typedef struct {
   struct {                                                                    \
     void* min;                                                   \
     unsigned int nelts;                                                       \
-  } timer_heap;    /* 定时器堆*/                                                           \
+  } timer_heap;    /* 未使用，仅为保持 ABI 兼容 */                                          \
   uint64_t timer_counter;                                                     \
   uint64_t time;                                                              \
   int signal_pipefd[2];                                                       \
@@ -0,0 +1,403 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Messages are handed to the callback in chunks of at most this many. */
+#define UV__CHANNEL_BATCH 256
+
+#if defined(_WIN32)
+#define uv__channel_fetch_add(p, v) \
+  ((unsigned int)InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v)))
+#define uv__channel_cas_ptr(p, o, n) \
+  ((struct channel_node *)InterlockedCompareExchangePointer( \
+      (PVOID volatile *)(p), (PVOID)(n), (PVOID)(o)))
+#if defined(_WIN64)
+#define uv__channel_cas_size(p, o, n) \
+  ((size_t)InterlockedCompareExchange64( \
+      (LONG64 volatile *)(p), (LONG64)(n), (LONG64)(o)))
+#else
+#define uv__channel_cas_size(p, o, n) \
+  ((size_t)InterlockedCompareExchange( \
+      (LONG volatile *)(p), (LONG)(n), (LONG)(o)))
+#endif
+#define uv__channel_barrier() MemoryBarrier()
+#else
+#define uv__channel_fetch_add(p, v) __sync_fetch_and_add((p), (v))
+#define uv__channel_cas_ptr(p, o, n) __sync_val_compare_and_swap((p), (o), (n))
+#define uv__channel_cas_size(p, o, n) __sync_val_compare_and_swap((p), (o), (n))
+#define uv__channel_barrier() __sync_synchronize()
+#endif
+
+/* Bounded channels use a ring of cells where `seq` says whose turn it is:
+ * a cell can be written at position `pos` when seq == pos and read when
+ * seq == pos + 1. Reading it sets seq to pos + capacity, the position of
+ * the next lap.
+ */
+struct channel_cell {
+  size_t volatile seq;
+  void* msg;
+};
+
+/* Unbounded channels push nodes on a lock-free stack. The loop thread takes
+ * the whole stack at once and reverses it into send order.
+ */
+struct channel_node {
+  struct channel_node* next;
+  void* msg;
+};
+
+/* A channel isn't a handle, so that adding it didn't change the handle
+ * types. The loop only sees its internal async handle, which keeps the
+ * loop alive until the channel is closed.
+ */
+struct uv_channel_s {
+  void* data;
+  uv_channel_cb channel_cb;
+  uv_channel_close_cb close_cb;
+  uv_async_t async_handle;
+  size_t capacity;
+  struct channel_cell* cells;
+  size_t volatile send_pos;
+  size_t recv_pos;
+  struct channel_node* volatile nodes;
+  /* Senders blocked in uv_channel_send_wait(). */
+  unsigned int volatile waiters;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  void* batch[UV__CHANNEL_BATCH];
+};
+
+static void channel_async_cb(uv_async_t* async);
+static void channel_close_cb(uv_handle_t* async);
+
+
+int uv_channel_create(uv_loop_t* loop,
+                      uv_channel_t** channel,
+                      size_t capacity,
+                      uv_channel_cb channel_cb) {
+  uv_channel_t* ch;
+  size_t i;
+  int err;
+
+  if (channel == NULL || channel_cb == NULL)
+    return UV_EINVAL;
+
+  if (capacity > SIZE_MAX / 2 / sizeof(*ch->cells))
+    return UV_EINVAL;
+
+  ch = uv__calloc(1, sizeof(*ch));
+  if (ch == NULL)
+    return UV_ENOMEM;
+
+  if (capacity > 0) {
+    ch->cells = uv__malloc(capacity * sizeof(*ch->cells));
+    if (ch->cells == NULL) {
+      err = UV_ENOMEM;
+      goto error;
+    }
+
+    for (i = 0; i < capacity; i++)
+      ch->cells[i].seq = i;
+  }
+
+  ch->channel_cb = channel_cb;
+  ch->capacity = capacity;
+
+  err = uv_mutex_init(&ch->mutex);
+  if (err < 0)
+    goto error;
+
+  err = uv_cond_init(&ch->cond);
+  if (err < 0)
+    goto error_cond;
+
+  err = uv_async_init(loop, &ch->async_handle, channel_async_cb);
+  if (err < 0)
+    goto error_async;
+
+  /* Hidden from uv_walk(), only uv_channel_close() may close it. That also
+   * hides it from uv_loop_close(), which checks the count instead.
+   */
+  ch->async_handle.flags |= UV_HANDLE_INTERNAL;
+  uv__get_internal_fields(loop)->channels++;
+
+  *channel = ch;
+  return 0;
+
+error_async:
+  uv_cond_destroy(&ch->cond);
+error_cond:
+  uv_mutex_destroy(&ch->mutex);
+error:
+  uv__free(ch->cells);
+  uv__free(ch);
+  return err;
+}
+
+
+static int channel_push_cell(uv_channel_t* channel, void* msg) {
+  struct channel_cell* cell;
+  size_t pos;
+  size_t seq;
+
+  pos = channel->send_pos;
+  for (;;) {
+    cell = channel->cells + pos % channel->capacity;
+    seq = cell->seq;
+
+    if (seq == pos) {
+      seq = uv__channel_cas_size(&channel->send_pos, pos, pos + 1);
+      if (seq == pos)
+        break;
+      pos = seq;
+    } else if ((intptr_t)(seq - pos) < 0) {
+      /* The loop thread hasn't read this cell on the previous lap yet. */
+      return UV_EAGAIN;
+    } else {
+      pos = channel->send_pos;
+    }
+  }
+
+  cell->msg = msg;
+  uv__channel_barrier();
+  cell->seq = pos + 1;
+  /* uv_async_send() reads `pending` without a barrier first. Without this
+   * one that read could happen before the store above, see the handle still
+   * pending while the loop has already looked at this cell, and skip the
+   * wakeup. The unbounded path gets its barrier from the CAS.
+   */
+  uv__channel_barrier();
+
+  return 0;
+}
+
+
+static int channel_push_node(uv_channel_t* channel, void* msg) {
+  struct channel_node* node;
+  struct channel_node* head;
+  struct channel_node* old;
+
+  node = uv__malloc(sizeof(*node));
+  if (node == NULL)
+    return UV_ENOMEM;
+
+  node->msg = msg;
+  head = channel->nodes;
+  for (;;) {
+    node->next = head;
+    old = uv__channel_cas_ptr(&channel->nodes, head, node);
+    if (old == head)
+      return 0;
+    head = old;
+  }
+}
+
+
+int uv_channel_send(uv_channel_t* channel, void* msg) {
+  int err;
+
+  if (channel->capacity > 0)
+    err = channel_push_cell(channel, msg);
+  else
+    err = channel_push_node(channel, msg);
+
+  if (err == 0)
+    err = uv_async_send(&channel->async_handle);
+
+  return err;
+}
+
+
+int uv_channel_send_wait(uv_channel_t* channel, void* msg) {
+  int err;
+
+  err = uv_channel_send(channel, msg);
+  if (err != UV_EAGAIN)
+    return err;
+
+  /* Announce ourselves before trying again. The loop thread frees cells
+   * before it looks at `waiters`, so either the retry sees the free cell or
+   * the loop thread sees us and signals `cond` under the mutex.
+   */
+  uv_mutex_lock(&channel->mutex);
+  uv__channel_fetch_add(&channel->waiters, 1);
+
+  while ((err = uv_channel_send(channel, msg)) == UV_EAGAIN)
+    uv_cond_wait(&channel->cond, &channel->mutex);
+
+  uv__channel_fetch_add(&channel->waiters, -1);
+  uv_mutex_unlock(&channel->mutex);
+
+  return err;
+}
+
+
+static unsigned int channel_take_cells(uv_channel_t* channel,
+                                       size_t* budget) {
+  struct channel_cell* cell;
+  unsigned int n;
+
+  for (n = 0; n < UV__CHANNEL_BATCH && *budget > 0; n++, (*budget)--) {
+    cell = channel->cells + channel->recv_pos % channel->capacity;
+    if (cell->seq != channel->recv_pos + 1)
+      break;
+
+    uv__channel_barrier();
+    channel->batch[n] = cell->msg;
+    uv__channel_barrier();
+    cell->seq = channel->recv_pos + channel->capacity;
+    channel->recv_pos++;
+  }
+
+  if (n > 0 && uv__channel_fetch_add(&channel->waiters, 0) != 0) {
+    uv_mutex_lock(&channel->mutex);
+    uv_cond_broadcast(&channel->cond);
+    uv_mutex_unlock(&channel->mutex);
+  }
+
+  return n;
+}
+
+
+static struct channel_node* channel_take_nodes(uv_channel_t* channel) {
+  struct channel_node* prev;
+  struct channel_node* next;
+  struct channel_node* node;
+
+  node = NULL;
+  for (;;) {
+    prev = uv__channel_cas_ptr(&channel->nodes, node, NULL);
+    if (prev == node)
+      break;
+    node = prev;
+  }
+
+  prev = NULL;
+  while (node != NULL) {
+    next = node->next;
+    node->next = prev;
+    prev = node;
+    node = next;
+  }
+
+  return prev;
+}
+
+
+static void channel_async_cb(uv_async_t* async) {
+  struct channel_node* node;
+  struct channel_node* next;
+  uv_channel_t* channel;
+  unsigned int n;
+  size_t budget;
+
+  channel = container_of(async, uv_channel_t, async_handle);
+
+  if (channel->capacity > 0) {
+    /* Don't let fast senders keep the loop thread here forever; one lap
+     * around the ring per wakeup, then come back on the next iteration.
+     */
+    budget = channel->capacity;
+    while ((n = channel_take_cells(channel, &budget)) > 0) {
+      channel->channel_cb(channel, channel->batch, n);
+      if (uv__is_closing(&channel->async_handle))
+        return;
+    }
+
+    if (budget == 0)
+      uv_async_send(&channel->async_handle);
+
+    return;
+  }
+
+  node = channel_take_nodes(channel);
+  while (node != NULL) {
+    for (n = 0; n < UV__CHANNEL_BATCH && node != NULL; n++) {
+      channel->batch[n] = node->msg;
+      next = node->next;
+      uv__free(node);
+      node = next;
+    }
+
+    channel->channel_cb(channel, channel->batch, n);
+
+    if (uv__is_closing(&channel->async_handle))
+      break;
+  }
+
+  /* The channel was closed from the callback, drop what's left. */
+  while (node != NULL) {
+    next = node->next;
+    uv__free(node);
+    node = next;
+  }
+}
+
+
+void uv_channel_close(uv_channel_t* channel, uv_channel_close_cb close_cb) {
+  channel->close_cb = close_cb;
+  uv_close((uv_handle_t*)&channel->async_handle, channel_close_cb);
+}
+
+
+static void channel_close_cb(uv_handle_t* async) {
+  struct channel_node* node;
+  struct channel_node* next;
+  uv_channel_t* channel;
+
+  channel = container_of(async, uv_channel_t, async_handle);
+
+  /* Messages that were never delivered are dropped. */
+  for (node = channel_take_nodes(channel); node != NULL; node = next) {
+    next = node->next;
+    uv__free(node);
+  }
+
+  uv__get_internal_fields(async->loop)->channels--;
+
+  if (channel->close_cb != NULL)
+    channel->close_cb(channel);
+
+  uv_cond_destroy(&channel->cond);
+  uv_mutex_destroy(&channel->mutex);
+  uv__free(channel->cells);
+  uv__free(channel);
+}
+
+
+uv_loop_t* uv_channel_get_loop(const uv_channel_t* channel) {
+  return channel->async_handle.loop;
+}
+
+
+void* uv_channel_get_data(const uv_channel_t* channel) {
+  return channel->data;
+}
+
+
+void uv_channel_set_data(uv_channel_t* channel, void* data) {
+  channel->data = data;
+}
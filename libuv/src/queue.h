@@ -15,7 +15,7 @@
 
 /**
  * 双向队列
- * /
+ */
 #ifndef QUEUE_H_
 #define QUEUE_H_
 
@@ -26,13 +26,26 @@
  * 2. 如果是第一次提交任务，那么还会初始化线程池（默认大小为4），可以通过环境变量UV_THREADPOOL_SIZE调整（最大可为1024）
  * 3. 线程池初始完毕后，将待执行任务推入任务队列中（推入时判断区分任务类型（慢IO、快IO、CPU计算型任务）
  * 4. 如果是慢IO任务，将任务加入slow_io_pending_wq队列，并将run_slow_work_message加入wq（线程池从wq一次取出待执行任务，碰到run_slow_work_message，则表示为慢IO，从而转向slow_io_pending_wq取出IO执行）
- * 5. 执行完毕后，将执行完毕的任务放入loop->wq中，然后使用uv_async_send通知事件循环主线程
+ * 5. 执行完毕后，将执行完毕的任务压入 loop 的无锁完成栈，栈由空变为非空时使用uv_async_send通知事件循环主线程
  * 6. 事件循环主线程收到通知后执行uv__work_done，意味着回调在主线程中执行，
- * 7. uv__work_done取出loop->wq中的任务，依次执行
+ * 7. uv__work_done一次取走完成栈中的任务，按完成顺序依次执行
  * 
  * 优化的点
  * 1. 线程空闲时睡眠，不占用CPU时间片
  * 2. 任务队列分为：慢任务队列、快任务队列；彼此分隔，避免慢任务占用过多线程
+ * 3. 每个 loop 可以按任务类型把任务路由到独立的线程池（uv_loop_set_threadpool），
+ *    避免一种任务（例如挂起的 NFS 文件操作）拖住其它类型的任务，未指定时使用全局默认线程池
+ * 4. 弹性线程池（UV_THREADPOOL_ELASTIC / uv_threadpool_set_limits）：只启动 min 个线程，
+ *    任务积压时按需创建，最多 max 个；多出来的线程空闲超时后退出
+ * 5. uv_queue_work_ex 可以指定优先级和截止时间：每个优先级一个队列，高优先级先执行，
+ *    低优先级被插队太多次后插入执行一次；过了截止时间的任务不再执行，以 UV_ETIMEDOUT 完成
+ * 6. uv_queue_work_batch 批量提交：整批只加一次锁，一次唤醒 min(n, 空闲线程数) 个线程
+ * 7. 统计（UV_THREADPOOL_ENABLE_METRICS）：任务记录提交、开始、完成的时间，
+ *    按任务类型统计排队和执行时间的直方图，通过 uv_threadpool_metrics 读取
+ * 8. 固定线程（UV_THREADPOOL_PIN_THREADS）：每个线程固定在一个 CPU 上，线程轮流分布到各个 NUMA 节点；
+ *    UV_THREADPOOL_NUMA_LOCAL 时任务交给提交线程所在节点的线程，空闲线程也先偷同一节点的任务
+ * 9. 自旋（UV_THREADPOOL_SPIN）：线程没有任务时先自旋一小段时间再休眠，
+ *    提交任务时有自旋的线程就交给它，省去一次 futex 唤醒和调度
  * 
  */
 
@@ -40,52 +53,465 @@
 
 #if !defined(_WIN32)
 #include "unix/internal.h"
+#include "unix/atomic-ops.h"
 #endif
 
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h> /* memcpy() */
 
-/**
- * 静态全局变量只能被本文件获取，存储在【全局数据区】
- * 内存分布情况：【代码区】、【全局数据区】、【堆区】、【栈区】
- * 
- * 【堆区】一般有 new 产生
- * 【栈区】函数内部自动变量，自动变量随着函数退出而释放
- * 【全局数据区】静态数据（函数内部的静态全局数据也算），不会因为函数退出而释放
- */
+#if !defined(_WIN32)
+#include <sched.h>
+#endif
 
 // 线程池容量
 #define MAX_THREADPOOL_SIZE 1024
 
+// 优先级数量
+#define WORK_PRIORITIES (UV_WORK_PRIORITY_LOW + 1)
+// 低优先级任务最多被插队的次数
+#define MAX_PRIORITY_PASSES 8
+
+// uv_work_t.deadline 的特殊值，表示任务过了截止时间没有执行
+#define WORK_EXPIRED ((uint64_t)-1)
+
+/* Requests that go through a pool keep their bookkeeping in the private
+ * `reserved` field of uv_req_t, so the public request types keep their size.
+ */
+// 提交到的线程池，供 uv_cancel 使用
+#define work_pool(req) (*(struct uv__pool **)&(req)->reserved[0])
+// uv_queue_work_batch() 提交的 uv_work_t 所属的批次，单独提交时为 NULL
+#define work_batch(req) (*(uv_work_batch_t **)&(req)->reserved[1])
+
+// uv_work_t 的截止时间，从 reserved[2] 开始；32 位平台上占两个位置
+#define WORK_DEADLINE_SLOT 2
+// 需要计时的请求对应的 struct uv__timed_work，不计时为 NULL
+#define work_timed(req) (*(struct uv__timed_work **)&(req)->reserved[4])
+
+STATIC_ASSERT(WORK_DEADLINE_SLOT * sizeof(void *) + sizeof(uint64_t) <=
+              4 * sizeof(void *));
+STATIC_ASSERT(5 <= ARRAY_SIZE(((uv_req_t *)0)->reserved));
+
+/* Work that is timed, because the pool keeps metrics or the loop has a
+ * uv_work_timing_cb, is queued through one of these instead of through the
+ * request's own uv__work. It's allocated on the loop thread when the work is
+ * submitted and freed there when the work is done.
+ */
+struct uv__timed_work
+{
+  // 线程池排队、执行、放入完成栈的都是它
+  struct uv__work work;
+  // 请求自己的 uv__work
+  struct uv__work *inner;
+  struct uv__pool *pool;
+  uv_req_t *req;
+  enum uv__work_kind kind;
+  // 提交、开始执行、执行完毕的时间（纳秒）
+  uint64_t submit_time;
+  uint64_t start_time;
+  uint64_t done_time;
+};
+
+// 原子加法，返回旧值；同时是完整的内存屏障
+// 原子比较交换指针，返回旧值；同时是完整的内存屏障
+#if defined(_WIN32)
+#define uv__pool_fetch_add(p, v) \
+  ((unsigned int)InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v)))
+#define uv__pool_cas_ptr(p, o, n) \
+  ((struct uv__work *)InterlockedCompareExchangePointer( \
+      (PVOID volatile *)(p), (PVOID)(n), (PVOID)(o)))
+#else
+#define uv__pool_fetch_add(p, v) __sync_fetch_and_add((p), (v))
+#define uv__pool_cas_ptr(p, o, n) __sync_val_compare_and_swap((p), (o), (n))
+#endif
+
+// 让出 CPU
+#if defined(_WIN32)
+#define uv__pool_yield() SwitchToThread()
+#else
+#define uv__pool_yield() sched_yield()
+#endif
+
+// 自旋等待时提示 CPU 降低功耗，把执行资源让给超线程的另一半
+#if defined(_WIN32)
+#define uv__pool_relax() YieldProcessor()
+#else
+#define uv__pool_relax() cpu_relax()
+#endif
+
+/* Finished work is pushed on a lock-free stack per loop. The link lives in
+ * the prev pointer of `w->wq`, so QUEUE_EMPTY(&w->wq) stays true and
+ * uv_cancel() can tell that the work isn't queued anymore.
+ */
+#define work_next(w) (*(struct uv__work **)&(w)->wq[1])
+
+/* On the done stack `w->loop` holds the pool that ran the work instead.
+ * uv__work_done() knows the loop from its async handle and puts it back.
+ */
+#define work_done_pool(w) (*(struct uv__pool **)&(w)->loop)
+
+/**
+ * 工作窃取模式下每个线程自己的状态
+ *
+ * 每个线程有自己的任务队列和锁，提交任务只锁目标线程的队列，
+ * 线程之间不再争抢同一把全局锁；自己的队列空了就去其它线程的队列里“偷”任务
+ */
+struct uv__pool_worker
+{
+  uv_mutex_t mutex;
+  // 休眠时等待的条件变量
+  uv_cond_t cond;
+  // 本线程的任务队列，受 mutex 保护
+  QUEUE wq;
+  // 是否在 cond 上休眠，受 mutex 保护；唤醒方负责清零
+  int parked;
+  // 固定在哪个 CPU 上，只在固定线程时使用
+  int cpu;
+  // 是否在休眠前自旋，只由本线程修改；提交任务时不加锁读取
+  int spinning;
+};
+
+/**
+ * 一个线程池的全部状态
+ *
+ * 全局默认线程池为静态变量 default_pool，存储在【全局数据区】；
+ * 通过 uv_threadpool_init 创建的线程池分配在【堆区】，由 uv_threadpool_t.internal 指向
+ */
+struct uv__pool
+{
+  // 条件锁（唤醒线程）
+  uv_cond_t cond;
+  // 互斥锁，工作窃取模式下只保护慢IO队列和 refs
+  uv_mutex_t mutex;
+  // idle线程数
+  unsigned int idle_threads;
+  // 自旋等待任务、还没有被认领的线程数
+  unsigned int spinners;
+  // 提交任务时认领的自旋线程数，自旋线程看到后去取任务；线程不加锁读取
+  unsigned int spin_claims;
+  // 休眠前自旋多久（纳秒），0 表示不自旋
+  uint64_t spin_time;
+  // 正在运行的慢IO数量
+  unsigned int slow_io_work_running;
+  // 慢IO最多占用的线程比例（百分比）
+  unsigned int slow_io_percent;
+  // 当前线程数，包括已创建还没开始取任务的线程
+  unsigned int nthreads;
+  // 已创建还没开始取任务的线程数
+  unsigned int starting;
+  // 线程数下限，线程数不多于它时空闲线程不会退出
+  unsigned int min_threads;
+  // 线程数上限；工作窃取模式下也是 workers 数组的大小
+  unsigned int max_threads;
+  // 已提交还没开始执行的任务数，只在经典模式下统计
+  unsigned int pending;
+  // 等待的任务比空闲线程多出这么多时创建新线程
+  unsigned int grow_depth;
+  // 任务等不到线程的状态持续这么久（纳秒）时也创建新线程，0 表示不按时间
+  uint64_t grow_wait;
+  // 任务等不到线程的状态从何时开始，0 表示还没开始计时
+  uint64_t busy_since;
+  // 多于 min_threads 的线程空闲这么久（纳秒）后退出
+  uint64_t idle_timeout;
+  // 路由到该线程池的 (loop, kind) 数量，受 mutex 保护
+  unsigned int refs;
+  // 已提交、loop 还没执行完成回调的任务数，只通过 uv__pool_fetch_add 修改
+  unsigned int outstanding;
+  // 线程池关闭标志，线程在队列清空后退出
+  int stop;
+  // 任务队列，每个优先级一个
+  QUEUE wq[WORK_PRIORITIES];
+  // 每个优先级的队列连续被更高优先级插队的次数
+  unsigned int passes[WORK_PRIORITIES];
+  // 慢任务标识，慢任务队列“代表”
+  QUEUE run_slow_work_message;
+  // 慢任务队列
+  QUEUE slow_io_pending_wq;
+  // 工作窃取模式下每个线程的状态，经典模式下为 NULL
+  struct uv__pool_worker *workers;
+  // 工作窃取模式下休眠的线程数，只通过 uv__pool_fetch_add 修改
+  unsigned int nparked;
+  // 线程名，空字符串表示不设置
+  char name[16];
+  // 已经退出、等待 join 的线程数
+  unsigned int nzombies;
+  // 已经退出、等待 join 的线程，线程退出前把自己登记在这里
+  uv_thread_t zombies[MAX_THREADPOOL_SIZE];
+  // 是否统计任务的排队和执行时间
+  int metrics;
+  // 保护 queue_time 和 run_time，线程执行完任务时加锁更新
+  uv_mutex_t metrics_mutex;
+  // 每种任务的排队时间和执行时间
+  uv_work_histogram_t queue_time[UV_WORK_KIND_MAX];
+  uv_work_histogram_t run_time[UV_WORK_KIND_MAX];
+  // 固定线程时线程依次使用的 CPU，按 NUMA 节点交错排列；NULL 表示不固定
+  int *cpus;
+  unsigned int ncpus;
+  // uv_cpumask_size()
+  int mask_size;
+  // 经典模式下下一个线程使用 cpus 中的第几个，只通过 uv__pool_fetch_add 修改
+  unsigned int next_cpu;
+  // 每个 CPU 所在的 NUMA 节点，只在 UV_THREADPOOL_NUMA_LOCAL 时不为 NULL
+  unsigned char *cpu_node;
+  unsigned int nnodes;
+  // 线程按节点排列，节点 n 的线程编号为 [node_first[n], node_first[n + 1])
+  unsigned int *node_first;
+};
+
+// worker 启动参数，由新线程释放
+struct uv__pool_start
+{
+  struct uv__pool *pool;
+  unsigned int index;
+};
+
 // 仅初始化一次
 static uv_once_t once = UV_ONCE_INIT;
-// 条件锁（唤醒线程）
-static uv_cond_t cond;
-// 互斥锁
-static uv_mutex_t mutex;
-// idle线程数
-static unsigned int idle_threads;
-// 正在运行的慢IO数量
-static unsigned int slow_io_work_running;
-// 总线程数
-static unsigned int nthreads;
-// 线程实例
-static uv_thread_t *threads;
-// 默认线程池，大小4
-static uv_thread_t default_threads[4];
-// 退出消息
-static QUEUE exit_message;
-// 任务队列
-static QUEUE wq;
-// 慢任务标识，慢任务队列“代表”
-static QUEUE run_slow_work_message;
-// 慢任务队列
-static QUEUE slow_io_pending_wq;
+// 默认线程池，所有未指定线程池的 loop 共用
+static struct uv__pool default_pool;
+// 默认线程池启动前通过 uv_threadpool_set_limits(NULL, ...) 设置的上下限，0 表示未设置
+static unsigned int default_min_threads;
+static unsigned int default_max_threads;
+
+// 默认的线程数
+#define DEFAULT_THREADPOOL_SIZE 4
+// 默认的空闲超时，毫秒
+#define DEFAULT_IDLE_TIMEOUT 10000
+// 默认慢IO最多占用一半的线程
+#define DEFAULT_SLOW_IO_PERCENT 50
+// 默认的自旋时间，微秒
+#define DEFAULT_SPIN_US 50
+// 最多识别的 NUMA 节点数
+#define MAX_NUMA_NODES 64
+
+static void worker(void *arg);
 
 // 允许的最大慢线程数
-// 线程数一半，向上取整
-static unsigned int slow_work_thread_threshold(void)
+// 线程数上限的 slow_io_percent%，向上取整，至少一个
+static unsigned int slow_work_thread_threshold(struct uv__pool *pool)
+{
+  unsigned int n;
+
+  n = (pool->max_threads * pool->slow_io_percent + 99) / 100;
+  return n > 0 ? n : 1;
+}
+
+// 调用方持有 pool->mutex，是否需要再创建一个线程
+static int pool_should_grow(struct uv__pool *pool)
+{
+  unsigned int avail;
+  uint64_t now;
+
+  if (pool->nthreads >= pool->max_threads)
+    return 0;
+
+  // 空闲、自旋和正在启动的线程能接手的任务不算积压
+  avail = pool->idle_threads + pool->spinners + pool->spin_claims +
+          pool->starting;
+  if (pool->pending <= avail)
+    return 0;
+
+  if (pool->pending - avail >= pool->grow_depth)
+    return 1;
+
+  if (pool->grow_wait == 0)
+    return 0;
+
+  now = uv_hrtime();
+  if (pool->busy_since == 0)
+  {
+    pool->busy_since = now;
+    return 0;
+  }
+
+  return now - pool->busy_since >= pool->grow_wait;
+}
+
+// 本线程可以使用的 CPU 数
+static unsigned int pool_ncpus(void)
+{
+  uv_thread_t self;
+  unsigned int n;
+  char *mask;
+  int size;
+  int i;
+
+  n = 0;
+  size = uv_cpumask_size();
+  mask = size > 0 ? uv__malloc(size) : NULL;
+  self = uv_thread_self();
+  if (mask != NULL && uv_thread_getaffinity(&self, mask, size) == 0)
+    for (i = 0; i < size; i++)
+      n += mask[i] != 0;
+  uv__free(mask);
+
+  if (n == 0)
+  {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = info.dwNumberOfProcessors;
+#else
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  }
+
+  return n;
+}
+
+// 调用方持有 pool->mutex，让一个空闲线程来取任务，没有空闲线程时返回 0
+// 优先认领自旋的线程，它自己会看到任务，不需要唤醒
+static int pool_wake(struct uv__pool *pool)
+{
+  if (pool->spinners > 0)
+  {
+    pool->spinners--;
+    pool->spin_claims++;
+    return 1;
+  }
+
+  if (pool->idle_threads > 0)
+  {
+    uv_cond_signal(&pool->cond);
+    return 1;
+  }
+
+  return 0;
+}
+
+// 没有任务时先自旋 spin_time 纳秒，直到有任务认领自己
+// 调用方持有 pool->mutex，返回时仍然持有
+static void pool_spin(struct uv__pool *pool)
+{
+  uint64_t deadline;
+  unsigned int i;
+
+  pool->spinners++;
+  uv_mutex_unlock(&pool->mutex);
+
+  deadline = uv_hrtime() + pool->spin_time;
+  for (i = 1; *(volatile unsigned int *)&pool->spin_claims == 0; i++)
+  {
+    uv__pool_relax();
+    // 读时钟比 relax 慢得多，隔一段时间看一次
+    if (i % 64 == 0 && uv_hrtime() >= deadline)
+      break;
+  }
+
+  uv_mutex_lock(&pool->mutex);
+  // 认领不分线程：有认领就取走一个去找任务，否则自己不再算作自旋的线程
+  if (pool->spin_claims > 0)
+    pool->spin_claims--;
+  else
+    pool->spinners--;
+}
+
+// 调用方持有 pool->mutex，为一个即将创建的线程占位
+static void pool_reserve(struct uv__pool *pool)
+{
+  pool->nthreads++;
+  if (pool->workers == NULL)
+    pool->starting++;
+  pool->busy_since = 0;
+}
+
+// 创建一个线程，调用方已经用 pool_reserve 为它占好位置
+static int pool_grow(struct uv__pool *pool, unsigned int index)
+{
+  struct uv__pool_start *start;
+  uv_thread_options_t options;
+  uv_thread_t tid;
+  char *mask;
+  int cpu;
+  int err;
+
+  options.flags = UV_THREAD_NO_FLAGS;
+  if (pool->name[0] != '\0')
+  {
+    options.flags |= UV_THREAD_HAS_NAME;
+    options.name = pool->name;
+  }
+
+  mask = NULL;
+  if (pool->cpus != NULL)
+    mask = uv__calloc(pool->mask_size, 1);
+  if (mask != NULL)
+  {
+    if (pool->workers != NULL)
+      cpu = pool->workers[index].cpu;
+    else
+      cpu = pool->cpus[uv__pool_fetch_add(&pool->next_cpu, 1) % pool->ncpus];
+    mask[cpu] = 1;
+    options.flags |= UV_THREAD_HAS_AFFINITY;
+    options.cpumask = mask;
+    options.mask_size = pool->mask_size;
+  }
+
+  err = UV_ENOMEM;
+  start = uv__malloc(sizeof(*start));
+  if (start != NULL)
+  {
+    start->pool = pool;
+    start->index = index;
+    // 线程退出时通过 uv_thread_self() 登记自己，这里不需要保存 tid
+    err = uv_thread_create_ex(&tid, &options, worker, start);
+    // 固定失败（例如 CPU 已经不允许使用）时不固定
+    if (err && (options.flags & UV_THREAD_HAS_AFFINITY))
+    {
+      options.flags &= ~UV_THREAD_HAS_AFFINITY;
+      err = uv_thread_create_ex(&tid, &options, worker, start);
+    }
+    if (err)
+      uv__free(start);
+  }
+  uv__free(mask);
+
+  if (err)
+  {
+    uv_mutex_lock(&pool->mutex);
+    pool->nthreads--;
+    if (pool->workers == NULL)
+      pool->starting--;
+    // 没有线程能执行已经提交的任务了
+    if (pool->nthreads == 0 && pool->pending != 0)
+      abort();
+    uv_mutex_unlock(&pool->mutex);
+  }
+
+  return err;
+}
+
+// join 已经退出的线程，调用方不能持有 pool->mutex
+static void pool_reap(struct uv__pool *pool)
+{
+  uv_thread_t tid;
+
+  for (;;)
+  {
+    uv_mutex_lock(&pool->mutex);
+    if (pool->nzombies == 0)
+    {
+      uv_mutex_unlock(&pool->mutex);
+      return;
+    }
+    tid = pool->zombies[--pool->nzombies];
+    uv_mutex_unlock(&pool->mutex);
+
+    // 线程登记后只剩解锁和返回，这里不会等太久
+    if (uv_thread_join(&tid))
+      abort();
+  }
+}
+
+// 线程退出前登记自己，调用方持有 pool->mutex，返回时已经解锁
+static void pool_exit(struct uv__pool *pool)
 {
-  return (nthreads + 1) / 2;
+  pool->nthreads--;
+  pool->zombies[pool->nzombies++] = uv_thread_self();
+  // 关闭时叫醒其它线程检查退出条件，也通知在 pool_stop 里等待的线程
+  if (pool->stop)
+    uv_cond_broadcast(&pool->cond);
+  uv_mutex_unlock(&pool->mutex);
 }
 
 // 取消操作
@@ -94,27 +520,469 @@ static void uv__cancelled(struct uv__work *w)
   abort();
 }
 
+// 把完成的任务压入 loop 的无锁栈，栈由空变为非空时才唤醒 loop
+// 多个任务接连完成时只需要一次 uv_async_send
+static void work_push_done(uv_loop_t *loop,
+                           struct uv__pool *pool,
+                           struct uv__work *w)
+{
+  uv__loop_internal_fields_t *lfields;
+  struct uv__work *head;
+  struct uv__work *old;
+
+  lfields = uv__get_internal_fields(loop);
+
+  // uv_loop_close 会等到计数归零，压栈之后 loop 可能已经可以关闭
+  uv__pool_fetch_add(&lfields->work_pushing, 1);
+  work_done_pool(w) = pool;
+
+  // 先假设栈是空的，失败时 CAS 返回的就是当前的栈顶
+  head = NULL;
+  for (;;)
+  {
+    work_next(w) = head;
+    old = uv__pool_cas_ptr(&lfields->work_done, head, w);
+    if (old == head)
+      break;
+    head = old;
+  }
+
+  // 栈原来不空说明已经有人通知过 loop，它还没有取走
+  if (head == NULL)
+    uv_async_send(&loop->wq_async);
+
+  uv__pool_fetch_add(&lfields->work_pushing, -1);
+}
+
+// 不经过线程池，直接把 w 交给 loop 线程执行 w->done，任意线程都可以调用
+void uv__work_post(uv_loop_t *loop, struct uv__work *w)
+{
+  w->loop = loop;
+  w->work = NULL;
+  work_push_done(loop, NULL, w);
+}
+
+// 任务执行完毕，交给 loop 线程执行完成回调
+static void work_finish(struct uv__pool *pool, struct uv__work *w)
+{
+  // 告知 uv__work_done 该任务已处理完毕
+  w->work = NULL; /* Signal uv__work_done() that the work req wasn't
+                     cancelled. */
+
+  // worker线程执行好后，将worker加入主线程事件循环的完成栈中等待执行
+  work_push_done(w->loop, pool, w);
+}
+
+// 把一个耗时（纳秒）计入直方图，按微秒数的二进制位数分桶
+static void histogram_add(uv_work_histogram_t *h, uint64_t ns)
+{
+  uint64_t us;
+  unsigned int i;
+
+  h->count++;
+  h->total += ns;
+  if (ns > h->max)
+    h->max = ns;
+
+  us = ns / 1000;
+  for (i = 0; us != 0 && i < UV_WORK_HISTOGRAM_BUCKETS - 1; i++)
+    us >>= 1;
+  h->buckets[i]++;
+}
+
+// 在线程池里执行需要计时的任务，记下开始和结束的时间
+static void timed_work(struct uv__work *w)
+{
+  struct uv__timed_work *t;
+  struct uv__pool *pool;
+
+  t = container_of(w, struct uv__timed_work, work);
+  pool = t->pool;
+
+  t->start_time = uv_hrtime();
+  t->inner->work(t->inner);
+  t->done_time = uv_hrtime();
+
+  if (pool->metrics)
+  {
+    uv_mutex_lock(&pool->metrics_mutex);
+    histogram_add(&pool->queue_time[t->kind], t->start_time - t->submit_time);
+    histogram_add(&pool->run_time[t->kind], t->done_time - t->start_time);
+    uv_mutex_unlock(&pool->metrics_mutex);
+  }
+}
+
+// loop 线程：报告耗时，释放包装，再执行请求自己的完成回调
+static void timed_done(struct uv__work *w, int status)
+{
+  uv__loop_internal_fields_t *lfields;
+  struct uv__timed_work *t;
+  struct uv__work *inner;
+  uv_work_timing_t timing;
+
+  t = container_of(w, struct uv__timed_work, work);
+  lfields = uv__get_internal_fields(w->loop);
+
+  // 在完成回调之前报告耗时，这时 req 还没有被释放
+  if (lfields->work_timing_cb != NULL)
+  {
+    timing.kind = (uv_work_kind)t->kind;
+    timing.queue_time = t->start_time - t->submit_time;
+    timing.run_time = t->done_time - t->start_time;
+    timing.done_time = uv_hrtime() - t->done_time;
+    lfields->work_timing_cb(t->req, &timing);
+  }
+
+  inner = t->inner;
+  inner->work = w->work;
+  work_timed(t->req) = NULL;
+  uv__free(t);
+
+  inner->done(inner, status);
+}
+
+// 线程池里排队的是请求自己的 uv__work 还是它的计时包装
+static struct uv__work *work_queued(uv_req_t *req, struct uv__work *w)
+{
+  if (work_timed(req) != NULL)
+    return &work_timed(req)->work;
+
+  return w;
+}
+
+// 在线程池里执行一个任务
+static void work_run(struct uv__pool *pool, struct uv__work *w)
+{
+  w->work(w);
+  work_finish(pool, w);
+}
+
+// 唤醒一个休眠的线程，从 start 开始找；没有休眠的线程时什么也不做
+static void steal_wake(struct uv__pool *pool, unsigned int start)
+{
+  struct uv__pool_worker *wk;
+  unsigned int i;
+  int woken;
+
+  // 读取的同时也是内存屏障，与 steal_park 中的 nparked 加一配对
+  if (uv__pool_fetch_add(&pool->nparked, 0) == 0)
+    return;
+
+  for (i = 0; i < pool->max_threads; i++)
+  {
+    wk = pool->workers + (start + i) % pool->max_threads;
+    // 先不加锁看一眼，加锁后再确认
+    if (!wk->parked)
+      continue;
+
+    uv_mutex_lock(&wk->mutex);
+    woken = wk->parked;
+    if (woken)
+    {
+      wk->parked = 0;
+      uv__pool_fetch_add(&pool->nparked, -1);
+      uv_cond_signal(&wk->cond);
+    }
+    uv_mutex_unlock(&wk->mutex);
+
+    if (woken)
+      return;
+  }
+}
+
+// 不加锁判断是否有可以执行的任务，只作为休眠前的最后检查
+static int steal_has_work(struct uv__pool *pool)
+{
+  unsigned int i;
+
+  for (i = 0; i < pool->max_threads; i++)
+    if (!QUEUE_EMPTY(&pool->workers[i].wq))
+      return 1;
+
+  return !QUEUE_EMPTY(&pool->slow_io_pending_wq) &&
+         pool->slow_io_work_running < slow_work_thread_threshold(pool);
+}
+
+// 取出一个慢IO任务，已达到慢IO线程上限时返回 NULL
+static QUEUE *steal_take_slow(struct uv__pool *pool)
+{
+  QUEUE *q;
+
+  q = NULL;
+  uv_mutex_lock(&pool->mutex);
+  if (!QUEUE_EMPTY(&pool->slow_io_pending_wq) &&
+      pool->slow_io_work_running < slow_work_thread_threshold(pool))
+  {
+    q = QUEUE_HEAD(&pool->slow_io_pending_wq);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q); /* Signal uv_cancel() that the work req is executing. */
+    pool->slow_io_work_running++;
+  }
+  uv_mutex_unlock(&pool->mutex);
+
+  return q;
+}
+
+// 从 wk 的队列头部取出一个任务，调用方持有 wk->mutex
+static QUEUE *steal_pop(struct uv__pool_worker *wk)
+{
+  QUEUE *q;
+
+  if (QUEUE_EMPTY(&wk->wq))
+    return NULL;
+
+  q = QUEUE_HEAD(&wk->wq);
+  QUEUE_REMOVE(q);
+  QUEUE_INIT(q); /* Signal uv_cancel() that the work req is executing. */
+  return q;
+}
+
+// 依次尝试从编号为 [first, first + count) 的线程的队列里偷一个任务，从 self 的下一个开始
+static QUEUE *steal_from_range(struct uv__pool *pool,
+                               unsigned int first,
+                               unsigned int count,
+                               unsigned int self)
+{
+  struct uv__pool_worker *wk;
+  unsigned int i;
+  QUEUE *q;
+
+  for (i = 1; i < count; i++)
+  {
+    wk = pool->workers + first + (self - first + i) % count;
+    if (QUEUE_EMPTY(&wk->wq))
+      continue;
+
+    // 不用 trylock：持锁的线程被抢占时，空转重试只会更慢
+    uv_mutex_lock(&wk->mutex);
+    q = steal_pop(wk);
+    uv_mutex_unlock(&wk->mutex);
+
+    if (q != NULL)
+      return q;
+  }
+
+  return NULL;
+}
+
+// 依次尝试从其它线程的队列里偷一个任务，NUMA_LOCAL 时先偷同一节点的线程
+static QUEUE *steal_from_peers(struct uv__pool *pool, unsigned int self)
+{
+  unsigned int node;
+  QUEUE *q;
+
+  if (pool->node_first != NULL)
+  {
+    node = pool->cpu_node[pool->workers[self].cpu];
+    q = steal_from_range(pool,
+                         pool->node_first[node],
+                         pool->node_first[node + 1] - pool->node_first[node],
+                         self);
+    if (q != NULL)
+      return q;
+  }
+
+  return steal_from_range(pool, 0, pool->max_threads, self);
+}
+
+/* Park until there is work. Returns 0 when the pool stops.
+ *
+ * The increment of `nparked` and the check for work that follows it pair
+ * with the push and the read of `nparked` in steal_post(): either the
+ * submitter sees a parked worker and wakes it, or the worker sees the work.
+ */
+// 没有任务时休眠
+static int steal_park(struct uv__pool *pool, struct uv__pool_worker *me)
+{
+  uint64_t deadline;
+  unsigned int i;
+  int stop;
+
+  // 先自旋，期间提交给本线程的任务不需要唤醒它，其它线程的积压也能偷到
+  if (pool->spin_time != 0 && !pool->stop)
+  {
+    me->spinning = 1;
+    deadline = uv_hrtime() + pool->spin_time;
+    for (i = 1; !steal_has_work(pool); i++)
+    {
+      uv__pool_relax();
+      if (i % 64 == 0 && (uv_hrtime() >= deadline || pool->stop))
+        break;
+    }
+    me->spinning = 0;
+
+    if (steal_has_work(pool))
+      return 1;
+  }
+
+  uv_mutex_lock(&me->mutex);
+  if (!QUEUE_EMPTY(&me->wq))
+  {
+    uv_mutex_unlock(&me->mutex);
+    return 1;
+  }
+
+  stop = pool->stop;
+  if (!stop)
+  {
+    me->parked = 1;
+    uv__pool_fetch_add(&pool->nparked, 1);
+
+    if (!steal_has_work(pool))
+      // 被唤醒时唤醒方已经把 parked 清零
+      while (me->parked && !pool->stop)
+        uv_cond_wait(&me->cond, &me->mutex);
+
+    if (me->parked)
+    {
+      me->parked = 0;
+      uv__pool_fetch_add(&pool->nparked, -1);
+    }
+  }
+  uv_mutex_unlock(&me->mutex);
+
+  // 关闭时还有别的线程的任务没做完就帮忙，否则退出
+  return !stop || steal_has_work(pool);
+}
+
+// 工作窃取模式下的 worker 主循环
+static void steal_worker(struct uv__pool *pool, unsigned int self)
+{
+  struct uv__pool_worker *me;
+  struct uv__work *w;
+  QUEUE *q;
+  int is_slow_work;
+  int more;
+
+  me = pool->workers + self;
+
+  for (;;)
+  {
+    // 1. 慢IO任务，不超过线程数一半；不加锁的检查只是提示
+    q = NULL;
+    if (!QUEUE_EMPTY(&pool->slow_io_pending_wq))
+      q = steal_take_slow(pool);
+    is_slow_work = q != NULL;
+
+    // 2. 自己的队列
+    if (q == NULL)
+    {
+      uv_mutex_lock(&me->mutex);
+      q = steal_pop(me);
+      more = !QUEUE_EMPTY(&me->wq);
+      uv_mutex_unlock(&me->mutex);
+
+      // 自己还有积压的任务，叫醒一个空闲线程来偷
+      if (more)
+        steal_wake(pool, self + 1);
+    }
+
+    // 3. 别的线程的队列
+    if (q == NULL)
+      q = steal_from_peers(pool, self);
+
+    // 4. 都没有就休眠
+    if (q == NULL)
+    {
+      if (steal_park(pool, me))
+        continue;
+      break;
+    }
+
+    w = QUEUE_DATA(q, struct uv__work, wq);
+    work_run(pool, w);
+
+    if (is_slow_work)
+    {
+      uv_mutex_lock(&pool->mutex);
+      pool->slow_io_work_running--;
+      uv_mutex_unlock(&pool->mutex);
+    }
+  }
+}
+
+/* Returns the queue to take the next work item from, or NULL if there is no
+ * work that can run now. Caller holds `pool->mutex`.
+ */
+// 先取优先级高的任务；低优先级的队列被插队 MAX_PRIORITY_PASSES 次后先取它一次，避免饿死
+static QUEUE *pool_next_queue(struct uv__pool *pool)
+{
+  unsigned int chosen;
+  unsigned int p;
+  QUEUE *wq;
+
+  chosen = WORK_PRIORITIES;
+  for (p = 0; p < WORK_PRIORITIES; p++)
+  {
+    wq = &pool->wq[p];
+    if (QUEUE_EMPTY(wq))
+      continue;
+
+    // 仅有慢IO并且慢IO数量已达上限
+    if (QUEUE_HEAD(wq) == &pool->run_slow_work_message &&
+        QUEUE_NEXT(&pool->run_slow_work_message) == wq &&
+        pool->slow_io_work_running >= slow_work_thread_threshold(pool))
+      continue;
+
+    if (chosen == WORK_PRIORITIES)
+      chosen = p;
+    else if (pool->passes[p]++ >= MAX_PRIORITY_PASSES)
+    {
+      chosen = p;
+      break;
+    }
+  }
+
+  if (chosen == WORK_PRIORITIES)
+    return NULL;
+
+  pool->passes[chosen] = 0;
+  return &pool->wq[chosen];
+}
+
 /* To avoid deadlock with uv_cancel() it's crucial that the worker
- * never holds the global mutex and the loop-local mutex at the same time.
+ * never holds the pool mutex and the loop-local mutex at the same time.
  */
 // worker线程执行处理的函数
 // 启动后线程一直运行，通过信号量方式通知空闲进程处理
 static void worker(void *arg)
 {
+  struct uv__pool_start start;
+  struct uv__pool *pool;
   struct uv__work *w;
+  QUEUE *wq;
   QUEUE *q;
   int is_slow_work;
+  int timed_out;
+  int spun;
 
-  uv_sem_post((uv_sem_t *)arg);
+  start = *(struct uv__pool_start *)arg;
+  uv__free(arg);
   arg = NULL;
+  pool = start.pool;
+
+  if (pool->workers != NULL)
+  {
+    steal_worker(pool, start.index);
+    uv_mutex_lock(&pool->mutex);
+    pool_exit(pool);
+    return;
+  }
 
   // 这里加锁保证 uv_cond_wait 操作的原子性，避免丢失信号，导致 uv_cond_wait 不背唤醒
   // 可以参考 https://zhuanlan.zhihu.com/p/55123862
-  uv_mutex_lock(&mutex);
+  uv_mutex_lock(&pool->mutex);
+  pool->starting--;
+  timed_out = 0;
+  spun = 0;
   // 一直运行
   for (;;)
   {
-    /* `mutex` should always be locked at this point. */
+    /* `pool->mutex` should always be locked at this point. */
+
+    // uv_threadpool_set_limits 调低了上限，多出来的线程退出
+    if (pool->nthreads > pool->max_threads)
+      break;
 
     // 一直等
     /* Keep waiting while either no work is present or only slow I/O
@@ -124,30 +992,48 @@ static void worker(void *arg)
     // 2. 仅有慢IO并且慢IO数量超过总线程数量一半
     // 将IO操作分为快IO操作、慢IO操作，当慢IO操作数量超过总线程数量一半时，当前线程继续休眠(等待执行快IO或CPU任务)
     // 这样一来就能避免慢IO操作占用过多线程
-    while (QUEUE_EMPTY(&wq) ||
-           (QUEUE_HEAD(&wq) == &run_slow_work_message &&
-            QUEUE_NEXT(&run_slow_work_message) == &wq &&
-            slow_io_work_running >= slow_work_thread_threshold()))
+    wq = pool_next_queue(pool);
+    if (wq == NULL)
     {
+      // 线程池关闭且任务都已取走，退出
+      if (pool->stop && pool->pending == 0)
+        break;
+
+      // 空闲超时，线程数多于下限时退出
+      if (timed_out && pool->nthreads > pool->min_threads)
+        break;
+
+      // 先自旋一次，被认领或超时后回到循环开头重新找任务；仍然没有任务才休眠
+      if (pool->spin_time != 0 && !spun && !pool->stop)
+      {
+        pool_spin(pool);
+        spun = 1;
+        continue;
+      }
+      spun = 0;
+
       // 空闲线程+1
-      idle_threads += 1;
+      pool->idle_threads += 1;
+      // 有线程空闲，说明任务不再积压
+      pool->busy_since = 0;
       // 线程运行至此，休眠（挂起）不消耗CPU周期
-      // 被唤醒时从该行开始执行，然后再次判断 while 条件，如果满足条件就继续等
-      uv_cond_wait(&cond, &mutex);
-      idle_threads -= 1;
+      // 被唤醒后回到循环开头，重新判断是否有任务
+      if (pool->nthreads > pool->min_threads)
+        timed_out = uv_cond_timedwait(&pool->cond,
+                                      &pool->mutex,
+                                      pool->idle_timeout) == UV_ETIMEDOUT;
+      else
+        uv_cond_wait(&pool->cond, &pool->mutex);
+      pool->idle_threads -= 1;
+      continue;
     }
 
+    timed_out = 0;
+    spun = 0;
+
     // 线程被唤醒
     // 取出任务
-    q = QUEUE_HEAD(&wq);
-
-    // 异常，直接退出
-    if (q == &exit_message)
-    {
-      uv_cond_signal(&cond);
-      uv_mutex_unlock(&mutex);
-      break;
-    }
+    q = QUEUE_HEAD(wq);
 
     // 移除头结点
     QUEUE_REMOVE(q);
@@ -158,208 +1044,754 @@ static void worker(void *arg)
 
     // 标识有慢IO操作，run_slow_work_message用于标识有慢IO操作
     // 真正的慢IO队列在slow_io_pending_wq中
-    if (q == &run_slow_work_message)
+    if (q == &pool->run_slow_work_message)
     {
       // 慢IO，重新编排
       // 如果运行慢IO的数量超过总线程数量的一半，那么加入待处理队列尾部，延迟执行(continue)
       // 避免慢 IO 拖垮整体能力
       /* If we're at the slow I/O threshold, re-schedule until after all
          other work in the queue is done. */
-      if (slow_io_work_running >= slow_work_thread_threshold())
+      if (pool->slow_io_work_running >= slow_work_thread_threshold(pool))
       {
-        QUEUE_INSERT_TAIL(&wq, q);
+        QUEUE_INSERT_TAIL(wq, q);
         continue;
       }
 
       /* If we encountered a request to run slow I/O work but there is none
          to run, that means it's cancelled => Start over. */
       // 有run_slow_work_message(post方法提交慢IO任务时，会设置该慢IO任务标识) 但慢IO队列为空，则表示慢IO操作在提交后被取消了
-      if (QUEUE_EMPTY(&slow_io_pending_wq))
+      if (QUEUE_EMPTY(&pool->slow_io_pending_wq))
         continue;
 
       // 开始执行慢IO
       // 标识为慢IO
       is_slow_work = 1;
       // 慢IO运行数量
-      slow_io_work_running++;
+      pool->slow_io_work_running++;
 
       // 从慢IO队列取出一个任务
-      q = QUEUE_HEAD(&slow_io_pending_wq);
+      q = QUEUE_HEAD(&pool->slow_io_pending_wq);
       QUEUE_REMOVE(q);
       QUEUE_INIT(q);
 
       /* If there is more slow I/O work, schedule it to be run as well. */
       // 上面取出一个慢 IO 任务，倘若仍存在慢IO，那么将run_slow_work_message加入wq尾部，用于标识还有慢IO任务
-      if (!QUEUE_EMPTY(&slow_io_pending_wq))
+      if (!QUEUE_EMPTY(&pool->slow_io_pending_wq))
       {
         // 慢IO操作标识加入队列尾部
-        QUEUE_INSERT_TAIL(&wq, &run_slow_work_message);
-        if (idle_threads > 0)
-          // 唤醒空闲线程
-          uv_cond_signal(&cond);
+        QUEUE_INSERT_TAIL(wq, &pool->run_slow_work_message);
+        // 唤醒空闲线程
+        pool_wake(pool);
       }
     }
 
-    uv_mutex_unlock(&mutex);
+    pool->pending--;
+    uv_mutex_unlock(&pool->mutex);
 
     // 取出work执行
     w = QUEUE_DATA(q, struct uv__work, wq);
     // uv__queue_work
     // 这里是同步执行
-    w->work(w);
-
-    // 互斥锁，锁为 loop->wq_mutex，不是 mutex
-    // 因为这里操作的是 loop->wq 队列，为线程共用资源
-    uv_mutex_lock(&w->loop->wq_mutex);
-    // 告知 uv_cancel 该任务已处理完毕
-    w->work = NULL; /* Signal uv_cancel() that the work req is done
-                        executing. */
-
-    // worker线程执行好后，将worker加入主线程事件循环队列中等待执行
-    // 这里加入loop-wq队列为完成的w->wq
-    QUEUE_INSERT_TAIL(&w->loop->wq, &w->wq);
-    // 通知主线程，async_handle通信
-    uv_async_send(&w->loop->wq_async);
-    // 互斥锁解锁
-    uv_mutex_unlock(&w->loop->wq_mutex);
-
-    /* Lock `mutex` since that is expected at the start of the next
+    work_run(pool, w);
+
+    /* Lock `pool->mutex` since that is expected at the start of the next
      * iteration. */
     // 下一循环中先上锁
-    uv_mutex_lock(&mutex);
+    uv_mutex_lock(&pool->mutex);
     if (is_slow_work)
     {
-      /* `slow_io_work_running` is protected by `mutex`. */
+      /* `slow_io_work_running` is protected by `pool->mutex`. */
       // 慢 IO 数量减 1
-      slow_io_work_running--;
+      pool->slow_io_work_running--;
+    }
+
+    // 任务等待太久，再开一个线程
+    if (pool_should_grow(pool))
+    {
+      pool_reserve(pool);
+      uv_mutex_unlock(&pool->mutex);
+      pool_grow(pool, 0);
+      uv_mutex_lock(&pool->mutex);
     }
   }
+
+  pool_exit(pool);
+}
+
+// 可以接收任务的线程编号为 [*first, *first + *count)
+// NUMA_LOCAL 时为提交线程所在节点的线程，该节点没有线程时为全部线程
+static void steal_targets(struct uv__pool *pool,
+                          unsigned int *first,
+                          unsigned int *count)
+{
+  unsigned int node;
+  int cpu;
+
+  *first = 0;
+  *count = pool->max_threads;
+  if (pool->node_first == NULL)
+    return;
+
+  cpu = uv_thread_getcpu();
+  if (cpu < 0 || cpu >= pool->mask_size)
+    return;
+
+  node = pool->cpu_node[cpu];
+  if (pool->node_first[node + 1] == pool->node_first[node])
+    return;
+
+  *first = pool->node_first[node];
+  *count = pool->node_first[node + 1] - *first;
+}
+
+// 工作窃取模式下提交任务，只锁目标线程的队列
+static void steal_post(struct uv__pool *pool,
+                       uv_loop_t *loop,
+                       QUEUE *q,
+                       enum uv__work_kind kind,
+                       uv_work_priority priority)
+{
+  struct uv__pool_worker *wk;
+  unsigned int start;
+  unsigned int first;
+  unsigned int count;
+  int runnable;
+  int parked;
+
+  // 轮流交给各个线程，计数器属于提交任务的 loop，不需要同步
+  steal_targets(pool, &first, &count);
+  start = first + uv__get_internal_fields(loop)->threadpool_next++ % count;
+
+  if (kind == UV__WORK_SLOW_IO)
+  {
+    // 慢IO仍然放进整个线程池共用的队列，才能限制同时执行的数量
+    uv_mutex_lock(&pool->mutex);
+    QUEUE_INSERT_TAIL(&pool->slow_io_pending_wq, q);
+    runnable = pool->slow_io_work_running < slow_work_thread_threshold(pool);
+    uv_mutex_unlock(&pool->mutex);
+
+    if (runnable)
+      steal_wake(pool, start);
+    return;
+  }
+
+  wk = pool->workers + start;
+  uv_mutex_lock(&wk->mutex);
+  // 每个线程只有一个队列，高优先级的任务插到队头
+  if (priority == UV_WORK_PRIORITY_HIGH)
+    QUEUE_INSERT_HEAD(&wk->wq, q);
+  else
+    QUEUE_INSERT_TAIL(&wk->wq, q);
+  parked = wk->parked;
+  if (parked)
+  {
+    wk->parked = 0;
+    uv__pool_fetch_add(&pool->nparked, -1);
+    uv_cond_signal(&wk->cond);
+  }
+  uv_mutex_unlock(&wk->mutex);
+
+  // 目标线程正忙，叫醒一个空闲线程来偷；目标线程在自旋时自己会看到
+  if (!parked && !wk->spinning)
+    steal_wake(pool, start + 1);
 }
 
 // 将 worker 加入执行队列
-static void post(QUEUE *q, enum uv__work_kind kind)
+static void post(struct uv__pool *pool,
+                 uv_loop_t *loop,
+                 QUEUE *q,
+                 enum uv__work_kind kind,
+                 uv_work_priority priority)
 {
+  int grow;
+  int reap;
+
+  if (pool->workers != NULL)
+  {
+    steal_post(pool, loop, q, kind, priority);
+    return;
+  }
+
   // wq队列为线程池共享，因此需要加锁
   // 操作队列，加互斥锁
   // 没有获取到锁的线程，进入队列等待依次获取锁权限
-  uv_mutex_lock(&mutex);
+  uv_mutex_lock(&pool->mutex);
+  pool->pending++;
   // 缓慢IO
   if (kind == UV__WORK_SLOW_IO)
   {
     /* Insert into a separate queue. */
     // 插入缓慢IO队列尾部
-    QUEUE_INSERT_TAIL(&slow_io_pending_wq, q);
+    QUEUE_INSERT_TAIL(&pool->slow_io_pending_wq, q);
 
     // 队列中已有run_slow_work_message，标识已有慢IO任务标识
     // 直接跳过即可
-    if (!QUEUE_EMPTY(&run_slow_work_message))
+    if (!QUEUE_EMPTY(&pool->run_slow_work_message))
     {
       /* Running slow I/O tasks is already scheduled => Nothing to do here.
          The worker that runs said other task will schedule this one as well. */
-      uv_mutex_unlock(&mutex);
+      uv_mutex_unlock(&pool->mutex);
       return;
     }
-    q = &run_slow_work_message;
+    q = &pool->run_slow_work_message;
   }
 
   // 任务入队列
   // 1. 如果非慢IO任务，则q为传入的任务
   // 2. 如果为慢IO任务，则q被重写为run_slow_work_message，并加入队列中
-  QUEUE_INSERT_TAIL(&wq, q);
-  // 关键点：有空闲线程，则唤醒
-  if (idle_threads > 0)
-    // 条件锁,唤醒线程工作
-    uv_cond_signal(&cond);
-  uv_mutex_unlock(&mutex);
+  QUEUE_INSERT_TAIL(&pool->wq[priority], q);
+  grow = 0;
+  // 关键点：有空闲线程，则唤醒（自旋的线程不需要唤醒）
+  // 弹性线程池：没有空闲线程并且任务积压，再创建一个线程
+  if (!pool_wake(pool) && pool_should_grow(pool))
+  {
+    pool_reserve(pool);
+    grow = 1;
+  }
+  reap = pool->nzombies > 0;
+  uv_mutex_unlock(&pool->mutex);
+
+  // 创建和 join 线程都比较慢，不持有锁
+  if (grow)
+    pool_grow(pool, 0);
+  if (reap)
+    pool_reap(pool);
 }
 
-#ifndef _WIN32
-UV_DESTRUCTOR(static void cleanup(void))
+// 工作窃取模式下批量提交，每个线程的队列只锁一次
+static void steal_post_batch(struct uv__pool *pool,
+                             uv_loop_t *loop,
+                             uv_work_t **reqs,
+                             unsigned int n,
+                             uv_work_priority priority)
 {
+  uv__loop_internal_fields_t *lfields;
+  struct uv__pool_worker *wk;
+  unsigned int start;
+  unsigned int first;
+  unsigned int count;
+  unsigned int busy;
+  unsigned int nw;
   unsigned int i;
+  unsigned int j;
 
-  if (nthreads == 0)
+  // 与 steal_post 一样轮流分配，第 i 个任务交给第 start + i 个线程
+  lfields = uv__get_internal_fields(loop);
+  start = lfields->threadpool_next;
+  lfields->threadpool_next += n;
+  steal_targets(pool, &first, &count);
+
+  nw = n < count ? n : count;
+  busy = 0;
+  for (j = 0; j < nw; j++)
+  {
+    wk = pool->workers + first + (start + j) % count;
+    uv_mutex_lock(&wk->mutex);
+    if (priority == UV_WORK_PRIORITY_HIGH)
+    {
+      // 倒着插到队头，批内仍然保持提交顺序
+      i = j + (n - 1 - j) / count * count;
+      for (;;)
+      {
+        QUEUE_INSERT_HEAD(&wk->wq, &work_queued((uv_req_t *)reqs[i], &reqs[i]->work_req)->wq);
+        if (i < count)
+          break;
+        i -= count;
+      }
+    }
+    else
+    {
+      for (i = j; i < n; i += count)
+        QUEUE_INSERT_TAIL(&wk->wq, &work_queued((uv_req_t *)reqs[i], &reqs[i]->work_req)->wq);
+    }
+    if (wk->parked)
+    {
+      wk->parked = 0;
+      uv__pool_fetch_add(&pool->nparked, -1);
+      uv_cond_signal(&wk->cond);
+    }
+    else if (!wk->spinning)
+      busy++;
+    uv_mutex_unlock(&wk->mutex);
+  }
+
+  // 每有一个目标线程正忙，就叫醒一个空闲线程来偷
+  for (i = 0; i < busy; i++)
+    steal_wake(pool, first + (start + nw + i) % count);
+}
+
+// 批量提交，整批只加一次锁，最多唤醒 min(n, 空闲线程数) 个线程
+static void post_batch(struct uv__pool *pool,
+                       uv_loop_t *loop,
+                       uv_work_t **reqs,
+                       unsigned int n,
+                       uv_work_priority priority)
+{
+  unsigned int grow;
+  unsigned int wake;
+  unsigned int i;
+  int reap;
+
+  if (pool->workers != NULL)
+  {
+    steal_post_batch(pool, loop, reqs, n, priority);
     return;
+  }
 
-  // 线程退出信号
-  post(&exit_message, UV__WORK_CPU);
+  uv_mutex_lock(&pool->mutex);
+  for (i = 0; i < n; i++)
+    QUEUE_INSERT_TAIL(&pool->wq[priority], &work_queued((uv_req_t *)reqs[i], &reqs[i]->work_req)->wq);
+  pool->pending += n;
+
+  // 先认领自旋的线程，剩下的任务再唤醒休眠的线程
+  wake = n;
+  for (; wake > 0 && pool->spinners > 0; wake--)
+    pool_wake(pool);
+
+  // 任务不比空闲线程少时全部叫醒，否则一个任务叫醒一个
+  if (wake < pool->idle_threads)
+    for (i = 0; i < wake; i++)
+      uv_cond_signal(&pool->cond);
+  else if (pool->idle_threads > 0)
+    uv_cond_broadcast(&pool->cond);
+
+  // 弹性线程池：空闲线程不够，一次补足
+  grow = 0;
+  while (pool_should_grow(pool))
+  {
+    pool_reserve(pool);
+    grow++;
+  }
+  reap = pool->nzombies > 0;
+  uv_mutex_unlock(&pool->mutex);
 
-  for (i = 0; i < nthreads; i++)
-    if (uv_thread_join(threads + i))
-      abort();
+  while (grow-- > 0)
+    pool_grow(pool, 0);
+  if (reap)
+    pool_reap(pool);
+}
+
+// 释放工作窃取模式下每个线程的状态
+static void pool_free_workers(struct uv__pool *pool, unsigned int n)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+  {
+    uv_cond_destroy(&pool->workers[i].cond);
+    uv_mutex_destroy(&pool->workers[i].mutex);
+  }
+
+  uv__free(pool->workers);
+  pool->workers = NULL;
+}
+
+// 释放固定线程用到的 CPU 和节点信息，可以重复调用
+static void pool_free_cpus(struct uv__pool *pool)
+{
+  uv__free(pool->cpus);
+  uv__free(pool->cpu_node);
+  uv__free(pool->node_first);
+  pool->cpus = NULL;
+  pool->cpu_node = NULL;
+  pool->node_first = NULL;
+}
+
+// 通知所有线程在队列清空后退出并等待其结束，然后释放线程池资源
+static void pool_stop(struct uv__pool *pool)
+{
+  struct uv__pool_worker *wk;
+  unsigned int i;
+
+  uv_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  uv_cond_broadcast(&pool->cond);
+  uv_mutex_unlock(&pool->mutex);
+
+  if (pool->workers != NULL)
+  {
+    for (i = 0; i < pool->max_threads; i++)
+    {
+      wk = pool->workers + i;
+      uv_mutex_lock(&wk->mutex);
+      uv_cond_signal(&wk->cond);
+      uv_mutex_unlock(&wk->mutex);
+    }
+  }
+
+  // 线程退出时会广播 pool->cond
+  uv_mutex_lock(&pool->mutex);
+  while (pool->nthreads > 0)
+    uv_cond_wait(&pool->cond, &pool->mutex);
+  uv_mutex_unlock(&pool->mutex);
+
+  pool_reap(pool);
 
-  if (threads != default_threads)
-    uv__free(threads);
+  if (pool->workers != NULL)
+    pool_free_workers(pool, pool->max_threads);
+  pool_free_cpus(pool);
 
-  uv_mutex_destroy(&mutex);
-  uv_cond_destroy(&cond);
+  uv_mutex_destroy(&pool->metrics_mutex);
+  uv_mutex_destroy(&pool->mutex);
+  uv_cond_destroy(&pool->cond);
+}
+
+#if defined(__linux__)
+// 从 sysfs 读取每个 CPU 所在的 NUMA 节点，返回节点数；没有 NUMA 信息时都在节点 0
+static unsigned int read_numa_nodes(unsigned char *nodes, int size)
+{
+  unsigned int nnodes;
+  unsigned int node;
+  unsigned long first;
+  unsigned long last;
+  char path[64];
+  char buf[1024];
+  char *p;
+  ssize_t n;
+  int fd;
+
+  nnodes = 1;
+  for (node = 0; node < MAX_NUMA_NODES; node++)
+  {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    fd = uv__open_cloexec(path, O_RDONLY);
+    if (fd < 0)
+      continue;
+
+    do
+      n = read(fd, buf, sizeof(buf) - 1);
+    while (n == -1 && errno == EINTR);
+    uv__close(fd);
+    if (n <= 0)
+      continue;
+    buf[n] = '\0';
+
+    // 格式为 "0-3,8-11"
+    p = buf;
+    for (;;)
+    {
+      first = strtoul(p, &p, 10);
+      last = first;
+      if (*p == '-')
+        last = strtoul(p + 1, &p, 10);
+      for (; first <= last && first < (unsigned long)size; first++)
+        nodes[first] = node;
+      if (*p != ',')
+        break;
+      p++;
+    }
+    nnodes = node + 1;
+  }
 
-  threads = NULL;
-  nthreads = 0;
+  return nnodes;
 }
 #endif
 
-// 初始化线程池，线程池默认大小为4
-static void init_threads(void)
+// 固定线程：把本线程可以使用的 CPU 按 NUMA 节点交错排列，线程依次使用
+// numa 非零时保留每个 CPU 所在的节点，提交任务时据此选择同一节点的线程
+static int pool_init_cpus(struct uv__pool *pool, int numa)
+{
+  uv_thread_t self;
+  unsigned char *nodes;
+  unsigned int nnodes;
+  unsigned int node;
+  int *next;
+  char *mask;
+  int progress;
+  int size;
+  int cpu;
+  int err;
+
+  size = uv_cpumask_size();
+  if (size < 0)
+    return size;
+
+  mask = uv__malloc(size);
+  nodes = uv__calloc(size, 1);
+  pool->cpus = uv__malloc(size * sizeof(pool->cpus[0]));
+  next = NULL;
+  err = UV_ENOMEM;
+  if (mask == NULL || nodes == NULL || pool->cpus == NULL)
+    goto out;
+
+  self = uv_thread_self();
+  err = uv_thread_getaffinity(&self, mask, size);
+  if (err)
+    goto out;
+
+  nnodes = 1;
+#if defined(__linux__)
+  nnodes = read_numa_nodes(nodes, size);
+#endif
+
+  err = UV_ENOMEM;
+  next = uv__calloc(nnodes, sizeof(next[0]));
+  if (next == NULL)
+    goto out;
+
+  // 每一轮从每个节点各取一个 CPU，相邻的线程落在不同的节点上
+  pool->ncpus = 0;
+  do
+  {
+    progress = 0;
+    for (node = 0; node < nnodes; node++)
+    {
+      for (cpu = next[node]; cpu < size; cpu++)
+        if (mask[cpu] && nodes[cpu] == node)
+          break;
+      if (cpu == size)
+        continue;
+      next[node] = cpu + 1;
+      pool->cpus[pool->ncpus++] = cpu;
+      progress = 1;
+    }
+  } while (progress);
+
+  err = 0;
+  pool->mask_size = size;
+  pool->next_cpu = 0;
+  if (numa)
+  {
+    pool->cpu_node = nodes;
+    pool->nnodes = nnodes;
+    nodes = NULL;
+  }
+
+out:
+  uv__free(next);
+  uv__free(nodes);
+  uv__free(mask);
+  if (err)
+    pool_free_cpus(pool);
+  return err;
+}
+
+// 工作窃取模式下为每个线程分配 CPU；按节点时同一节点的线程编号相邻
+static int pool_assign_cpus(struct uv__pool *pool)
 {
+  struct uv__pool_worker *wk;
+  unsigned int node;
   unsigned int i;
-  const char *val;
-  uv_sem_t sem;
+  unsigned int j;
+  int cpu;
 
-  nthreads = ARRAY_SIZE(default_threads);
-  // 获取外部配置的线程池大小，最大可为1024个
-  val = getenv("UV_THREADPOOL_SIZE");
-  if (val != NULL)
-    // 将字符串值转换为整数值，如果转换失败，则返回0
-    nthreads = atoi(val);
-  if (nthreads == 0)
-    // 如果线程池大小为0(上一步转换失败)，则赋值为1
-    nthreads = 1;
-  if (nthreads > MAX_THREADPOOL_SIZE)
-    // 上限限定
-    nthreads = MAX_THREADPOOL_SIZE;
+  wk = pool->workers;
+  for (i = 0; i < pool->max_threads; i++)
+    wk[i].cpu = pool->cpus[i % pool->ncpus];
+
+  if (pool->cpu_node == NULL)
+    return 0;
+
+  pool->node_first = uv__calloc(pool->nnodes + 1, sizeof(pool->node_first[0]));
+  if (pool->node_first == NULL)
+    return UV_ENOMEM;
 
-  threads = default_threads;
-  if (nthreads > ARRAY_SIZE(default_threads))
+  // 按节点做稳定的插入排序，只在创建线程池时执行一次
+  for (i = 1; i < pool->max_threads; i++)
   {
-    // 分配内存空间
-    threads = uv__malloc(nthreads * sizeof(threads[0]));
-    if (threads == NULL)
+    cpu = wk[i].cpu;
+    node = pool->cpu_node[cpu];
+    for (j = i; j > 0 && pool->cpu_node[wk[j - 1].cpu] > node; j--)
+      wk[j].cpu = wk[j - 1].cpu;
+    wk[j].cpu = cpu;
+  }
+
+  for (i = 0; i < pool->max_threads; i++)
+    pool->node_first[pool->cpu_node[wk[i].cpu] + 1]++;
+  for (node = 0; node < pool->nnodes; node++)
+    pool->node_first[node + 1] += pool->node_first[node];
+
+  return 0;
+}
+
+// 工作窃取模式下初始化每个线程的状态
+static int pool_init_workers(struct uv__pool *pool)
+{
+  struct uv__pool_worker *wk;
+  unsigned int i;
+  int err;
+
+  pool->workers = uv__calloc(pool->max_threads, sizeof(pool->workers[0]));
+  if (pool->workers == NULL)
+    return UV_ENOMEM;
+
+  for (i = 0; i < pool->max_threads; i++)
+  {
+    wk = pool->workers + i;
+    QUEUE_INIT(&wk->wq);
+
+    err = uv_mutex_init(&wk->mutex);
+    if (err)
+      break;
+
+    err = uv_cond_init(&wk->cond);
+    if (err)
     {
-      nthreads = ARRAY_SIZE(default_threads);
-      threads = default_threads;
+      uv_mutex_destroy(&wk->mutex);
+      break;
     }
   }
 
+  if (err)
+  {
+    pool_free_workers(pool, i);
+    return err;
+  }
+
+  if (pool->cpus != NULL)
+    err = pool_assign_cpus(pool);
+
+  if (err)
+    pool_free_workers(pool, pool->max_threads);
+
+  return err;
+}
+
+// 初始化线程池并启动 min_threads 个线程
+// 调用方已经设置好 min_threads、max_threads 和扩缩容参数
+static int pool_start(struct uv__pool *pool, int steal)
+{
+  unsigned int i;
+  int err;
+
+  pool->idle_threads = 0;
+  pool->spinners = 0;
+  pool->spin_claims = 0;
+  pool->slow_io_work_running = 0;
+  pool->nthreads = 0;
+  pool->starting = 0;
+  pool->pending = 0;
+  pool->busy_since = 0;
+  pool->refs = 0;
+  pool->stop = 0;
+  pool->nparked = 0;
+  pool->nzombies = 0;
+  pool->workers = NULL;
+  memset(pool->queue_time, 0, sizeof(pool->queue_time));
+  memset(pool->run_time, 0, sizeof(pool->run_time));
+
   // 初始化条件锁，阻塞状态
-  if (uv_cond_init(&cond))
-    abort();
+  err = uv_cond_init(&pool->cond);
+  if (err)
+    return err;
 
   // 初始化互斥锁
-  if (uv_mutex_init(&mutex))
-    abort();
+  err = uv_mutex_init(&pool->mutex);
+  if (err)
+  {
+    uv_cond_destroy(&pool->cond);
+    return err;
+  }
+
+  err = uv_mutex_init(&pool->metrics_mutex);
+  if (err)
+  {
+    uv_mutex_destroy(&pool->mutex);
+    uv_cond_destroy(&pool->cond);
+    return err;
+  }
 
   // 初始化工作队列
-  QUEUE_INIT(&wq);
+  for (i = 0; i < WORK_PRIORITIES; i++)
+  {
+    QUEUE_INIT(&pool->wq[i]);
+    pool->passes[i] = 0;
+  }
   // 初始化慢IO队列
-  QUEUE_INIT(&slow_io_pending_wq);
+  QUEUE_INIT(&pool->slow_io_pending_wq);
   // 初始化慢IO标志队列，用于标识是否存在慢IO操作
   // 相当于指定代表排队
-  QUEUE_INIT(&run_slow_work_message);
+  QUEUE_INIT(&pool->run_slow_work_message);
+
+  if (steal)
+    err = pool_init_workers(pool);
+
+  if (err)
+  {
+    uv_mutex_destroy(&pool->metrics_mutex);
+    uv_mutex_destroy(&pool->mutex);
+    uv_cond_destroy(&pool->cond);
+    return err;
+  }
+
+  // 不等线程启动完成，其余线程在任务积压时再创建
+  for (i = 0; i < pool->min_threads; i++)
+  {
+    uv_mutex_lock(&pool->mutex);
+    pool_reserve(pool);
+    uv_mutex_unlock(&pool->mutex);
+
+    err = pool_grow(pool, i);
+    if (err)
+      break;
+  }
+
+  if (err)
+    pool_stop(pool);
+
+  return err;
+}
+
+#ifndef _WIN32
+UV_DESTRUCTOR(static void cleanup(void))
+{
+  if (default_pool.max_threads == 0)
+    return;
+
+  pool_stop(&default_pool);
+  default_pool.max_threads = 0;
+}
+#endif
+
+// 初始化默认线程池，线程池默认大小为4
+static void init_threads(void)
+{
+  unsigned int nthreads;
+  const char *val;
+
+  nthreads = DEFAULT_THREADPOOL_SIZE;
+  // 获取外部配置的线程池大小，最大可为1024个
+  val = getenv("UV_THREADPOOL_SIZE");
+  if (val != NULL)
+    // 将字符串值转换为整数值，如果转换失败，则返回0
+    nthreads = atoi(val);
+  if (nthreads == 0)
+    // 如果线程池大小为0(上一步转换失败)，则赋值为1
+    nthreads = 1;
+  if (nthreads > MAX_THREADPOOL_SIZE)
+    // 上限限定
+    nthreads = MAX_THREADPOOL_SIZE;
 
-  // 初始化信号量锁
-  if (uv_sem_init(&sem, 0))
+  default_pool.min_threads = nthreads;
+  default_pool.max_threads = nthreads;
+  // 启动前调用过 uv_threadpool_set_limits(NULL, ...)，按需启动线程
+  if (default_max_threads != 0)
+  {
+    default_pool.min_threads = default_min_threads;
+    default_pool.max_threads = default_max_threads;
+  }
+  default_pool.grow_depth = 1;
+  default_pool.grow_wait = 0;
+  default_pool.idle_timeout = (uint64_t)DEFAULT_IDLE_TIMEOUT * 1000000;
+  default_pool.slow_io_percent = DEFAULT_SLOW_IO_PERCENT;
+  val = getenv("UV_THREADPOOL_SLOW_IO_PERCENT");
+  if (val != NULL && atoi(val) > 0 && atoi(val) <= 100)
+    default_pool.slow_io_percent = atoi(val);
+  // 默认线程池通过环境变量开启统计
+  val = getenv("UV_THREADPOOL_METRICS");
+  default_pool.metrics = val != NULL && atoi(val) != 0;
+  // 默认线程池通过环境变量开启自旋，值为自旋的微秒数
+  val = getenv("UV_THREADPOOL_SPIN_US");
+  default_pool.spin_time = 0;
+  if (val != NULL && atoi(val) > 0 && pool_ncpus() > 1)
+    default_pool.spin_time = (uint64_t)atoi(val) * 1000;
+  // 默认线程池通过环境变量固定线程，不支持时不固定
+  val = getenv("UV_THREADPOOL_PIN_THREADS");
+  if (val != NULL && atoi(val) != 0)
+    pool_init_cpus(&default_pool, 0);
+
+  if (pool_start(&default_pool, 0))
     abort();
-
-  for (i = 0; i < nthreads; i++)
-    // 创建线程
-    if (uv_thread_create(threads + i, worker, &sem))
-      abort();
-
-  for (i = 0; i < nthreads; i++)
-    uv_sem_wait(&sem);
-
-  uv_sem_destroy(&sem);
 }
 
 #ifndef _WIN32
@@ -384,32 +1816,104 @@ static void init_once(void)
   init_threads();
 }
 
+// 找到 loop 上 kind 类型任务对应的线程池，没有指定则使用默认线程池
+static struct uv__pool *uv__pool_get(uv_loop_t *loop, enum uv__work_kind kind)
+{
+  uv_threadpool_t *tp;
+
+  tp = uv__get_internal_fields(loop)->threadpools[kind];
+  if (tp != NULL)
+    return tp->internal;
+
+  // 保证多次提交只会初始化一次
+  // 默认线程池是在第一次有作业的时候初始化的，属于延迟初始化
+  uv_once(&once, init_once);
+  return &default_pool;
+}
+
+// 任务需要计时（线程池开启了统计或者 loop 设置了 uv_work_timing_cb）时返回当前时间，否则返回 0
+static uint64_t work_clock(uv_loop_t *loop, struct uv__pool *pool)
+{
+  if (!pool->metrics && uv__get_internal_fields(loop)->work_timing_cb == NULL)
+    return 0;
+
+  return uv_hrtime();
+}
+
+// 返回交给线程池排队的 uv__work：需要计时的任务包一层 uv__timed_work，
+// 分配失败时不计时
+static struct uv__work *work_wrap(struct uv__pool *pool,
+                                  uv_req_t *req,
+                                  struct uv__work *w,
+                                  enum uv__work_kind kind,
+                                  uint64_t submit_time)
+{
+  struct uv__timed_work *t;
+
+  work_timed(req) = NULL;
+  if (submit_time == 0)
+    return w;
+
+  t = uv__malloc(sizeof(*t));
+  if (t == NULL)
+    return w;
+
+  t->work.loop = w->loop;
+  t->work.work = timed_work;
+  t->work.done = timed_done;
+  t->inner = w;
+  t->pool = pool;
+  t->req = req;
+  t->kind = kind;
+  t->submit_time = submit_time;
+  work_timed(req) = t;
+
+  return &t->work;
+}
+
 // 提交作业到线程池执行队列
 // uv__work 包含三个属性
 // work: 作业函数
 // done: 为完成回调
 // loop: 为绑定到的主循环
 // wq: 为双向队列节点(用于插入 uv__work 到队列中)
-void uv__work_submit(uv_loop_t *loop,
-                     struct uv__work *w,
-                     enum uv__work_kind kind,
-                     void (*work)(struct uv__work *w),
-                     void (*done)(struct uv__work *w, int status))
+static void work_submit(uv_loop_t *loop,
+                        uv_req_t *req,
+                        struct uv__work *w,
+                        enum uv__work_kind kind,
+                        uv_work_priority priority,
+                        void (*work)(struct uv__work *w),
+                        void (*done)(struct uv__work *w, int status))
 {
-  // 保证多次提交只会初始化一次
-  // 线程池是在第一次有作业的时候初始化的，属于延迟初始化
-  uv_once(&once, init_once);
+  struct uv__pool *pool;
+
+  pool = uv__pool_get(loop, kind);
   // 绑定loop, work, done函数
   w->loop = loop;
   w->work = work;
   w->done = done;
+  work_pool(req) = pool;
+  w = work_wrap(pool, req, w, kind, work_clock(loop, pool));
   // w-wq是双向队列，因此数组长度为2
   // UV__WORK_CPU, 计算性
   // UV__WORK_FAST_IO, 快IO
   // UV__WORK_SLOW_IO 慢IO
 
+  // 完成回调执行之前线程池不能关闭，uv_cancel 还会用到它
+  uv__pool_fetch_add(&pool->outstanding, 1);
   // 将 uv__work 加入执行队列
-  post(&w->wq, kind);
+  post(pool, loop, &w->wq, kind, priority);
+}
+
+// 内部任务（文件操作、DNS）都是普通优先级
+void uv__work_submit(uv_loop_t *loop,
+                     uv_req_t *req,
+                     struct uv__work *w,
+                     enum uv__work_kind kind,
+                     void (*work)(struct uv__work *w),
+                     void (*done)(struct uv__work *w, int status))
+{
+  work_submit(loop, req, w, kind, UV_WORK_PRIORITY_NORMAL, work, done);
 }
 
 // 取消作业
@@ -420,30 +1924,47 @@ void uv__work_submit(uv_loop_t *loop,
  */
 static int uv__work_cancel(uv_loop_t *loop, uv_req_t *req, struct uv__work *w)
 {
+  struct uv__pool *pool;
+  unsigned int i;
   int cancelled;
 
-  uv_mutex_lock(&mutex);
-  uv_mutex_lock(&w->loop->wq_mutex);
+  pool = work_pool(req);
+  w = work_queued(req, w);
+  // 工作窃取模式下任务可能在任意一个线程的队列里，全部锁上
+  if (pool->workers != NULL)
+    for (i = 0; i < pool->max_threads; i++)
+      uv_mutex_lock(&pool->workers[i].mutex);
+  uv_mutex_lock(&pool->mutex);
 
-  // 能取消
-  cancelled = !QUEUE_EMPTY(&w->wq) && w->work != NULL;
+  // 能取消：还在线程池的队列里；线程取走任务时会把 w->wq 置空
+  cancelled = !QUEUE_EMPTY(&w->wq);
   if (cancelled)
+  {
     QUEUE_REMOVE(&w->wq);
+    QUEUE_INIT(&w->wq);
+    if (pool->workers == NULL)
+      pool->pending--;
+  }
 
-  uv_mutex_unlock(&w->loop->wq_mutex);
-  uv_mutex_unlock(&mutex);
+  uv_mutex_unlock(&pool->mutex);
+  if (pool->workers != NULL)
+    for (i = 0; i < pool->max_threads; i++)
+      uv_mutex_unlock(&pool->workers[i].mutex);
 
   if (!cancelled)
     return UV_EBUSY;
 
+  // 没有执行，排队到取消为止
+  if (work_timed(req) != NULL)
+  {
+    work_timed(req)->start_time = uv_hrtime();
+    work_timed(req)->done_time = work_timed(req)->start_time;
+  }
+
   // 将作业重新赋值为 uv__cancelled，其内部为 abort 操作
   w->work = uv__cancelled;
-  uv_mutex_lock(&loop->wq_mutex);
-  // 将任务追加至 loop->wq 尾部，并直接通知 loop
-  // 意味着 被取消的任务仍然会放入 loop->wq 中等待执行
-  QUEUE_INSERT_TAIL(&loop->wq, &w->wq);
-  uv_async_send(&loop->wq_async);
-  uv_mutex_unlock(&loop->wq_mutex);
+  // 被取消的任务仍然会放入完成栈中，由 loop 执行完成回调
+  work_push_done(loop, pool, w);
 
   return 0;
 }
@@ -452,29 +1973,49 @@ static int uv__work_cancel(uv_loop_t *loop, uv_req_t *req, struct uv__work *w)
 // 执行所有work
 void uv__work_done(uv_async_t *handle)
 {
+  uv__loop_internal_fields_t *lfields;
+  struct uv__pool *pool;
+  struct uv__work *next;
+  struct uv__work *prev;
+  struct uv__work *old;
   struct uv__work *w;
   uv_loop_t *loop;
-  QUEUE *q;
-  QUEUE wq;
   int err;
 
   // 找到loop
   loop = container_of(handle, uv_loop_t, wq_async);
-  // 这里将 loop->wq 拷贝到 wq，最小化 loop->wq 被锁定的时间
-  uv_mutex_lock(&loop->wq_mutex);
-  // 获取loop中的wq队里
-  QUEUE_MOVE(&loop->wq, &wq);
-  uv_mutex_unlock(&loop->wq_mutex);
+  lfields = uv__get_internal_fields(loop);
 
-  // 执行所有已完成IO的回调
-  while (!QUEUE_EMPTY(&wq))
+  // 一次取走整个完成栈
+  w = NULL;
+  for (;;)
   {
-    q = QUEUE_HEAD(&wq);
-    // 移除 q, 保证 while 循环条件能正常终止
-    QUEUE_REMOVE(q);
+    old = uv__pool_cas_ptr(&lfields->work_done, w, NULL);
+    if (old == w)
+      break;
+    w = old;
+  }
 
-    // 找到uv__work
-    w = container_of(q, struct uv__work, wq);
+  // 栈是后进先出的，反转成完成的顺序
+  prev = NULL;
+  while (w != NULL)
+  {
+    next = work_next(w);
+    work_next(w) = prev;
+    prev = w;
+    w = next;
+  }
+
+  // 执行所有已完成IO的回调
+  for (w = prev; w != NULL; w = next)
+  {
+    // 回调可能释放或重新提交 w，先取出下一个
+    next = work_next(w);
+    pool = work_done_pool(w);
+    w->loop = loop;
+    // 在回调之前放开线程池，回调里可以关闭它
+    if (pool != NULL)
+      uv__pool_fetch_add(&pool->outstanding, -1);
     // 判定该为取消过的任务，回传特定错误信息
     err = (w->work == uv__cancelled) ? UV_ECANCELED : 0;
     // 执行结束回调（用户传入的回调）
@@ -483,11 +2024,34 @@ void uv__work_done(uv_async_t *handle)
   }
 }
 
+// 截止时间不一定按 8 字节对齐，按字节复制
+static uint64_t work_deadline(const uv_work_t *req)
+{
+  uint64_t deadline;
+
+  memcpy(&deadline, &req->reserved[WORK_DEADLINE_SLOT], sizeof(deadline));
+  return deadline;
+}
+
+static void work_set_deadline(uv_work_t *req, uint64_t deadline)
+{
+  memcpy(&req->reserved[WORK_DEADLINE_SLOT], &deadline, sizeof(deadline));
+}
+
 // 处理中
 static void uv__queue_work(struct uv__work *w)
 {
   // 根据work_req属性在uv_work_t类型中的位置，获取req的地址
   uv_work_t *req = container_of(w, uv_work_t, work_req);
+  uint64_t deadline;
+
+  // 过了截止时间，不再执行
+  deadline = work_deadline(req);
+  if (deadline != 0 && uv_hrtime() >= deadline)
+  {
+    work_set_deadline(req, WORK_EXPIRED);
+    return;
+  }
 
   req->work_cb(req);
 }
@@ -495,6 +2059,7 @@ static void uv__queue_work(struct uv__work *w)
 // 处理完成
 static void uv__queue_done(struct uv__work *w, int err)
 {
+  uv_work_batch_t *batch;
   uv_work_t *req;
 
   // 根据uv__work在uv_work_t中的位置反推req地址
@@ -504,14 +2069,78 @@ static void uv__queue_done(struct uv__work *w, int err)
   // active_reqs会影响到事件循环的允许
   uv__req_unregister(req->loop, req);
 
-  // 没有设定回调函数，直接返回
-  if (req->after_work_cb == NULL)
-    return;
+  // 回调可能释放或重新提交 req，先取出所属的批次
+  batch = work_batch(req);
+
+  if (err == 0 && work_deadline(req) == WORK_EXPIRED)
+    err = UV_ETIMEDOUT;
 
   // 执行回调
   // 将req回传给完成回调函数，在执行worker期间对req做的任何修改均会反应到req中
   // 完成回调函数能获取到req中的值，req->data（用于用户自定义数据）
-  req->after_work_cb(req, err);
+  if (req->after_work_cb != NULL)
+    req->after_work_cb(req, err);
+
+  if (batch == NULL)
+    return;
+
+  // 完成回调都在 loop 线程执行，计数不需要同步
+  if (err != 0)
+    batch->nfailed++;
+  // 整批的最后一个任务完成后执行批次回调
+  if (--batch->npending == 0 && batch->batch_cb != NULL)
+    batch->batch_cb(batch);
+}
+
+// 检查提交选项，得到优先级和截止时间；options 为 NULL 时使用默认值
+static int work_options(const uv_work_options_t *options,
+                        uv_work_priority *priority,
+                        uint64_t *deadline)
+{
+  uint64_t timeout;
+  uint64_t now;
+
+  *priority = UV_WORK_PRIORITY_NORMAL;
+  timeout = 0;
+  if (options != NULL)
+  {
+    *priority = options->priority;
+    timeout = options->timeout;
+  }
+
+  if ((unsigned int)*priority >= WORK_PRIORITIES)
+    return UV_EINVAL;
+
+  // 截止时间，0 表示没有；远到会溢出的截止时间也当作没有
+  *deadline = 0;
+  if (timeout != 0)
+  {
+    now = uv_hrtime();
+    if (timeout < (WORK_EXPIRED - now) / 1000000)
+      *deadline = now + timeout * 1000000;
+  }
+
+  return 0;
+}
+
+// 初始化req，绑定主循环，回调函数
+// 1. 设定作业请求类型，用于uv_cancel函数
+// 2. 主循环active_reqs数 + 1
+// 3. 绑定主循环
+// 4. 将自身添加至loop->handle_queue
+static void work_req_init(uv_loop_t *loop,
+                          uv_work_t *req,
+                          uint64_t deadline,
+                          uv_work_batch_t *batch,
+                          uv_work_cb work_cb,
+                          uv_after_work_cb after_work_cb)
+{
+  uv__req_init(loop, req, UV_WORK);
+  req->loop = loop;
+  req->work_cb = work_cb;
+  req->after_work_cb = after_work_cb;
+  work_set_deadline(req, deadline);
+  work_batch(req) = batch;
 }
 
 // 提交用户worker入口
@@ -520,28 +2149,95 @@ int uv_queue_work(uv_loop_t *loop,
                   uv_work_cb work_cb,
                   uv_after_work_cb after_work_cb)
 {
+  return uv_queue_work_ex(loop, req, NULL, work_cb, after_work_cb);
+}
+
+// 带优先级和截止时间提交，options 为 NULL 时与 uv_queue_work 相同
+int uv_queue_work_ex(uv_loop_t *loop,
+                     uv_work_t *req,
+                     const uv_work_options_t *options,
+                     uv_work_cb work_cb,
+                     uv_after_work_cb after_work_cb)
+{
+  uv_work_priority priority;
+  uint64_t deadline;
+  int err;
+
   if (work_cb == NULL)
     return UV_EINVAL;
 
-  // 初始化req，绑定主循环，回调函数
-  // 1. 设定作业请求类型，用于uv_cancel函数
-  // 2. 主循环active_reqs数 + 1
-  // 3. 绑定主循环
-  // 4. 将自身添加至loop->handle_queue
-  uv__req_init(loop, req, UV_WORK);
-  req->loop = loop;
-  req->work_cb = work_cb;
-  req->after_work_cb = after_work_cb;
+  err = work_options(options, &priority, &deadline);
+  if (err)
+    return err;
+
+  work_req_init(loop, req, deadline, NULL, work_cb, after_work_cb);
+
   // 开始处理
-  uv__work_submit(loop,
-                  // work_req为uv/threadpool.h中的uv__work
-                  &req->work_req,
-                  // 任务类型
-                  UV__WORK_CPU,
-                  // 线程池中执行的任务
-                  uv__queue_work,
-                  // 任务执行完毕回调函数
-                  uv__queue_done);
+  work_submit(loop,
+              (uv_req_t *)req,
+              // work_req为uv/threadpool.h中的uv__work
+              &req->work_req,
+              // 任务类型
+              UV__WORK_CPU,
+              priority,
+              // 线程池中执行的任务
+              uv__queue_work,
+              // 任务执行完毕回调函数
+              uv__queue_done);
+  return 0;
+}
+
+// 批量提交，整批只加一次锁；batch 不为 NULL 时整批完成后执行 batch_cb
+int uv_queue_work_batch(uv_loop_t *loop,
+                        uv_work_t *reqs[],
+                        unsigned int nreqs,
+                        const uv_work_options_t *options,
+                        uv_work_cb work_cb,
+                        uv_after_work_cb after_work_cb,
+                        uv_work_batch_t *batch,
+                        uv_after_work_batch_cb batch_cb)
+{
+  uv_work_priority priority;
+  struct uv__pool *pool;
+  struct uv__work *w;
+  uint64_t submit_time;
+  uint64_t deadline;
+  unsigned int i;
+  int err;
+
+  if (reqs == NULL || nreqs == 0 || work_cb == NULL)
+    return UV_EINVAL;
+
+  if (batch == NULL && batch_cb != NULL)
+    return UV_EINVAL;
+
+  err = work_options(options, &priority, &deadline);
+  if (err)
+    return err;
+
+  if (batch != NULL)
+  {
+    batch->nreqs = nreqs;
+    batch->nfailed = 0;
+    batch->npending = nreqs;
+    batch->batch_cb = batch_cb;
+  }
+
+  pool = uv__pool_get(loop, UV__WORK_CPU);
+  submit_time = work_clock(loop, pool);
+  for (i = 0; i < nreqs; i++)
+  {
+    work_req_init(loop, reqs[i], deadline, batch, work_cb, after_work_cb);
+    w = &reqs[i]->work_req;
+    w->loop = loop;
+    w->work = uv__queue_work;
+    w->done = uv__queue_done;
+    work_pool((uv_req_t *)reqs[i]) = pool;
+    work_wrap(pool, (uv_req_t *)reqs[i], w, UV__WORK_CPU, submit_time);
+  }
+
+  uv__pool_fetch_add(&pool->outstanding, nreqs);
+  post_batch(pool, loop, reqs, nreqs, priority);
   return 0;
 }
 
@@ -578,3 +2274,343 @@ int uv_cancel(uv_req_t *req)
 
   return uv__work_cancel(loop, req, wreq);
 }
+
+// 创建线程池
+int uv_threadpool_init(uv_threadpool_t *tp,
+                       const uv_threadpool_options_t *options)
+{
+  struct uv__pool *pool;
+  unsigned int min_threads;
+  unsigned int nthreads;
+  unsigned int flags;
+  const char *name;
+  int err;
+
+  nthreads = DEFAULT_THREADPOOL_SIZE;
+  flags = 0;
+  name = NULL;
+  if (options != NULL)
+  {
+    if (options->nthreads != 0)
+      nthreads = options->nthreads;
+    flags = options->flags;
+    name = options->name;
+  }
+
+  if (flags & ~(UV_THREADPOOL_WORK_STEALING | UV_THREADPOOL_ELASTIC |
+                UV_THREADPOOL_ENABLE_METRICS | UV_THREADPOOL_PIN_THREADS |
+                UV_THREADPOOL_NUMA_LOCAL | UV_THREADPOOL_SPIN))
+    return UV_EINVAL;
+
+  // 工作窃取模式下每个线程有自己的队列，线程数固定
+  if ((flags & UV_THREADPOOL_WORK_STEALING) && (flags & UV_THREADPOOL_ELASTIC))
+    return UV_EINVAL;
+
+  // 只有工作窃取模式下任务才交给指定的线程
+  if ((flags & UV_THREADPOOL_NUMA_LOCAL) &&
+      !(flags & UV_THREADPOOL_WORK_STEALING))
+    return UV_EINVAL;
+
+  if (nthreads > MAX_THREADPOOL_SIZE)
+    return UV_EINVAL;
+
+  min_threads = nthreads;
+  if (flags & UV_THREADPOOL_ELASTIC)
+    min_threads = options->min_threads;
+
+  if (min_threads > nthreads)
+    return UV_EINVAL;
+
+  if (options != NULL && options->slow_io_percent > 100)
+    return UV_EINVAL;
+
+  pool = uv__calloc(1, sizeof(*pool));
+  if (pool == NULL)
+    return UV_ENOMEM;
+
+  pool->min_threads = min_threads;
+  pool->max_threads = nthreads;
+  pool->grow_depth = 1;
+  pool->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  pool->metrics = (flags & UV_THREADPOOL_ENABLE_METRICS) != 0;
+  pool->slow_io_percent = DEFAULT_SLOW_IO_PERCENT;
+  if (options != NULL && options->slow_io_percent != 0)
+    pool->slow_io_percent = options->slow_io_percent;
+  // 只有一个 CPU 时自旋的线程只会抢走 loop 线程的时间
+  if ((flags & UV_THREADPOOL_SPIN) && pool_ncpus() > 1)
+  {
+    pool->spin_time = DEFAULT_SPIN_US;
+    if (options->spin_us != 0)
+      pool->spin_time = options->spin_us;
+    pool->spin_time *= 1000;
+  }
+  if (flags & UV_THREADPOOL_ELASTIC)
+  {
+    if (options->grow_queue_depth != 0)
+      pool->grow_depth = options->grow_queue_depth;
+    pool->grow_wait = (uint64_t)options->grow_wait_ms * 1000000;
+    if (options->idle_timeout_ms != 0)
+      pool->idle_timeout = options->idle_timeout_ms;
+  }
+  pool->idle_timeout *= 1000000;
+
+  // 线程名最长 15 个字符
+  if (name != NULL)
+    uv__strscpy(pool->name, name, sizeof(pool->name));
+
+  if (flags & (UV_THREADPOOL_PIN_THREADS | UV_THREADPOOL_NUMA_LOCAL))
+  {
+    err = pool_init_cpus(pool, flags & UV_THREADPOOL_NUMA_LOCAL);
+    if (err)
+    {
+      uv__free(pool);
+      return err;
+    }
+  }
+
+  err = pool_start(pool, flags & UV_THREADPOOL_WORK_STEALING);
+  if (err)
+  {
+    pool_free_cpus(pool);
+    uv__free(pool);
+    return err;
+  }
+
+  tp->nthreads = nthreads;
+  tp->internal = pool;
+  return 0;
+}
+
+// 关闭线程池；仍有 loop 路由到该线程池，或者还有任务没执行完成回调时返回 UV_EBUSY
+int uv_threadpool_close(uv_threadpool_t *tp)
+{
+  struct uv__pool *pool;
+  int busy;
+
+  pool = tp->internal;
+  if (pool == NULL)
+    return UV_EINVAL;
+
+  uv_mutex_lock(&pool->mutex);
+  busy = pool->refs != 0 || uv__pool_fetch_add(&pool->outstanding, 0) != 0;
+  uv_mutex_unlock(&pool->mutex);
+
+  if (busy)
+    return UV_EBUSY;
+
+  pool_stop(pool);
+  uv__free(pool);
+
+  tp->nthreads = 0;
+  tp->internal = NULL;
+  return 0;
+}
+
+// 运行时调整线程数上下限，pool 为 NULL 时调整全局默认线程池
+// 线程数少于下限时立即补齐，多于上限的线程做完手头的任务后退出
+int uv_threadpool_set_limits(uv_threadpool_t *tp,
+                             unsigned int min_threads,
+                             unsigned int max_threads)
+{
+  struct uv__pool *pool;
+  unsigned int n;
+
+  if (max_threads == 0 || max_threads > MAX_THREADPOOL_SIZE)
+    return UV_EINVAL;
+
+  if (min_threads > max_threads)
+    return UV_EINVAL;
+
+  if (tp == NULL)
+  {
+    // 默认线程池还没启动时，启动时只创建 min_threads 个线程
+    default_min_threads = min_threads;
+    default_max_threads = max_threads;
+    uv_once(&once, init_once);
+    pool = &default_pool;
+  }
+  else
+  {
+    pool = tp->internal;
+    if (pool == NULL)
+      return UV_EINVAL;
+  }
+
+  if (pool->workers != NULL)
+    return UV_ENOTSUP;
+
+  uv_mutex_lock(&pool->mutex);
+  pool->min_threads = min_threads;
+  pool->max_threads = max_threads;
+  n = 0;
+  while (pool->nthreads < min_threads)
+  {
+    pool_reserve(pool);
+    n++;
+  }
+  // 叫醒空闲线程按新的上下限决定退出还是限时等待
+  uv_cond_broadcast(&pool->cond);
+  uv_mutex_unlock(&pool->mutex);
+
+  if (tp != NULL)
+    tp->nthreads = max_threads;
+
+  while (n-- > 0)
+    pool_grow(pool, 0);
+
+  pool_reap(pool);
+  return 0;
+}
+
+// 当前的线程数
+unsigned int uv_threadpool_running_threads(const uv_threadpool_t *tp)
+{
+  struct uv__pool *pool;
+  unsigned int n;
+
+  pool = tp->internal;
+  if (pool == NULL)
+    return 0;
+
+  uv_mutex_lock(&pool->mutex);
+  n = pool->nthreads;
+  uv_mutex_unlock(&pool->mutex);
+
+  return n;
+}
+
+// 读取线程池的统计，pool 为 NULL 时读取全局默认线程池
+// 耗时直方图只在开启统计时有数据，队列长度、线程数等当前值总是有效
+int uv_threadpool_metrics(const uv_threadpool_t *tp,
+                          uv_threadpool_metrics_t *metrics)
+{
+  struct uv__pool_worker *wk;
+  struct uv__pool *pool;
+  unsigned int queued;
+  unsigned int i;
+  QUEUE *q;
+
+  if (metrics == NULL)
+    return UV_EINVAL;
+
+  if (tp == NULL)
+  {
+    uv_once(&once, init_once);
+    pool = &default_pool;
+  }
+  else
+  {
+    pool = tp->internal;
+    if (pool == NULL)
+      return UV_EINVAL;
+  }
+
+  uv_mutex_lock(&pool->metrics_mutex);
+  memcpy(metrics->queue_time, pool->queue_time, sizeof(pool->queue_time));
+  memcpy(metrics->run_time, pool->run_time, sizeof(pool->run_time));
+  uv_mutex_unlock(&pool->metrics_mutex);
+
+  // 工作窃取模式下没有统计排队的任务数，数一遍每个线程的队列
+  queued = 0;
+  if (pool->workers != NULL)
+  {
+    for (i = 0; i < pool->max_threads; i++)
+    {
+      wk = pool->workers + i;
+      uv_mutex_lock(&wk->mutex);
+      QUEUE_FOREACH(q, &wk->wq)
+        queued++;
+      uv_mutex_unlock(&wk->mutex);
+    }
+  }
+
+  uv_mutex_lock(&pool->mutex);
+  metrics->slow_io_queued = 0;
+  QUEUE_FOREACH(q, &pool->slow_io_pending_wq)
+    metrics->slow_io_queued++;
+  if (pool->workers != NULL)
+  {
+    metrics->queued = queued + metrics->slow_io_queued;
+    metrics->idle_threads = uv__pool_fetch_add(&pool->nparked, 0);
+  }
+  else
+  {
+    metrics->queued = pool->pending;
+    metrics->idle_threads = pool->idle_threads + pool->spinners;
+  }
+  metrics->slow_io_running = pool->slow_io_work_running;
+  metrics->threads = pool->nthreads;
+  uv_mutex_unlock(&pool->mutex);
+
+  return 0;
+}
+
+// 设置每个任务完成时报告耗时的回调，NULL 表示不报告；只影响之后提交的任务
+int uv_loop_set_work_timing_cb(uv_loop_t *loop, uv_work_timing_cb cb)
+{
+  uv__get_internal_fields(loop)->work_timing_cb = cb;
+  return 0;
+}
+
+// 指定 loop 上 kind 类型任务使用的线程池，NULL 表示使用默认线程池
+// 只影响之后提交的任务
+int uv_loop_set_threadpool(uv_loop_t *loop,
+                           uv_work_kind kind,
+                           uv_threadpool_t *tp)
+{
+  uv__loop_internal_fields_t *lfields;
+  struct uv__pool *pool;
+
+  if ((unsigned int)kind >= UV_WORK_KIND_MAX)
+    return UV_EINVAL;
+
+  if (tp != NULL && tp->internal == NULL)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+
+  if (tp != NULL)
+  {
+    pool = tp->internal;
+    uv_mutex_lock(&pool->mutex);
+    pool->refs++;
+    uv_mutex_unlock(&pool->mutex);
+  }
+
+  if (lfields->threadpools[kind] != NULL)
+  {
+    pool = lfields->threadpools[kind]->internal;
+    uv_mutex_lock(&pool->mutex);
+    pool->refs--;
+    uv_mutex_unlock(&pool->mutex);
+  }
+
+  lfields->threadpools[kind] = tp;
+  return 0;
+}
+
+uv_threadpool_t *uv_loop_get_threadpool(const uv_loop_t *loop,
+                                        uv_work_kind kind)
+{
+  if ((unsigned int)kind >= UV_WORK_KIND_MAX)
+    return NULL;
+
+  return uv__get_internal_fields(loop)->threadpools[kind];
+}
+
+// loop 关闭时解除与线程池的关联
+// 并等待还在压栈、可能还要通知 loop 的线程离开 work_push_done
+void uv__threadpool_loop_close(uv_loop_t *loop)
+{
+  uv__loop_internal_fields_t *lfields;
+  unsigned int kind;
+
+  for (kind = 0; kind < UV_WORK_KIND_MAX; kind++)
+    uv_loop_set_threadpool(loop, (uv_work_kind)kind, NULL);
+
+  lfields = uv__get_internal_fields(loop);
+  while (uv__pool_fetch_add(&lfields->work_pushing, 0) != 0)
+    uv__pool_yield();
+
+  assert(lfields->work_done == NULL && "thread pool work queue not empty!");
+}
@@ -0,0 +1,161 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Array-backed 4-ary min-heap of timers, ordered by due time and then by
+ * start_id.
+ *
+ * Entries carry a copy of the sort key, so a sift only touches the array,
+ * and the four children of a node usually share a cache line or two.  The
+ * position of a timer in the array is kept in its heap_node[0] to make
+ * removal O(log n) without a search.
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+
+#define UV__HEAP_ARITY 4
+#define UV__HEAP_MIN_SIZE 16
+
+#define uv__heap_index(handle) ((uintptr_t) (handle)->heap_node[0])
+
+
+static int uv__heap_less(const uv__timer_heap_entry_t* a,
+                         const uv__timer_heap_entry_t* b) {
+  if (a->timeout != b->timeout)
+    return a->timeout < b->timeout;
+  return a->start_id < b->start_id;
+}
+
+
+static void uv__heap_set(uv__timer_heap_t* heap,
+                         unsigned int i,
+                         const uv__timer_heap_entry_t* e) {
+  heap->entries[i] = *e;
+  e->handle->heap_node[0] = (void*) (uintptr_t) i;
+}
+
+
+static void uv__heap_sift_up(uv__timer_heap_t* heap,
+                             unsigned int i,
+                             const uv__timer_heap_entry_t* e) {
+  unsigned int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / UV__HEAP_ARITY;
+    if (!uv__heap_less(e, heap->entries + parent))
+      break;
+    uv__heap_set(heap, i, heap->entries + parent);
+    i = parent;
+  }
+
+  uv__heap_set(heap, i, e);
+}
+
+
+static void uv__heap_sift_down(uv__timer_heap_t* heap,
+                               unsigned int i,
+                               const uv__timer_heap_entry_t* e) {
+  unsigned int child;
+  unsigned int last;
+  unsigned int min;
+
+  for (;;) {
+    child = i * UV__HEAP_ARITY + 1;
+    if (child >= heap->nelts)
+      break;
+
+    last = child + UV__HEAP_ARITY;
+    if (last > heap->nelts)
+      last = heap->nelts;
+
+    min = child;
+    for (child++; child < last; child++)
+      if (uv__heap_less(heap->entries + child, heap->entries + min))
+        min = child;
+
+    if (!uv__heap_less(heap->entries + min, e))
+      break;
+
+    uv__heap_set(heap, i, heap->entries + min);
+    i = min;
+  }
+
+  uv__heap_set(heap, i, e);
+}
+
+
+int uv__timer_heap_insert(uv__timer_heap_t* heap, uv_timer_t* handle) {
+  uv__timer_heap_entry_t* entries;
+  uv__timer_heap_entry_t e;
+  unsigned int size;
+
+  if (heap->nelts == heap->size) {
+    size = heap->size * 2;
+    if (size < UV__HEAP_MIN_SIZE)
+      size = UV__HEAP_MIN_SIZE;
+
+    entries = uv__realloc(heap->entries, size * sizeof(*entries));
+    if (entries == NULL)
+      return UV_ENOMEM;
+
+    heap->entries = entries;
+    heap->size = size;
+  }
+
+  e.timeout = handle->timeout;
+  e.start_id = handle->start_id;
+  e.handle = handle;
+  uv__heap_sift_up(heap, heap->nelts++, &e);
+
+  return 0;
+}
+
+
+void uv__timer_heap_remove(uv__timer_heap_t* heap, uv_timer_t* handle) {
+  uv__timer_heap_entry_t* last;
+  unsigned int parent;
+  unsigned int i;
+
+  i = uv__heap_index(handle);
+  assert(i < heap->nelts);
+  assert(heap->entries[i].handle == handle);
+
+  heap->nelts--;
+  if (i == heap->nelts)
+    return;
+
+  /* Fill the hole with the last entry and restore the heap property. */
+  last = heap->entries + heap->nelts;
+  parent = (i - 1) / UV__HEAP_ARITY;
+  if (i > 0 && uv__heap_less(last, heap->entries + parent))
+    uv__heap_sift_up(heap, i, last);
+  else
+    uv__heap_sift_down(heap, i, last);
+}
+
+
+void uv__timer_heap_free(uv__timer_heap_t* heap) {
+  uv__free(heap->entries);
+  heap->entries = NULL;
+  heap->nelts = 0;
+  heap->size = 0;
+}
@@ -0,0 +1,337 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Hierarchical timing wheel, an alternative to the timer heap.
+ *
+ * Level 0 has a slot for every millisecond of the current 64 ms block,
+ * level 1 a slot for every 64 ms block of the current 4096 ms block, and so
+ * on.  A timer lives in the lowest level where its due time and the wheel's
+ * clock |now| share the same block, in the slot for its own sub-block.  When
+ * |now| enters a new block, the matching slot one level up is cascaded:
+ * its timers move down to the levels below.  Timers that are too far out
+ * for the top level wait on the overflow list until the top level wraps.
+ *
+ * Starting and stopping a timer is an append to or a removal from a
+ * doubly-linked slot list.  The timer's heap_node fields hold the links and
+ * the slot, so uv_timer_t doesn't change.
+ *
+ * Slots are FIFO, and a timer can only be appended directly to a slot after
+ * the slot above it has been cascaded into it.  Timers that are due at the
+ * same time therefore come out in start_id order, like with the heap.
+ */
+
+#include "uv-common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define UV__WHEEL_BITS 6
+#define UV__WHEEL_SLOTS (1 << UV__WHEEL_BITS)
+#define UV__WHEEL_MASK (UV__WHEEL_SLOTS - 1)
+#define UV__WHEEL_LEVELS 6  /* 2^36 ms, a bit over two years. */
+
+/* Values of heap_node[2] for timers that aren't in a level slot. */
+#define UV__WHEEL_EXPIRED (UV__WHEEL_LEVELS * UV__WHEEL_SLOTS)
+#define UV__WHEEL_OVERFLOW (UV__WHEEL_EXPIRED + 1)
+
+struct uv__timer_wheel_s {
+  uint64_t now;       /* Every tick before |now| has been processed. */
+  uint64_t min;       /* Cached due time of the next timer, see min_valid. */
+  int min_valid;
+  uint64_t occupied[UV__WHEEL_LEVELS];  /* Bitmap of non-empty slots. */
+  QUEUE slots[UV__WHEEL_LEVELS][UV__WHEEL_SLOTS];
+  QUEUE expired;      /* Started with a due time before |now|. */
+  QUEUE overflow;     /* Due after the top level wraps. */
+};
+
+#define uv__wheel_queue(handle) ((QUEUE*) &(handle)->heap_node[0])
+#define uv__wheel_slot(handle) ((uintptr_t) (handle)->heap_node[2])
+
+
+static unsigned int uv__wheel_ctz(uint64_t v) {
+  unsigned int n;
+
+  assert(v != 0);
+#if defined(__GNUC__)
+  n = __builtin_ctzll(v);
+#else
+  for (n = 0; (v & 1) == 0; n++)
+    v >>= 1;
+#endif
+  return n;
+}
+
+
+static unsigned int uv__wheel_level(uint64_t now, uint64_t due) {
+  uint64_t diff;
+  unsigned int level;
+
+  diff = (now ^ due) >> UV__WHEEL_BITS;
+  for (level = 0; diff != 0; level++)
+    diff >>= UV__WHEEL_BITS;
+
+  return level;
+}
+
+
+static void uv__wheel_place(uv__timer_wheel_t* w, uv_timer_t* handle) {
+  unsigned int level;
+  unsigned int idx;
+  uintptr_t slot;
+  QUEUE* q;
+
+  if (handle->timeout < w->now) {
+    slot = UV__WHEEL_EXPIRED;
+    q = &w->expired;
+  } else {
+    level = uv__wheel_level(w->now, handle->timeout);
+    if (level >= UV__WHEEL_LEVELS) {
+      slot = UV__WHEEL_OVERFLOW;
+      q = &w->overflow;
+    } else {
+      idx = (handle->timeout >> (level * UV__WHEEL_BITS)) & UV__WHEEL_MASK;
+      slot = level * UV__WHEEL_SLOTS + idx;
+      q = &w->slots[level][idx];
+      w->occupied[level] |= (uint64_t) 1 << idx;
+    }
+  }
+
+  handle->heap_node[2] = (void*) slot;
+  QUEUE_INSERT_TAIL(q, uv__wheel_queue(handle));
+}
+
+
+/* Moves the timers of a slot, or of the overflow list, down the levels. */
+static void uv__wheel_cascade(uv__timer_wheel_t* w, QUEUE* slot) {
+  uv_timer_t* handle;
+  QUEUE queue;
+  QUEUE* q;
+
+  if (QUEUE_EMPTY(slot))
+    return;
+
+  QUEUE_MOVE(slot, &queue);
+  while (!QUEUE_EMPTY(&queue)) {
+    q = QUEUE_HEAD(&queue);
+    QUEUE_REMOVE(q);
+    handle = container_of((void*) q, uv_timer_t, heap_node);
+    uv__wheel_place(w, handle);
+  }
+}
+
+
+/* Sets the clock to |target|. The caller guarantees that no slot becomes due
+ * before |target|, so only the slots for |target| itself need cascading.
+ */
+static void uv__wheel_advance(uv__timer_wheel_t* w, uint64_t target) {
+  unsigned int shift;
+  unsigned int level;
+  unsigned int idx;
+  uint64_t old;
+
+  old = w->now;
+  w->now = target;
+
+  shift = UV__WHEEL_LEVELS * UV__WHEEL_BITS;
+  if ((old >> shift) != (target >> shift))
+    uv__wheel_cascade(w, &w->overflow);
+
+  for (level = UV__WHEEL_LEVELS - 1; level > 0; level--) {
+    shift = level * UV__WHEEL_BITS;
+    if ((old >> shift) == (target >> shift))
+      continue;
+
+    idx = (target >> shift) & UV__WHEEL_MASK;
+    if (w->occupied[level] & ((uint64_t) 1 << idx)) {
+      w->occupied[level] &= ~((uint64_t) 1 << idx);
+      uv__wheel_cascade(w, &w->slots[level][idx]);
+    }
+  }
+}
+
+
+/* Returns the first tick at or after |now| where a level 0 slot is due or a
+ * slot has to be cascaded, UINT64_MAX if the wheel is empty.
+ */
+static uint64_t uv__wheel_next_event(const uv__timer_wheel_t* w) {
+  unsigned int level;
+  unsigned int shift;
+  unsigned int idx;
+  uint64_t bits;
+  uint64_t base;
+
+  /* Level 0 only has slots at or after the current one. */
+  if (w->occupied[0] != 0)
+    return (w->now & ~(uint64_t) UV__WHEEL_MASK) + uv__wheel_ctz(w->occupied[0]);
+
+  for (level = 1; level < UV__WHEEL_LEVELS; level++) {
+    /* Slots at or before the current one have been cascaded already. */
+    bits = w->occupied[level];
+    if (bits == 0)
+      continue;
+
+    shift = level * UV__WHEEL_BITS;
+    idx = uv__wheel_ctz(bits);
+    base = w->now >> (shift + UV__WHEEL_BITS) << (shift + UV__WHEEL_BITS);
+    return base + ((uint64_t) idx << shift);
+  }
+
+  if (!QUEUE_EMPTY(&w->overflow)) {
+    shift = UV__WHEEL_LEVELS * UV__WHEEL_BITS;
+    return ((w->now >> shift) + 1) << shift;
+  }
+
+  return (uint64_t) -1;
+}
+
+
+int uv__timer_wheel_init(uv__timer_wheel_t** wheel, uint64_t now) {
+  uv__timer_wheel_t* w;
+  unsigned int level;
+  unsigned int idx;
+
+  w = uv__malloc(sizeof(*w));
+  if (w == NULL)
+    return UV_ENOMEM;
+
+  w->now = now;
+  w->min = 0;
+  w->min_valid = 0;
+  QUEUE_INIT(&w->expired);
+  QUEUE_INIT(&w->overflow);
+
+  for (level = 0; level < UV__WHEEL_LEVELS; level++) {
+    w->occupied[level] = 0;
+    for (idx = 0; idx < UV__WHEEL_SLOTS; idx++)
+      QUEUE_INIT(&w->slots[level][idx]);
+  }
+
+  *wheel = w;
+  return 0;
+}
+
+
+void uv__timer_wheel_free(uv__timer_wheel_t* w) {
+  uv__free(w);
+}
+
+
+void uv__timer_wheel_insert(uv__timer_wheel_t* w, uv_timer_t* handle) {
+  if (w->min_valid && handle->timeout < w->min)
+    w->min = handle->timeout;
+
+  uv__wheel_place(w, handle);
+}
+
+
+void uv__timer_wheel_remove(uv__timer_wheel_t* w, uv_timer_t* handle) {
+  uintptr_t slot;
+  unsigned int level;
+  unsigned int idx;
+
+  QUEUE_REMOVE(uv__wheel_queue(handle));
+
+  if (handle->timeout == w->min)
+    w->min_valid = 0;
+
+  slot = uv__wheel_slot(handle);
+  if (slot >= UV__WHEEL_EXPIRED)
+    return;
+
+  level = slot / UV__WHEEL_SLOTS;
+  idx = slot % UV__WHEEL_SLOTS;
+  if (QUEUE_EMPTY(&w->slots[level][idx]))
+    w->occupied[level] &= ~((uint64_t) 1 << idx);
+}
+
+
+/* Returns the next timer that is due at or before |time| without removing
+ * it, or NULL. Moves the clock of the wheel forward as a side effect.
+ */
+uv_timer_t* uv__timer_wheel_due(uv__timer_wheel_t* w, uint64_t time) {
+  uint64_t next;
+  QUEUE* slot;
+  QUEUE* q;
+
+  if (!QUEUE_EMPTY(&w->expired)) {
+    q = QUEUE_HEAD(&w->expired);
+    return container_of((void*) q, uv_timer_t, heap_node);
+  }
+
+  while (w->now <= time) {
+    slot = &w->slots[0][w->now & UV__WHEEL_MASK];
+    if (!QUEUE_EMPTY(slot)) {
+      q = QUEUE_HEAD(slot);
+      return container_of((void*) q, uv_timer_t, heap_node);
+    }
+
+    next = uv__wheel_next_event(w);
+    if (next > time)
+      next = time + 1;
+
+    assert(next > w->now);
+    uv__wheel_advance(w, next);
+  }
+
+  return NULL;
+}
+
+
+/* Returns the due time of the first timer, UINT64_MAX if there is none. */
+uint64_t uv__timer_wheel_min(uv__timer_wheel_t* w) {
+  const uv_timer_t* handle;
+  unsigned int level;
+  unsigned int idx;
+  uint64_t min;
+  QUEUE* slot;
+  QUEUE* q;
+
+  /* Everything on it is due one tick before |now|. */
+  if (!QUEUE_EMPTY(&w->expired))
+    return w->now - 1;
+
+  if (w->occupied[0] != 0)
+    return (w->now & ~(uint64_t) UV__WHEEL_MASK) + uv__wheel_ctz(w->occupied[0]);
+
+  if (w->min_valid)
+    return w->min;
+
+  /* Only the first slot of the lowest level is a candidate, scan it. */
+  slot = &w->overflow;
+  for (level = 1; level < UV__WHEEL_LEVELS; level++) {
+    if (w->occupied[level] != 0) {
+      idx = uv__wheel_ctz(w->occupied[level]);
+      slot = &w->slots[level][idx];
+      break;
+    }
+  }
+
+  min = (uint64_t) -1;
+  QUEUE_FOREACH(q, slot) {
+    handle = container_of((void*) q, uv_timer_t, heap_node);
+    if (handle->timeout < min)
+      min = handle->timeout;
+  }
+
+  w->min = min;
+  w->min_valid = 1;
+  return min;
+}
@@ -20,51 +20,130 @@
 
 #include "uv.h"
 #include "uv-common.h"
-#include "heap-inl.h"
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h> /* memcpy() */
 
-// 时间堆
+// 时间堆，按 timeout 排序，timeout 相同时按 start_id 排序
+static uv__timer_heap_t *timer_heap(const uv_loop_t *loop)
+{
+  return &uv__get_internal_fields(loop)->timer_heap;
+}
+
+// 时间轮，未启用时为 NULL
+static uv__timer_wheel_t *timer_wheel(const uv_loop_t *loop)
+{
+  return uv__get_internal_fields(loop)->timer_wheel;
+}
 
-static struct heap *timer_heap(const uv_loop_t *loop)
+// 高精度模式下定时器的时间单位是纳秒，否则是毫秒
+static int timer_hrtime(const uv_loop_t *loop)
 {
-#ifdef _WIN32
-  return (struct heap *)loop->timer_heap;
-#else
-  return (struct heap *)&loop->timer_heap;
-#endif
+  return uv__get_internal_fields(loop)->flags & UV__LOOP_HRTIME;
 }
 
-// 时间比较函数
-static int timer_less_than(const struct heap_node *ha,
-                           const struct heap_node *hb)
+// 定时器时间单位下的当前循环时间
+static uint64_t timer_now(const uv_loop_t *loop)
 {
-  const uv_timer_t *a;
-  const uv_timer_t *b;
+  if (timer_hrtime(loop))
+    return uv__get_internal_fields(loop)->time_ns;
+  return loop->time;
+}
 
-  a = container_of(ha, uv_timer_t, heap_node);
-  b = container_of(hb, uv_timer_t, heap_node);
+// 毫秒转为定时器时间单位，溢出时取最大值
+static uint64_t timer_from_ms(const uv_loop_t *loop, uint64_t ms)
+{
+  if (!timer_hrtime(loop))
+    return ms;
+  if (ms > (uint64_t)-1 / 1000000)
+    return (uint64_t)-1;
+  return ms * 1000000;
+}
+
+// 定时器时间单位转为毫秒，向上取整
+static uint64_t timer_to_ms(const uv_loop_t *loop, uint64_t t)
+{
+  if (!timer_hrtime(loop))
+    return t;
+  return t / 1000000 + (t % 1000000 != 0);
+}
 
-  if (a->timeout < b->timeout)
-    return 1;
-  if (b->timeout < a->timeout)
+// 切换到时间轮，只能在没有活动定时器时切换
+int uv__timer_use_wheel(uv_loop_t *loop)
+{
+  uv__loop_internal_fields_t *lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->timer_wheel != NULL)
     return 0;
 
-  // timeout相同，则比较start_id
-  // start_id 在uv_timer_start()函数内部分配
+  // 时间轮以毫秒为刻度
+  if (timer_hrtime(loop))
+    return UV_EINVAL;
+
+  if (timer_heap(loop)->nelts != 0)
+    return UV_EBUSY;
+
+  return uv__timer_wheel_init(&lfields->timer_wheel, loop->time);
+}
+
+// 切换到纳秒定时器，只能在没有活动定时器时切换
+int uv__timer_use_hrtime(uv_loop_t *loop)
+{
+  uv__loop_internal_fields_t *lfields;
 
-  /* Compare start_id when both have the same timeout. start_id is
-   * allocated with loop->timer_counter in uv_timer_start().
-   */
-  if (a->start_id < b->start_id)
-    return 1;
-  if (b->start_id < a->start_id)
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->flags & UV__LOOP_HRTIME)
     return 0;
 
+  if (lfields->timer_wheel != NULL)
+    return UV_EINVAL;
+
+  if (timer_heap(loop)->nelts != 0)
+    return UV_EBUSY;
+
+  lfields->flags |= UV__LOOP_HRTIME;
+  uv_update_time(loop);
+
   return 0;
 }
 
+STATIC_ASSERT(sizeof(((uv_timer_t *)0)->u.reserved) >= sizeof(uint64_t));
+
+// slack 存放在 handle->u.reserved 里，不改变 uv_timer_t 的大小；
+// 32 位平台上指针只有 4 字节，所以按字节复制
+static uint64_t timer_slack(const uv_timer_t *handle)
+{
+  uint64_t slack;
+
+  memcpy(&slack, handle->u.reserved, sizeof(slack));
+  return slack;
+}
+
+static void timer_set_slack(uv_timer_t *handle, uint64_t slack)
+{
+  memcpy(handle->u.reserved, &slack, sizeof(slack));
+}
+
+// 把到期时间向后推到 slack 粒度（不大于 slack 的最大 2 的幂）的边界上，
+// slack 相近的定时器因此落在同一个时间点，在同一轮 uv__run_timers 中触发
+static uint64_t timer_align(uint64_t timeout, uint64_t slack)
+{
+  uint64_t granularity;
+  uint64_t aligned;
+
+  granularity = 1;
+  while (granularity <= slack / 2)
+    granularity <<= 1;
+
+  aligned = (timeout + granularity - 1) & ~(granularity - 1);
+  if (aligned < timeout)
+    return timeout; /* overflow */
+
+  return aligned;
+}
+
 // 初始化
 int uv_timer_init(uv_loop_t *loop, uv_timer_t *handle)
 {
@@ -74,18 +153,20 @@ int uv_timer_init(uv_loop_t *loop, uv_timer_t *handle)
   handle->timer_cb = NULL;
   // 定时器不重复
   handle->repeat = 0;
+  // 默认精确触发
+  timer_set_slack(handle, 0);
   return 0;
 }
 
 // 启动定时器
-// timeout为超时时间
-// repeat为是否重复
-int uv_timer_start(uv_timer_t *handle,
-                   uv_timer_cb cb,
-                   uint64_t timeout,
-                   uint64_t repeat)
+// timeout为超时时间，repeat为重复间隔，均为定时器时间单位
+static int timer_start(uv_timer_t *handle,
+                       uv_timer_cb cb,
+                       uint64_t timeout,
+                       uint64_t repeat)
 {
   uint64_t clamped_timeout;
+  int err;
 
   if (uv__is_closing(handle) || cb == NULL)
     return UV_EINVAL;
@@ -96,12 +177,18 @@ int uv_timer_start(uv_timer_t *handle,
     uv_timer_stop(handle);
 
   // 时间为当前主循环时间 + 设定的超时时间
-  clamped_timeout = handle->loop->time + timeout;
+  clamped_timeout = timer_now(handle->loop) + timeout;
   if (clamped_timeout < timeout)
     // clamped_timeout < timeout 表明handle->loop->time为负值
     // 溢出，因此需要uint64_t最大值 - 1
     clamped_timeout = (uint64_t)-1;
 
+  // 允许延后触发时，对齐到批次边界
+  if (timer_slack(handle) != 0)
+    clamped_timeout = timer_align(clamped_timeout,
+                                  timer_from_ms(handle->loop,
+                                                timer_slack(handle)));
+
   // 设定callback
   handle->timer_cb = cb;
   // 定时时间
@@ -112,16 +199,51 @@ int uv_timer_start(uv_timer_t *handle,
   // 用于timeout相同，先后顺序判断
   handle->start_id = handle->loop->timer_counter++;
 
-  // 将定时器插入最小堆
-  heap_insert(timer_heap(handle->loop),
-              (struct heap_node *)&handle->heap_node,
-              timer_less_than);
+  // 将定时器插入时间轮或最小堆
+  if (timer_wheel(handle->loop) != NULL)
+  {
+    uv__timer_wheel_insert(timer_wheel(handle->loop), handle);
+  }
+  else
+  {
+    // 堆空间不足时需要扩容，可能失败
+    err = uv__timer_heap_insert(timer_heap(handle->loop), handle);
+    if (err)
+      return err;
+  }
   // 启动，本质上是标识该handle为活动状态，告知loop已准备好
   uv__handle_start(handle);
 
   return 0;
 }
 
+// timeout、repeat 为毫秒
+int uv_timer_start(uv_timer_t *handle,
+                   uv_timer_cb cb,
+                   uint64_t timeout,
+                   uint64_t repeat)
+{
+  return timer_start(handle,
+                     cb,
+                     timer_from_ms(handle->loop, timeout),
+                     timer_from_ms(handle->loop, repeat));
+}
+
+// timeout、repeat 为纳秒，非高精度模式下向上取整到毫秒
+int uv_timer_start_ns(uv_timer_t *handle,
+                      uv_timer_cb cb,
+                      uint64_t timeout,
+                      uint64_t repeat)
+{
+  if (!timer_hrtime(handle->loop))
+  {
+    timeout = timeout / 1000000 + (timeout % 1000000 != 0);
+    repeat = repeat / 1000000 + (repeat % 1000000 != 0);
+  }
+
+  return timer_start(handle, cb, timeout, repeat);
+}
+
 // 停止定时器
 int uv_timer_stop(uv_timer_t *handle)
 {
@@ -129,10 +251,11 @@ int uv_timer_stop(uv_timer_t *handle)
   if (!uv__is_active(handle))
     return 0;
 
-  // 堆中移除
-  heap_remove(timer_heap(handle->loop),
-              (struct heap_node *)&handle->heap_node,
-              timer_less_than);
+  // 从时间轮或堆中移除
+  if (timer_wheel(handle->loop) != NULL)
+    uv__timer_wheel_remove(timer_wheel(handle->loop), handle);
+  else
+    uv__timer_heap_remove(timer_heap(handle->loop), handle);
   // actives 计数器减一
   uv__handle_stop(handle);
 
@@ -149,7 +272,7 @@ int uv_timer_again(uv_timer_t *handle)
   {
     uv_timer_stop(handle);
     // 超时时间为repeat时间间隔
-    uv_timer_start(handle, handle->timer_cb, handle->repeat, handle->repeat);
+    timer_start(handle, handle->timer_cb, handle->repeat, handle->repeat);
   }
 
   return 0;
@@ -157,34 +280,56 @@ int uv_timer_again(uv_timer_t *handle)
 
 void uv_timer_set_repeat(uv_timer_t *handle, uint64_t repeat)
 {
-  handle->repeat = repeat;
+  handle->repeat = timer_from_ms(handle->loop, repeat);
 }
 
 uint64_t uv_timer_get_repeat(const uv_timer_t *handle)
 {
-  return handle->repeat;
+  return timer_to_ms(handle->loop, handle->repeat);
+}
+
+// 设置允许的延迟，下次启动定时器时生效
+void uv_timer_set_slack(uv_timer_t *handle, uint64_t slack)
+{
+  timer_set_slack(handle, slack);
+}
+
+uint64_t uv_timer_get_slack(const uv_timer_t *handle)
+{
+  return timer_slack(handle);
 }
 
 // 计算io_poll阻塞时间
 int uv__next_timeout(const uv_loop_t *loop)
 {
-  const struct heap_node *heap_node;
-  const uv_timer_t *handle;
+  const uv__timer_heap_t *heap;
+  uint64_t timeout;
   uint64_t diff;
 
-  // 取出最小堆中的最小值
-  heap_node = heap_min(timer_heap(loop));
-  if (heap_node == NULL)
-    return -1; /* block indefinitely */
+  if (timer_wheel(loop) != NULL)
+  {
+    timeout = uv__timer_wheel_min(timer_wheel(loop));
+    if (timeout == (uint64_t)-1)
+      return -1; /* block indefinitely */
+  }
+  else
+  {
+    // 取出最小堆中的最小值
+    heap = timer_heap(loop);
+    if (heap->nelts == 0)
+      return -1; /* block indefinitely */
+
+    timeout = heap->entries[0].timeout;
+  }
 
-  handle = container_of(heap_node, uv_timer_t, heap_node);
   // 定时器超时时间小于主事件循环时间
   // 这种情况下，需要尽快退出io_epoll，不阻塞定时器执行
-  if (handle->timeout <= loop->time)
+  if (timeout <= timer_now(loop))
     return 0;
 
   // 否则取当前时间与下一个定时器触发时间差值
-  diff = handle->timeout - loop->time;
+  // 高精度模式下向上取整到毫秒，精确的等待时间见 uv__next_timeout_ns()
+  diff = timer_to_ms(loop, timeout - timer_now(loop));
   // 上限控制
   if (diff > INT_MAX)
     diff = INT_MAX;
@@ -192,29 +337,61 @@ int uv__next_timeout(const uv_loop_t *loop)
   return (int)diff;
 }
 
+// 高精度模式下距离第一个定时器到期的纳秒数，没有定时器时为 UINT64_MAX
+uint64_t uv__next_timeout_ns(const uv_loop_t *loop)
+{
+  const uv__timer_heap_t *heap;
+  uint64_t now;
+
+  assert(timer_hrtime(loop));
+
+  heap = timer_heap(loop);
+  if (heap->nelts == 0)
+    return (uint64_t)-1;
+
+  now = uv__get_internal_fields(loop)->time_ns;
+  if (heap->entries[0].timeout <= now)
+    return 0;
+
+  return heap->entries[0].timeout - now;
+}
+
 // 运行定时器
 void uv__run_timers(uv_loop_t *loop)
 {
-  struct heap_node *heap_node;
+  uv__timer_heap_t *heap;
   uv_timer_t *handle;
 
+  heap = timer_heap(loop);
+
   // 一直运行，直到当前最小元素，即最小超时时间都大于当前循环时间（表示当前循环时间没有定时器需要执行）
   // 尽可能多的执行定时器，直到最小定时时间 大于 当前循环时间
   for (;;)
   {
-    // 最小时间
-    heap_node = heap_min(timer_heap(loop));
-    if (heap_node == NULL)
-      break;
-
-    handle = container_of(heap_node, uv_timer_t, heap_node);
-    // 最小超时时间 大于 循环时间
-    // 尽可能多执行
-    if (handle->timeout > loop->time)
-      break;
+    if (timer_wheel(loop) != NULL)
+    {
+      // 时间轮按到期时间和 start_id 顺序给出已到期的定时器
+      handle = uv__timer_wheel_due(timer_wheel(loop), loop->time);
+      if (handle == NULL)
+        break;
+    }
+    else
+    {
+      // 最小时间
+      if (heap->nelts == 0)
+        break;
+
+      // 最小超时时间 大于 循环时间
+      // 尽可能多执行
+      if (heap->entries[0].timeout > timer_now(loop))
+        break;
+
+      handle = heap->entries[0].handle;
+    }
 
     uv_timer_stop(handle);
     uv_timer_again(handle);
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_TIMERS, 1);
     // 执行回调函数
     handle->timer_cb(handle);
   }
@@ -215,11 +215,18 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   count = 48; /* Benchmarks suggest this gives the best throughput. */
 
   for (;;) {
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     nfds = pollset_poll(loop->backend_fd,
                         events,
                         ARRAY_SIZE(events),
                         timeout);
 
+    if (timeout != 0)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
+
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
      * operating system didn't reschedule our process while in the syscall.
@@ -248,6 +255,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     have_signals = 0;
     nevents = 0;
+    uv__metrics_add(loop, events, nfds);
 
     assert(loop->watchers != NULL);
     loop->watchers[loop->nwatchers] = (void*) events;
@@ -291,6 +299,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (have_signals != 0)
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
 
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, nevents);
+
     loop->watchers[loop->nwatchers] = NULL;
     loop->watchers[loop->nwatchers + 1] = NULL;
 
@@ -28,6 +28,12 @@
  * 线程间通信通过监听特定的fd状态方式实现
  * eventfd
  * 
+ * uv_async_send 把 handle 压入 loop 的无锁栈，栈由空变为非空时才写 eventfd；
+ * loop 被唤醒后只处理栈里的 handle，与 handle 的总数无关
+ * 
+ * loop 在 uv_run 中醒着（没有阻塞在 uv__io_poll）时，睡眠前一定会再检查一次栈，
+ * 这时发送方连 eventfd 也不用写
+ * 
  */
 
 #include "uv.h"
@@ -35,14 +41,28 @@
 #include "atomic-ops.h"
 
 #include <errno.h>
+#include <sched.h>  /* sched_yield() */
 #include <stdio.h> /* snprintf() */
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+/* Handles that were sent to are pushed on a lock-free stack per loop, so a
+ * wakeup only has to look at those instead of at every uv_async_t. The loop
+ * thread moves them from the stack to its ready queue, where `queue` links
+ * them instead of `loop->async_handles`. A handle is on the stack or the
+ * ready queue exactly while its `pending` field is non-zero.
+ */
+#define uv__async_cas_ptr(p, o, n) __sync_val_compare_and_swap((p), (o), (n))
+#define uv__async_fetch_add(p, v) __sync_fetch_and_add((p), (v))
+
+// 待处理栈里的下一个 handle，放在 handle->u.reserved 里，不改变 uv_async_t 的大小
+#define uv__async_next(h) (*(uv_async_t **)&(h)->u.reserved[0])
+
 // 通知
 static void uv__async_send(uv_loop_t *loop);
+static void uv__async_dispatch(uv_loop_t *loop);
 static int uv__async_start(uv_loop_t *loop);
 static int uv__async_eventfd(void);
 
@@ -60,6 +80,7 @@ int uv_async_init(uv_loop_t *loop, uv_async_t *handle, uv_async_cb async_cb)
   // 异步函数
   handle->async_cb = async_cb;
   handle->pending = 0;
+  uv__async_next(handle) = NULL;
 
   // 将 worker 异步操作队列放入 async_handles 中
   // 1. 文件 IO 的 handle 只会在 uv_loop_init 中执行一次
@@ -71,9 +92,34 @@ int uv_async_init(uv_loop_t *loop, uv_async_t *handle, uv_async_cb async_cb)
   return 0;
 }
 
+// 压入 loop 的待处理栈，返回压入前栈是否为空
+static int uv__async_push(uv_async_t *handle)
+{
+  uv__loop_internal_fields_t *lfields;
+  uv_async_t *head;
+  uv_async_t *old;
+
+  lfields = uv__get_internal_fields(handle->loop);
+
+  // 先假设栈是空的，失败时 CAS 返回的就是当前的栈顶
+  head = NULL;
+  for (;;)
+  {
+    uv__async_next(handle) = head;
+    old = uv__async_cas_ptr(&lfields->async_pending, head, handle);
+    if (old == head)
+      return head == NULL;
+    head = old;
+  }
+}
+
 // 通知主线程，线程间通信
 int uv_async_send(uv_async_t *handle)
 {
+  uv__loop_internal_fields_t *lfields;
+  uv_loop_t *loop;
+  int wakeup;
+
   /* Do a cheap read first. */
   if (ACCESS_ONCE(int, handle->pending) != 0)
     return 0;
@@ -83,40 +129,114 @@ int uv_async_send(uv_async_t *handle)
   if (cmpxchgi(&handle->pending, 0, 1) != 0)
     return 0;
 
-  /* Wake up the other thread's event loop. */
-  uv__async_send(handle->loop);
+  /* Wake up the other thread's event loop. Unless the stack wasn't empty,
+   * then whoever made it non-empty did that and the loop hasn't taken the
+   * stack yet. Or unless the loop is awake; the push above is a full barrier
+   * and so is the loop's store in uv__async_poll_start(), so either we see
+   * it going to sleep or it sees the handle on the stack.
+   */
+  loop = handle->loop;
+  lfields = uv__get_internal_fields(loop);
+  wakeup = 0;
+  if (uv__async_push(handle))
+    if (ACCESS_ONCE(int, lfields->async_awake) == 0)
+      wakeup = 1;
+
+  // 被唤醒的 loop 线程常常在 write 里就抢占了当前线程，所以 eventfd 放到临界区之后再写，
+  // 否则 loop 线程只能在 uv__async_spin 里等我们重新被调度
+  if (wakeup)
+    uv__async_fetch_add(&lfields->async_sending, 1);
 
   /* Tell the other thread we're done. */
   if (cmpxchgi(&handle->pending, 1, 2) != 1)
     abort();
 
+  /* The handle may be gone now but the loop isn't, uv__async_stop() waits. */
+  if (wakeup)
+  {
+    uv__async_send(loop);
+    uv__async_fetch_add(&lfields->async_sending, -1);
+  }
+
   return 0;
 }
 
 /* Only call this from the event loop thread. */
 static int uv__async_spin(uv_async_t *handle)
 {
+  int i;
   int rc;
 
   for (;;)
   {
-    /* rc=0 -- handle is not pending.
-     * rc=1 -- handle is pending, other thread is still working with it.
-     * rc=2 -- handle is pending, other thread is done.
+    /* 997 is not completely chosen at random. It's a prime number, acyclical
+     * by nature, and should therefore hopefully dampen sympathetic resonance.
+     */
+    for (i = 0; i < 997; i++)
+    {
+      /* rc=0 -- handle is not pending.
+       * rc=1 -- handle is pending, other thread is still working with it.
+       * rc=2 -- handle is pending, other thread is done.
+       */
+      rc = cmpxchgi(&handle->pending, 2, 0);
+
+      if (rc != 1)
+        return rc;
+
+      /* Other thread is busy with this handle, spin until it's done. */
+      cpu_relax();
+    }
+
+    /* Yield the CPU. We may have preempted the other thread while it's
+     * inside the critical section and if it's running on the same CPU
+     * as us, we'll just burn CPU cycles until the end of our time slice.
      */
-    rc = cmpxchgi(&handle->pending, 2, 0);
+    sched_yield();
+  }
+}
+
+// 一次取走整个待处理栈，按发送的顺序移到 ready 队列的尾部
+static void uv__async_take(uv__loop_internal_fields_t *lfields)
+{
+  uv_async_t *prev;
+  uv_async_t *next;
+  uv_async_t *h;
+
+  h = NULL;
+  for (;;)
+  {
+    prev = uv__async_cas_ptr(&lfields->async_pending, h, NULL);
+    if (prev == h)
+      break;
+    h = prev;
+  }
 
-    if (rc != 1)
-      return rc;
+  // 栈是后进先出的，反转成发送的顺序
+  prev = NULL;
+  while (h != NULL)
+  {
+    next = uv__async_next(h);
+    uv__async_next(h) = prev;
+    prev = h;
+    h = next;
+  }
 
-    /* Other thread is busy with this handle, spin until it's done. */
-    cpu_relax();
+  for (h = prev; h != NULL; h = uv__async_next(h))
+  {
+    QUEUE_REMOVE(&h->queue);
+    QUEUE_INSERT_TAIL(&lfields->async_ready, &h->queue);
   }
 }
 
 void uv__async_close(uv_async_t *handle)
 {
-  uv__async_spin(handle);
+  /* A pending handle may still be linked from the stack, which other threads
+   * push to concurrently. Move the stack to the ready queue, from which the
+   * handle can be removed like from `loop->async_handles`.
+   */
+  if (uv__async_spin(handle) != 0)
+    uv__async_take(uv__get_internal_fields(handle->loop));
+
   QUEUE_REMOVE(&handle->queue);
   uv__handle_stop(handle);
 }
@@ -126,9 +246,6 @@ static void uv__async_io(uv_loop_t *loop, uv__io_t *w, unsigned int events)
 {
   char buf[1024];
   ssize_t r;
-  QUEUE queue;
-  QUEUE *q;
-  uv_async_t *h;
 
   assert(w == &loop->async_io_watcher);
 
@@ -152,18 +269,26 @@ static void uv__async_io(uv_loop_t *loop, uv__io_t *w, unsigned int events)
     abort();
   }
 
-  // loop->async_handles 由 uv__async_init 注入
-  QUEUE_MOVE(&loop->async_handles, &queue);
-  while (!QUEUE_EMPTY(&queue))
+  uv__async_dispatch(loop);
+}
+
+// 只处理发送过的 handle；回调里关闭的 handle 会被 uv__async_close 从 ready 队列摘掉
+static void uv__async_dispatch(uv_loop_t *loop)
+{
+  uv__loop_internal_fields_t *lfields;
+  QUEUE *q;
+  uv_async_t *h;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__async_take(lfields);
+  while (!QUEUE_EMPTY(&lfields->async_ready))
   {
-    q = QUEUE_HEAD(&queue);
-    // 取出 handler
+    q = QUEUE_HEAD(&lfields->async_ready);
     h = QUEUE_DATA(q, uv_async_t, queue);
 
-    // 释放资源
+    // 清除 pending 之后其它线程就可能再次压栈，先放回 async_handles
     QUEUE_REMOVE(q);
-    // 用于下一次循环
-    QUEUE_INSERT_TAIL(&loop->async_handles, q)
+    QUEUE_INSERT_TAIL(&loop->async_handles, q);
 
     if (0 == uv__async_spin(h))
       continue; /* Not pending. */
@@ -277,14 +402,84 @@ static int uv__async_start(uv_loop_t *loop)
   return 0;
 }
 
+/* Handles that were sent to and not dispatched yet: on the stack, or in the
+ * ready queue where uv__async_close() moves the stack when it closes a
+ * pending handle.
+ */
+static int uv__async_has_pending(uv__loop_internal_fields_t *lfields)
+{
+  return ACCESS_ONCE(uv_async_t *, lfields->async_pending) != NULL ||
+         !QUEUE_EMPTY(&lfields->async_ready);
+}
+
+// uv_run 开始运行，发送方可以不写 eventfd
+void uv__async_enter(uv_loop_t *loop)
+{
+  uv__get_internal_fields(loop)->async_awake = 1;
+}
+
+/* uv_run is returning. Whoever polls the backend fd next, uv_run or an
+ * embedder, has to see handles that were sent to while the loop was awake.
+ */
+void uv__async_leave(uv_loop_t *loop)
+{
+  if (uv__async_poll_start(loop, -1) == 0)
+    uv__async_send(loop);
+}
+
+/* Called before uv__io_poll(). Returns the timeout to poll with: 0 when
+ * handles were sent to while the loop was awake, they didn't write to the
+ * eventfd.
+ */
+int uv__async_poll_start(uv_loop_t *loop, int timeout)
+{
+  uv__loop_internal_fields_t *lfields;
+
+  if (timeout == 0)
+    return 0;
+
+  lfields = uv__get_internal_fields(loop);
+  cmpxchgi(&lfields->async_awake, 1, 0); /* Full barrier. */
+  if (uv__async_has_pending(lfields))
+    return 0;
+
+  return timeout;
+}
+
+// uv__io_poll 返回之后：重新标记为醒着，并处理醒着时被发送、没有写 eventfd 的 handle
+void uv__async_poll_done(uv_loop_t *loop)
+{
+  uv__loop_internal_fields_t *lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->async_awake = 1;
+
+  if (uv__async_has_pending(lfields))
+    uv__async_dispatch(loop);
+}
+
 int uv__async_fork(uv_loop_t *loop)
 {
+  int err;
+
   if (loop->async_io_watcher.fd == -1) /* never started */
     return 0;
 
+  /* Threads that were in uv_async_send() weren't forked. */
+  uv__get_internal_fields(loop)->async_sending = 0;
   uv__async_stop(loop);
 
-  return uv__async_start(loop);
+  err = uv__async_start(loop);
+  if (err)
+    return err;
+
+  /* The wakeup for handles that were pending at fork time was lost with the
+   * old file descriptor, and senders only write when the stack was empty.
+   */
+  if (uv__async_has_pending(uv__get_internal_fields(loop)))
+    uv__async_send(loop);
+
+  return 0;
 }
 
 void uv__async_stop(uv_loop_t *loop)
@@ -292,6 +487,11 @@ void uv__async_stop(uv_loop_t *loop)
   if (loop->async_io_watcher.fd == -1)
     return;
 
+  /* Senders write to the eventfd after they're done with the handle. */
+  while (uv__async_fetch_add(&uv__get_internal_fields(loop)->async_sending,
+                             0) != 0)
+    sched_yield();
+
   if (loop->async_wfd != -1)
   {
     if (loop->async_wfd != loop->async_io_watcher.fd)
@@ -299,7 +499,7 @@ void uv__async_stop(uv_loop_t *loop)
     loop->async_wfd = -1;
   }
 
-  uv__io_stop(loop, &loop->async_io_watcher, POLLIN);
+  uv__io_close(loop, &loop->async_io_watcher);
   uv__close(loop->async_io_watcher.fd);
   loop->async_io_watcher.fd = -1;
 }
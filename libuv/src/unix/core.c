@@ -309,6 +309,7 @@ static void uv__run_closing_handles(uv_loop_t *loop)
   while (p)
   {
     q = p->next_closing;
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_CLOSING, 1);
     uv__finish_close(p);
     p = q;
   }
@@ -350,6 +351,10 @@ int uv_backend_timeout(const uv_loop_t *loop)
   if (!QUEUE_EMPTY(&loop->pending_queue))
     return 0;
 
+  // 有 uv_loop_defer 的回调要运行
+  if (uv__has_deferred(loop))
+    return 0;
+
   if (loop->closing_handles)
     return 0;
 
@@ -366,6 +371,7 @@ static int uv__loop_alive(const uv_loop_t *loop)
 {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
+         uv__has_deferred(loop) ||
          loop->closing_handles != NULL;
 }
 
@@ -387,19 +393,26 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode)
     // 更新时间，该时间用于定时器
     uv__update_time(loop);
 
+  uv__async_enter(loop);
+
   // 主循环
   while (r != 0 && loop->stop_flag == 0)
   {
     // 更新时间，精读毫秒
     uv__update_time(loop);
+    uv__metrics_loop_begin(loop);
     // 运行定时器
     uv__run_timers(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_TIMERS);
     // 运行上一次 pending 的事件
     ran_pending = uv__run_pending(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_PENDING);
 
     // libuv 内部使用
     uv__run_idle(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_IDLE);
     uv__run_prepare(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_PREPARE);
 
     // 计算io_poll环节超时时间（IO阻塞时间）
     timeout = 0;
@@ -407,10 +420,17 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode)
     // 仅运行一次并且 pending 队列没有任务 或者 运行模式为 default 模式
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
       timeout = uv_backend_timeout(loop);
+    // 阻塞之前告诉发送方需要写 eventfd，醒着时被发送的 handle 在 poll 之后处理
+    timeout = uv__async_poll_start(loop, timeout);
     uv__io_poll(loop, timeout);
+    uv__async_poll_done(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_POLL);
     // libuv 内部使用
     uv__run_check(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_CHECK);
     uv__run_closing_handles(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_CLOSING);
 
     if (mode == UV_RUN_ONCE)
     {
@@ -424,8 +444,11 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode)
        */
       uv__update_time(loop);
       uv__run_timers(loop);
+      uv__metrics_phase(loop, UV_LOOP_PHASE_TIMERS);
     }
 
+    uv__metrics_loop_end(loop);
+
     // 检查loop是否存活
     r = uv__loop_alive(loop);
 
@@ -442,6 +465,8 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode)
   if (loop->stop_flag != 0)
     loop->stop_flag = 0;
 
+  uv__async_leave(loop);
+
   return r;
 }
 
@@ -869,6 +894,7 @@ static int uv__run_pending(uv_loop_t *loop)
     QUEUE_REMOVE(q);
     QUEUE_INIT(q);
     w = QUEUE_DATA(q, uv__io_t, pending_queue);
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_PENDING, 1);
     w->cb(loop, w, POLLOUT);
   }
 
@@ -959,15 +985,37 @@ void uv__io_init(uv__io_t *w, uv__io_cb cb, int fd)
 // 注入
 void uv__io_start(uv_loop_t *loop, uv__io_t *w, unsigned int events)
 {
+  unsigned int pevents;
+
   assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
   assert(0 != events);
   assert(w->fd >= 0);
   assert(w->fd < INT_MAX);
 
+  /* An edge-triggered watcher that is already writable won't be told again,
+   * let the callback find out with a try on the next tick.
+   */
+  if ((w->events & UV__POLLET) && (events & ~w->pevents & POLLOUT))
+    uv__io_feed(loop, w);
+
   // 绑定被epoll_wait监听的事件
+  pevents = w->pevents;
   w->pevents |= events;
   maybe_resize(loop, w->fd + 1);
 
+#if defined(__linux__)
+  /* The kernel is still watching these events, either because uv__io_stop()
+   * left them armed or because the watcher is edge-triggered.
+   */
+  if ((w->pevents & ~w->events & ~UV__POLLET) == 0)
+  {
+    assert(loop->watchers[w->fd] == w);
+    if (w->pevents != pevents)
+      uv__get_internal_fields(loop)->saved_syscalls++;
+    return;
+  }
+#endif
+
 #if !defined(__sun)
   /* The event ports backend needs to rearm all file descriptors on each and
    * every tick of the event loop but the other backends allow us to
@@ -993,6 +1041,8 @@ void uv__io_start(uv_loop_t *loop, uv__io_t *w, unsigned int events)
 
 void uv__io_stop(uv_loop_t *loop, uv__io_t *w, unsigned int events)
 {
+  unsigned int pevents;
+
   assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
   assert(0 != events);
 
@@ -1005,29 +1055,54 @@ void uv__io_stop(uv_loop_t *loop, uv__io_t *w, unsigned int events)
   if ((unsigned)w->fd >= loop->nwatchers)
     return;
 
+  pevents = w->pevents;
   w->pevents &= ~events;
 
-  if (w->pevents == 0)
+#if defined(__linux__)
+  /* Leave a watcher that is registered with the kernel as it is, even when
+   * it's not interested in anything anymore: uv__io_poll() filters out the
+   * events it doesn't want and disarms them if they fire, and restarting them
+   * is free. Saves two epoll_ctl() calls when a stream stops and restarts
+   * reading before new data comes in. uv__io_close() really removes it.
+   */
+  if (w->events != 0)
   {
-    QUEUE_REMOVE(&w->watcher_queue);
-    QUEUE_INIT(&w->watcher_queue);
-
-    if (loop->watchers[w->fd] != NULL)
-    {
-      assert(loop->watchers[w->fd] == w);
-      assert(loop->nfds > 0);
-      loop->watchers[w->fd] = NULL;
-      loop->nfds--;
-      w->events = 0;
-    }
+    if (w->pevents != pevents && (w->pevents & ~UV__POLLET) != 0)
+      uv__get_internal_fields(loop)->saved_syscalls++;
+    return;
   }
+#endif
+
+  if ((w->pevents & ~UV__POLLET) == 0)
+    uv__io_remove(loop, w);
   else if (QUEUE_EMPTY(&w->watcher_queue))
     QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
 }
 
+/* Drops the watcher from the loop. Does not tell the kernel, that's up to the
+ * caller or to uv__io_poll() when it sees events for an unknown fd.
+ */
+void uv__io_remove(uv_loop_t *loop, uv__io_t *w)
+{
+  QUEUE_REMOVE(&w->watcher_queue);
+  QUEUE_INIT(&w->watcher_queue);
+  w->events = 0;
+
+  if (loop->watchers[w->fd] != NULL)
+  {
+    assert(loop->watchers[w->fd] == w);
+    assert(loop->nfds > 0);
+    loop->watchers[w->fd] = NULL;
+    loop->nfds--;
+  }
+}
+
 void uv__io_close(uv_loop_t *loop, uv__io_t *w)
 {
+  w->pevents &= ~UV__POLLET;
   uv__io_stop(loop, w, POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+  if (w->fd != -1 && (unsigned)w->fd < loop->nwatchers)
+    uv__io_remove(loop, w);
   QUEUE_REMOVE(&w->pending_queue);
 
   /* Remove stale events for this file descriptor */
@@ -1048,6 +1123,25 @@ int uv__io_active(const uv__io_t *w, unsigned int events)
   return 0 != (w->pevents & events);
 }
 
+/* Must be called before the watcher is registered with the kernel. Listen
+ * sockets and handles on loops that weren't configured with
+ * UV_LOOP_USE_EDGE_TRIGGERED stay level-triggered.
+ */
+void uv__io_set_edge_triggered(uv_loop_t *loop, uv__io_t *w, int on)
+{
+  assert(!(w->events & UV__POLLET));
+
+  if (on && (loop->flags & UV_LOOP_EDGE_TRIGGERED))
+    w->pevents |= UV__POLLET;
+  else
+    w->pevents &= ~UV__POLLET;
+}
+
+int uv__io_edge_triggered(const uv__io_t *w)
+{
+  return 0 != (w->pevents & UV__POLLET);
+}
+
 int uv__fd_exists(uv_loop_t *loop, int fd)
 {
   return (unsigned)fd < loop->nwatchers && loop->watchers[fd] != NULL;
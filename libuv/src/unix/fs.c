@@ -63,6 +63,10 @@
 #include <sys/sendfile.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/sysmacros.h> /* makedev */
+#endif
+
 #if defined(__APPLE__)
 #include <sys/sysctl.h>
 #elif defined(__linux__) && !defined(FICLONE)
@@ -151,24 +155,25 @@ extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
 // 根据有没有cb区分是否为异步操作
 // 异步操作提交给线程池执行，同步任务直接执行
 // uv__req_register 增加 active_reqs.count 数量（用于判定当前 loop 是否存活）
-#define POST                            \
-  do                                    \
-  {                                     \
-    if (cb != NULL)                     \
-    {                                   \
-      uv__req_register(loop, req);      \
-      uv__work_submit(loop,             \
-                      &req->work_req,   \
-                      UV__WORK_FAST_IO, \
-                      uv__fs_work,      \
-                      uv__fs_done);     \
-      return 0;                         \
-    }                                   \
-    else                                \
-    {                                   \
-      uv__fs_work(&req->work_req);      \
-      return req->result;               \
-    }                                   \
+#define POST                                 \
+  do                                         \
+  {                                          \
+    if (cb != NULL)                          \
+    {                                        \
+      uv__req_register(loop, req);           \
+      uv__work_submit(loop,                  \
+                      (uv_req_t*) req,       \
+                      &req->work_req,        \
+                      uv__fs_work_kind(req), \
+                      uv__fs_work,           \
+                      uv__fs_done);          \
+      return 0;                              \
+    }                                        \
+    else                                     \
+    {                                        \
+      uv__fs_work(&req->work_req);           \
+      return req->result;                    \
+    }                                        \
   } while (0)
 
 static int uv__fs_close(int fd)
@@ -1457,15 +1462,610 @@ static ssize_t uv__fs_write_all(uv_fs_t *req)
 }
 
 // 执行操作
+/* Adaptive slow I/O lane for file system requests.
+ *
+ * Workers time every request and keep a moving average of the latency of
+ * each device, keyed by st_dev.  Once the average of a device reaches
+ * UV__FS_SLOW_NS, new requests for that device are posted as
+ * UV__WORK_SLOW_IO, so a hung network mount can't take every thread of the
+ * pool.  The device goes back to the fast lane when its average drops
+ * below half of that.
+ *
+ * The loop thread picks the lane without a lock or a system call, it only
+ * reads what the workers published: the slow devices, a table of the
+ * devices of file descriptors and, on Linux, a snapshot of the mount table
+ * to match paths against.  Only workers reload the mount table.  As long
+ * as no device is slow, requests aren't looked up at all and only requests
+ * that took a while are recorded.
+ */
+
+#define UV__FS_SLOW_NS ((uint64_t)50 * 1000 * 1000)
+#define UV__FS_DEVICES 64
+#define UV__FS_MOUNTS_TTL ((uint64_t)10 * 1000 * 1000 * 1000)
+/* The descriptor table is allocated in chunks that are never freed, so the
+ * loop thread can read it while workers grow it.
+ */
+#define UV__FS_FD_CHUNK 1024
+#define UV__FS_FD_CHUNKS 1024
+
+#define uv__fs_load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define uv__fs_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define uv__fs_fetch_add(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define uv__fs_fetch_sub(p, v) __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)
+
+struct uv__fs_device
+{
+  uint64_t dev;
+  uint64_t avg; /* Moving average of the latency, in ns. */
+  int used;
+  int slow;
+};
+
+struct uv__fs_fd
+{
+  uint64_t dev; /* Device + 1, 0 if not known. Read without the lock. */
+  int sampled;  /* Regular file or directory, not a pipe or a tty. */
+};
+
+struct uv__fs_mount
+{
+  char *path;
+  size_t len;
+  uint64_t dev;
+};
+
+/* A snapshot of the mount table. It doesn't change once published. */
+struct uv__fs_mounts
+{
+  struct uv__fs_mounts *next; /* Replaced snapshots that aren't freed yet. */
+  struct uv__fs_mount *mounts;
+  unsigned int nmounts;
+  char *cwd; /* For relative paths, NULL if unknown. */
+};
+
+static uv_once_t uv__fs_dev_once = UV_ONCE_INIT;
+static uv_mutex_t uv__fs_dev_mutex;
+static struct uv__fs_device uv__fs_devices[UV__FS_DEVICES];
+/* Number of slow devices. Read without the lock as a hint. */
+static unsigned int uv__fs_nslow;
+/* Device + 1 of the slow entries of uv__fs_devices, 0 for the others. */
+static uint64_t uv__fs_slow[UV__FS_DEVICES];
+static struct uv__fs_fd *uv__fs_fds[UV__FS_FD_CHUNKS];
+#if defined(__linux__)
+static struct uv__fs_mounts *uv__fs_mounts;
+static struct uv__fs_mounts *uv__fs_mounts_old;
+static uint64_t uv__fs_mounts_time;
+/* Loop threads that are reading a snapshot right now. */
+static unsigned int uv__fs_mounts_readers;
+#endif
+
+static void uv__fs_dev_init(void)
+{
+  if (uv_mutex_init(&uv__fs_dev_mutex))
+    abort();
+}
+
+static int uv__fs_is_fd_op(uv_fs_type type)
+{
+  switch (type)
+  {
+  case UV_FS_CLOSE:
+  case UV_FS_FCHMOD:
+  case UV_FS_FCHOWN:
+  case UV_FS_FDATASYNC:
+  case UV_FS_FSTAT:
+  case UV_FS_FSYNC:
+  case UV_FS_FTRUNCATE:
+  case UV_FS_FUTIME:
+  case UV_FS_READ:
+  case UV_FS_SENDFILE:
+  case UV_FS_WRITE:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* Requests that are slow on any device, or that don't touch a device. */
+static int uv__fs_is_sampled_op(uv_fs_type type)
+{
+  switch (type)
+  {
+  case UV_FS_FSYNC:
+  case UV_FS_FDATASYNC:
+  case UV_FS_READDIR:
+  case UV_FS_CLOSEDIR:
+  case UV_FS_MKDTEMP:
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+/* Caller holds uv__fs_dev_mutex. */
+static struct uv__fs_fd *uv__fs_fd_get(int fd, int create)
+{
+  struct uv__fs_fd *chunk;
+
+  if (fd < 0 || (unsigned int)fd / UV__FS_FD_CHUNK >= UV__FS_FD_CHUNKS)
+    return NULL;
+
+  chunk = uv__fs_fds[fd / UV__FS_FD_CHUNK];
+  if (chunk == NULL)
+  {
+    if (!create)
+      return NULL;
+
+    chunk = uv__calloc(UV__FS_FD_CHUNK, sizeof(*chunk));
+    if (chunk == NULL)
+      return NULL;
+
+    uv__fs_store(&uv__fs_fds[fd / UV__FS_FD_CHUNK], chunk);
+  }
+
+  return chunk + fd % UV__FS_FD_CHUNK;
+}
+
+/* Looks up the device of a descriptor without the lock. */
+static int uv__fs_fd_dev(int fd, uint64_t *dev)
+{
+  struct uv__fs_fd *chunk;
+  uint64_t d;
+
+  if (fd < 0 || (unsigned int)fd / UV__FS_FD_CHUNK >= UV__FS_FD_CHUNKS)
+    return 0;
+
+  chunk = uv__fs_load(&uv__fs_fds[fd / UV__FS_FD_CHUNK]);
+  if (chunk == NULL)
+    return 0;
+
+  d = uv__fs_load(&chunk[fd % UV__FS_FD_CHUNK].dev);
+  if (d == 0)
+    return 0;
+
+  *dev = d - 1;
+  return 1;
+}
+
+static void uv__fs_fd_forget(int fd)
+{
+  struct uv__fs_fd *f;
+  uint64_t dev;
+
+  /* Nothing was recorded for it. */
+  if (!uv__fs_fd_dev(fd, &dev))
+    return;
+
+  uv_once(&uv__fs_dev_once, uv__fs_dev_init);
+  uv_mutex_lock(&uv__fs_dev_mutex);
+  f = uv__fs_fd_get(fd, 0);
+  if (f != NULL)
+    uv__fs_store(&f->dev, 0);
+  uv_mutex_unlock(&uv__fs_dev_mutex);
+}
+
+#if defined(__linux__)
+static void uv__fs_mounts_free(struct uv__fs_mounts *t)
+{
+  unsigned int i;
+
+  for (i = 0; i < t->nmounts; i++)
+    uv__free(t->mounts[i].path);
+
+  uv__free(t->mounts);
+  uv__free(t->cwd);
+  uv__free(t);
+}
+
+/* Decodes the octal escapes of /proc/self/mountinfo in place. */
+static void uv__fs_unescape(char *s)
+{
+  char *d;
+
+  for (d = s; *s != '\0'; d++)
+  {
+    if (s[0] == '\\' &&
+        s[1] >= '0' && s[1] <= '7' &&
+        s[2] >= '0' && s[2] <= '7' &&
+        s[3] >= '0' && s[3] <= '7')
+    {
+      *d = (char)((s[1] - '0') * 64 + (s[2] - '0') * 8 + (s[3] - '0'));
+      s += 4;
+    }
+    else
+    {
+      *d = *s++;
+    }
+  }
+
+  *d = '\0';
+}
+
+/* Reads a new snapshot of the mount table, NULL if that fails. */
+static struct uv__fs_mounts *uv__fs_mounts_load(void)
+{
+  struct uv__fs_mounts *t;
+  struct uv__fs_mount *mounts;
+  struct uv__fs_mount *m;
+  unsigned int major;
+  unsigned int minor;
+  unsigned int n;
+  char path[4096];
+  char line[8192];
+  FILE *fp;
+
+  fp = uv__open_file("/proc/self/mountinfo");
+  if (fp == NULL)
+    return NULL;
+
+  t = uv__calloc(1, sizeof(*t));
+  if (t == NULL)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  n = 0;
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (sscanf(line, "%*u %*u %u:%u %*s %4095s", &major, &minor, path) != 3)
+      continue;
+
+    if (t->nmounts == n)
+    {
+      n = n == 0 ? 32 : 2 * n;
+      mounts = uv__realloc(t->mounts, n * sizeof(*mounts));
+      if (mounts == NULL)
+        break;
+      t->mounts = mounts;
+    }
+
+    uv__fs_unescape(path);
+    m = t->mounts + t->nmounts;
+    m->path = uv__strdup(path);
+    if (m->path == NULL)
+      break;
+    m->len = strlen(path);
+    m->dev = makedev(major, minor);
+    t->nmounts++;
+  }
+
+  fclose(fp);
+
+  /* A chdir() is only noticed with the next reload, until then relative
+   * paths may be put in the wrong lane.
+   */
+  if (getcwd(path, sizeof(path)) != NULL)
+    t->cwd = uv__strdup(path);
+
+  return t;
+}
+#endif
+
+/* Returns the snapshot of the mount table for a worker, after reloading it
+ * if it is older than UV__FS_MOUNTS_TTL. Caller holds uv__fs_dev_mutex.
+ */
+static const struct uv__fs_mounts *uv__fs_mounts_get(void)
+{
+#if defined(__linux__)
+  struct uv__fs_mounts *t;
+  uint64_t now;
+
+  now = uv__hrtime(UV_CLOCK_FAST);
+  if (uv__fs_mounts_time != 0 && now - uv__fs_mounts_time <= UV__FS_MOUNTS_TTL)
+    return uv__fs_mounts;
+
+  uv__fs_mounts_time = now;
+  t = uv__fs_mounts_load();
+  if (t == NULL)
+    return uv__fs_mounts;
+
+  if (uv__fs_mounts != NULL)
+  {
+    uv__fs_mounts->next = uv__fs_mounts_old;
+    uv__fs_mounts_old = uv__fs_mounts;
+  }
+  uv__fs_store(&uv__fs_mounts, t);
+
+  /* A loop thread that starts reading after the store gets the new
+   * snapshot, so the old ones can go once nobody is reading.
+   */
+  if (uv__fs_load(&uv__fs_mounts_readers) == 0)
+  {
+    while (uv__fs_mounts_old != NULL)
+    {
+      t = uv__fs_mounts_old;
+      uv__fs_mounts_old = t->next;
+      uv__fs_mounts_free(t);
+    }
+  }
+
+  return uv__fs_mounts;
+#else
+  return NULL;
+#endif
+}
+
+/* Finds the device of a path by the longest mount point that is a prefix
+ * of it, relative paths are made absolute with the cwd of the snapshot.
+ */
+static int uv__fs_mount_dev(const struct uv__fs_mounts *t,
+                            const char *path,
+                            uint64_t *dev)
+{
+  const struct uv__fs_mount *best;
+  const struct uv__fs_mount *m;
+  char buf[PATH_MAX];
+  unsigned int i;
+  size_t len;
+
+  if (t == NULL || path == NULL)
+    return 0;
+
+  if (path[0] != '/')
+  {
+    if (t->cwd == NULL)
+      return 0;
+
+    len = strlen(t->cwd);
+    if (len + 1 + strlen(path) + 1 > sizeof(buf))
+      return 0;
+
+    memcpy(buf, t->cwd, len);
+    buf[len] = '/';
+    strcpy(buf + len + 1, path);
+    path = buf;
+  }
+
+  best = NULL;
+  for (i = 0; i < t->nmounts; i++)
+  {
+    m = t->mounts + i;
+    if (best != NULL && m->len <= best->len)
+      continue;
+    if (strncmp(path, m->path, m->len) != 0)
+      continue;
+    if (path[m->len] != '/' && path[m->len] != '\0' && m->len != 1)
+      continue;
+    best = m;
+  }
+
+  if (best == NULL)
+    return 0;
+
+  *dev = best->dev;
+  return 1;
+}
+
+/* Returns the lane for a request, called on the loop thread. */
+static enum uv__work_kind uv__fs_work_kind(const uv_fs_t *req)
+{
+  uint64_t dev;
+  unsigned int i;
+  int found;
+
+  if (uv__fs_nslow == 0)
+    return UV__WORK_FAST_IO;
+
+  if (uv__fs_is_fd_op(req->fs_type))
+  {
+    found = uv__fs_fd_dev(req->file, &dev);
+  }
+  else
+  {
+#if defined(__linux__)
+    /* Keeps workers from freeing the snapshot while it's read. */
+    uv__fs_fetch_add(&uv__fs_mounts_readers, 1);
+    found = uv__fs_mount_dev(uv__fs_load(&uv__fs_mounts), req->path, &dev);
+    uv__fs_fetch_sub(&uv__fs_mounts_readers, 1);
+#else
+    found = 0;
+#endif
+  }
+
+  if (found)
+    for (i = 0; i < UV__FS_DEVICES; i++)
+      if (uv__fs_load(&uv__fs_slow[i]) == dev + 1)
+        return UV__WORK_SLOW_IO;
+
+  return UV__WORK_FAST_IO;
+}
+
+/* Folds a latency sample into the average of a device. Caller holds
+ * uv__fs_dev_mutex.
+ */
+static void uv__fs_device_sample(uint64_t dev, uint64_t ns)
+{
+  struct uv__fs_device *victim;
+  struct uv__fs_device *d;
+  struct uv__fs_device *e;
+  unsigned int i;
+
+  d = NULL;
+  victim = NULL;
+  for (i = 0; i < UV__FS_DEVICES; i++)
+  {
+    e = uv__fs_devices + i;
+    if (e->used && e->dev == dev)
+    {
+      d = e;
+      break;
+    }
+
+    /* Prefer a free entry, then the fastest device that isn't slow. */
+    if (!e->used)
+    {
+      if (victim == NULL || victim->used)
+        victim = e;
+    }
+    else if (!e->slow && (victim == NULL ||
+                          (victim->used && e->avg < victim->avg)))
+    {
+      victim = e;
+    }
+  }
+
+  /* A new device, replacing the fastest one when the table is full. */
+  if (d == NULL)
+  {
+    if (victim == NULL)
+      return;
+    d = victim;
+    d->dev = dev;
+    d->avg = 0;
+    d->used = 1;
+    d->slow = 0;
+  }
+
+  if (ns >= d->avg)
+    d->avg += (ns - d->avg) / 4;
+  else
+    d->avg -= (d->avg - ns) / 4;
+
+  if (!d->slow && d->avg >= UV__FS_SLOW_NS)
+  {
+    d->slow = 1;
+    uv__fs_store(&uv__fs_slow[d - uv__fs_devices], dev + 1);
+    uv__fs_nslow++;
+  }
+  else if (d->slow && d->avg < UV__FS_SLOW_NS / 2)
+  {
+    d->slow = 0;
+    uv__fs_store(&uv__fs_slow[d - uv__fs_devices], 0);
+    uv__fs_nslow--;
+  }
+}
+
+/* Records how long a request took, called after it ran. */
+static void uv__fs_sample(uv_fs_t *req, ssize_t r, uint64_t ns)
+{
+  struct uv__fs_fd *f;
+  const char *path;
+  struct stat st;
+  uint64_t dev;
+  int sampled;
+  int found;
+  int fd;
+
+  /* The number may have been used by a descriptor that libuv didn't see
+   * being closed.
+   */
+  if (req->fs_type == UV_FS_OPEN && r >= 0)
+    uv__fs_fd_forget(r);
+
+  /* Fast requests only matter for bringing a slow device back. Synchronous
+   * requests aren't sampled at all: they run on the caller's thread, which
+   * shouldn't wait for the lock or for the mount table to be reloaded.
+   */
+  if (req->cb == NULL || !uv__fs_is_sampled_op(req->fs_type) ||
+      (ns < UV__FS_SLOW_NS / 4 && uv__fs_nslow == 0))
+  {
+    if (req->fs_type == UV_FS_CLOSE)
+      uv__fs_fd_forget(req->file);
+    return;
+  }
+
+  uv_once(&uv__fs_dev_once, uv__fs_dev_init);
+
+  found = 0;
+  sampled = 1;
+  path = NULL;
+  fd = -1;
+
+  if (uv__fs_is_fd_op(req->fs_type))
+  {
+    fd = req->file;
+    if (req->fs_type == UV_FS_FSTAT && r == 0)
+    {
+      found = 1;
+      dev = req->statbuf.st_dev;
+      sampled = S_ISREG(req->statbuf.st_mode) || S_ISDIR(req->statbuf.st_mode);
+    }
+  }
+  else
+  {
+    path = req->path;
+  }
+
+  /* Opening a FIFO or a tty waits for the other end, not for the device.
+   * The new descriptor is recorded while at it.
+   */
+  if (req->fs_type == UV_FS_OPEN && r >= 0)
+  {
+    if (fstat(r, &st))
+      return;
+    found = 1;
+    dev = st.st_dev;
+    sampled = S_ISREG(st.st_mode) || S_ISDIR(st.st_mode);
+    fd = r;
+  }
+
+  uv_mutex_lock(&uv__fs_dev_mutex);
+
+  /* Paths are looked up like uv__fs_work_kind() does, st_dev is only a
+   * fallback for platforms without a mount table.
+   */
+  if (path != NULL && uv__fs_mount_dev(uv__fs_mounts_get(), path, &dev))
+    found = 1;
+
+  if (!found && r == 0 &&
+      (req->fs_type == UV_FS_STAT || req->fs_type == UV_FS_LSTAT))
+  {
+    found = 1;
+    dev = req->statbuf.st_dev;
+  }
+
+  if (fd != -1)
+  {
+    f = uv__fs_fd_get(fd, 0);
+    if (!found && f != NULL && f->dev != 0)
+    {
+      found = 1;
+      dev = f->dev - 1;
+      sampled = f->sampled;
+    }
+  }
+
+  /* First request for this descriptor, look it up outside of the lock. */
+  if (fd != -1 && !found && req->fs_type != UV_FS_CLOSE)
+  {
+    uv_mutex_unlock(&uv__fs_dev_mutex);
+    if (fstat(fd, &st))
+      return;
+    found = 1;
+    dev = st.st_dev;
+    sampled = S_ISREG(st.st_mode) || S_ISDIR(st.st_mode);
+    uv_mutex_lock(&uv__fs_dev_mutex);
+  }
+
+  if (found && fd != -1)
+  {
+    f = uv__fs_fd_get(fd, req->fs_type != UV_FS_CLOSE);
+    if (f != NULL)
+    {
+      uv__fs_store(&f->dev, req->fs_type != UV_FS_CLOSE ? dev + 1 : 0);
+      f->sampled = sampled;
+    }
+  }
+
+  if (found && sampled)
+    uv__fs_device_sample(dev, ns);
+
+  uv_mutex_unlock(&uv__fs_dev_mutex);
+}
+
 static void uv__fs_work(struct uv__work *w)
 {
   int retry_on_eintr;
+  int saved_errno;
+  uint64_t start;
   uv_fs_t *req;
   ssize_t r;
 
   req = container_of(w, uv_fs_t, work_req);
   retry_on_eintr = !(req->fs_type == UV_FS_CLOSE ||
                      req->fs_type == UV_FS_READ);
+  start = uv__hrtime(UV_CLOCK_FAST);
 
   do
   {
@@ -1520,6 +2120,11 @@ static void uv__fs_work(struct uv__work *w)
 #undef X
   } while (r == -1 && errno == EINTR && retry_on_eintr);
 
+  // 记录耗时，耗时长的设备之后的请求走慢IO队列；采样里的系统调用不能改掉 errno
+  saved_errno = errno;
+  uv__fs_sample(req, r, uv__hrtime(UV_CLOCK_FAST) - start);
+  errno = saved_errno;
+
   if (r == -1)
     req->result = UV__ERR(errno);
   else
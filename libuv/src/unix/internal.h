@@ -128,6 +128,15 @@ int uv__pthread_sigmask(int how, const sigset_t *set, sigset_t *oset);
 #define UV__POLLPRI 0
 #endif
 
+/* Leans on the fact that, on Linux, EPOLLET == 1u << 31.  Only the epoll
+ * backend supports edge-triggered watchers, everywhere else it's a no-op.
+ */
+#if defined(__linux__)
+#define UV__POLLET 0x80000000u
+#else
+#define UV__POLLET 0
+#endif
+
 #if !defined(O_CLOEXEC) && defined(__FreeBSD__)
 /*
  * It may be that we are just missing `__POSIX_VISIBLE >= 200809`.
@@ -141,7 +150,8 @@ typedef struct uv__stream_queued_fds_s uv__stream_queued_fds_t;
 /* loop flags */
 enum
 {
-  UV_LOOP_BLOCK_SIGPROF = 1
+  UV_LOOP_BLOCK_SIGPROF = 1,
+  UV_LOOP_EDGE_TRIGGERED = 2
 };
 
 /* flags of excluding ifaddr */
@@ -208,8 +218,11 @@ void uv__io_init(uv__io_t *w, uv__io_cb cb, int fd);
 void uv__io_start(uv_loop_t *loop, uv__io_t *w, unsigned int events);
 void uv__io_stop(uv_loop_t *loop, uv__io_t *w, unsigned int events);
 void uv__io_close(uv_loop_t *loop, uv__io_t *w);
+void uv__io_remove(uv_loop_t *loop, uv__io_t *w);
 void uv__io_feed(uv_loop_t *loop, uv__io_t *w);
 int uv__io_active(const uv__io_t *w, unsigned int events);
+void uv__io_set_edge_triggered(uv_loop_t *loop, uv__io_t *w, int on);
+int uv__io_edge_triggered(const uv__io_t *w);
 int uv__io_check_fd(uv_loop_t *loop, int fd);
 void uv__io_poll(uv_loop_t *loop, int timeout); /* in milliseconds or -1 */
 int uv__io_fork(uv_loop_t *loop);
@@ -218,6 +231,10 @@ int uv__fd_exists(uv_loop_t *loop, int fd);
 /* async */
 void uv__async_stop(uv_loop_t *loop);
 int uv__async_fork(uv_loop_t *loop);
+void uv__async_enter(uv_loop_t *loop);
+void uv__async_leave(uv_loop_t *loop);
+int uv__async_poll_start(uv_loop_t *loop, int timeout);
+void uv__async_poll_done(uv_loop_t *loop);
 
 /* loop */
 void uv__run_idle(uv_loop_t *loop);
@@ -302,6 +319,19 @@ void uv__fsevents_loop_delete(uv_loop_t *loop);
 // 高精度时钟
 UV_UNUSED(static void uv__update_time(uv_loop_t *loop))
 {
+  uv__loop_internal_fields_t *lfields;
+
+  /* Nanosecond timers need the precise clock, the fast one may lag behind
+   * by a few milliseconds.
+   */
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->flags & UV__LOOP_HRTIME)
+  {
+    lfields->time_ns = uv__hrtime(UV_CLOCK_PRECISE);
+    loop->time = lfields->time_ns / 1000000;
+    return;
+  }
+
   /* Use a fast time source if available.  We only need millisecond precision.
    */
   loop->time = uv__hrtime(UV_CLOCK_FAST) / 1000000;
@@ -320,6 +350,11 @@ UV_UNUSED(static char *uv__basename_r(const char *path))
 
 #if defined(__linux__)
 int uv__inotify_fork(uv_loop_t *loop, void *old_watchers);
+int uv__iou_init(uv_loop_t *loop);
+void uv__iou_delete(uv_loop_t *loop);
+void uv__iou_invalidate_fd(uv_loop_t *loop, int fd);
+void uv__iou_poll(uv_loop_t *loop, int timeout);
+int uv__epoll_busy_poll(uv_loop_t *loop, unsigned int usec);
 #endif
 
 typedef int (*uv__peersockfunc)(int, struct sockaddr *, socklen_t *);
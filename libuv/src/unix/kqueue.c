@@ -208,6 +208,9 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       spec.tv_nsec = (timeout % 1000) * 1000000;
     }
 
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     if (pset != NULL)
       pthread_sigmask(SIG_BLOCK, pset, NULL);
 
@@ -221,6 +224,10 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (pset != NULL)
       pthread_sigmask(SIG_UNBLOCK, pset, NULL);
 
+    if (timeout != 0)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
+
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
      * operating system didn't reschedule our process while in the syscall.
@@ -248,6 +255,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     have_signals = 0;
     nevents = 0;
+    uv__metrics_add(loop, events, nfds);
 
     assert(loop->watchers != NULL);
     loop->watchers[loop->nwatchers] = (void*) events;
@@ -348,6 +356,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (have_signals != 0)
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
 
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, nevents);
+
     loop->watchers[loop->nwatchers] = NULL;
     loop->watchers[loop->nwatchers + 1] = NULL;
 
@@ -36,6 +36,7 @@
 
 #include <net/if.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>
 #include <sys/prctl.h>
 #include <sys/sysinfo.h>
@@ -82,8 +83,29 @@ static int read_times(FILE *statfile_fp,
 static void read_speeds(unsigned int numcpus, uv_cpu_info_t *ci);
 static uint64_t read_cpufreq(unsigned int cpunum);
 
+// epoll_pwait2() 需要 Linux 5.11，不支持时退回毫秒精度
+static int no_epoll_pwait2;
+
+/* struct epoll_params from <linux/eventpoll.h>, Linux 6.9 and newer. */
+struct uv__epoll_params {
+  uint32_t busy_poll_usecs;
+  uint16_t busy_poll_budget;
+  uint8_t prefer_busy_poll;
+  uint8_t pad;
+};
+
+#ifndef EPIOCSPARAMS
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct uv__epoll_params)
+#endif
+
+/* Same as the kernel's BUSY_POLL_BUDGET, the most an unprivileged process
+ * may ask for is NAPI_POLL_WEIGHT.
+ */
+#define UV__BUSY_POLL_BUDGET 8
+
 int uv__platform_loop_init(uv_loop_t *loop)
 {
+  const char *val;
   int fd;
 
   /* It was reported that EPOLL_CLOEXEC is not defined on Android API < 21,
@@ -110,15 +132,24 @@ int uv__platform_loop_init(uv_loop_t *loop)
   if (fd == -1)
     return UV__ERR(errno);
 
+  /* Lets the test suite and benchmarks run against the io_uring backend
+   * without having to call uv_loop_configure().
+   */
+  val = getenv("UV_USE_IO_URING");
+  if (val != NULL && atoi(val) != 0)
+    uv__iou_init(loop);
+
   return 0;
 }
 
 int uv__io_fork(uv_loop_t *loop)
 {
   int err;
+  int had_iou;
   void *old_watchers;
 
   old_watchers = loop->inotify_watchers;
+  had_iou = uv__get_internal_fields(loop)->iou != NULL;
 
   uv__close(loop->backend_fd);
   loop->backend_fd = -1;
@@ -128,14 +159,19 @@ int uv__io_fork(uv_loop_t *loop)
   if (err)
     return err;
 
+  if (had_iou)
+    uv__iou_init(loop);
+
   return uv__inotify_fork(loop, old_watchers);
 }
 
 void uv__platform_loop_delete(uv_loop_t *loop)
 {
+  uv__iou_delete(loop);
+
   if (loop->inotify_fd == -1)
     return;
-  uv__io_stop(loop, &loop->inotify_read_watcher, POLLIN);
+  uv__io_close(loop, &loop->inotify_read_watcher);
   uv__close(loop->inotify_fd);
   loop->inotify_fd = -1;
 }
@@ -150,6 +186,12 @@ void uv__platform_invalidate_fd(uv_loop_t *loop, int fd)
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
+  if (uv__get_internal_fields(loop)->iou != NULL)
+  {
+    uv__iou_invalidate_fd(loop, fd);
+    return;
+  }
+
   events = (struct epoll_event *)loop->watchers[loop->nwatchers];
   nfds = (uintptr_t)loop->watchers[loop->nwatchers + 1];
   if (events != NULL)
@@ -195,6 +237,52 @@ int uv__io_check_fd(uv_loop_t *loop, int fd)
   return rc;
 }
 
+// 忙轮询：阻塞之前先用零超时的 epoll_pwait 空转 usec 微秒
+int uv__epoll_busy_poll(uv_loop_t *loop, unsigned int usec)
+{
+  struct uv__epoll_params params;
+
+  if (usec > INT32_MAX)
+    return UV_EINVAL;
+
+  // 只有 epoll 后端会空转
+  if (uv__get_internal_fields(loop)->iou != NULL)
+    return UV_ENOTSUP;
+
+  uv__get_internal_fields(loop)->busy_poll_us = usec;
+
+  /* Best effort: also let the kernel busy poll the network devices of the
+   * loop's sockets while it waits.  Kernels before 6.9 don't know the ioctl.
+   */
+  memset(&params, 0, sizeof(params));
+  params.busy_poll_usecs = usec;
+  params.busy_poll_budget = UV__BUSY_POLL_BUDGET;
+  ioctl(loop->backend_fd, EPIOCSPARAMS, &params);
+
+  return 0;
+}
+
+// 在 ns 纳秒内反复非阻塞地轮询，有事件或出错时立即返回
+static int uv__epoll_spin(uv_loop_t *loop,
+                          struct epoll_event *events,
+                          int nevents,
+                          const sigset_t *psigset,
+                          uint64_t ns)
+{
+  uint64_t deadline;
+  int nfds;
+
+  deadline = uv__hrtime(UV_CLOCK_PRECISE) + ns;
+  do
+  {
+    nfds = epoll_pwait(loop->backend_fd, events, nevents, 0, psigset);
+    if (nfds != 0)
+      return nfds;
+  } while (uv__hrtime(UV_CLOCK_PRECISE) < deadline);
+
+  return 0;
+}
+
 // 执行IO
 void uv__io_poll(uv_loop_t *loop, int timeout)
 {
@@ -212,7 +300,13 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
   struct epoll_event events[1024];
   struct epoll_event *pe;
   struct epoll_event e;
+  struct uv__kernel_timespec ts;
+  uint64_t timeout_ns;
+  uint64_t spin_ns;
   int real_timeout;
+  int hrtime;
+  int spin;
+  int idle;
   QUEUE *q;
   // IO观察者
   uv__io_t *w;
@@ -229,6 +323,12 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
   int op;
   int i;
 
+  if (uv__get_internal_fields(loop)->iou != NULL)
+  {
+    uv__iou_poll(loop, timeout);
+    return;
+  }
+
   if (loop->nfds == 0)
   {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
@@ -248,24 +348,37 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
 
     // 观察者
     w = QUEUE_DATA(q, uv__io_t, watcher_queue);
-    assert(w->pevents != 0);
     assert(w->fd >= 0);
     assert(w->fd < (int)loop->nwatchers);
 
+    /* Stopped while queued, uv__io_stop() leaves registered watchers alone. */
+    if ((w->pevents & ~UV__POLLET) == 0)
+      continue;
+
     // epoll_event
-    e.events = w->pevents;
+    /* Edge-triggered watchers are registered once for everything they may
+     * ever care about.  The handle remembers what it saw and filters out
+     * what it isn't interested in at the moment, see uv__stream_io().
+     */
+    if (w->pevents & UV__POLLET)
+      e.events = POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLET;
+    else
+      e.events = w->pevents;
     // 需要监听的fd
     e.data.fd = w->fd;
 
+    if (e.events == w->events)
+    {
+      uv__get_internal_fields(loop)->saved_syscalls++;
+      continue;
+    }
+
     // 确认操作
     if (w->events == 0)
       op = EPOLL_CTL_ADD;
     else
       op = EPOLL_CTL_MOD;
 
-    /* XXX Future optimization: do EPOLL_CTL_MOD lazily if we stop watching
-     * events, skip the syscall and squelch the events after epoll_wait().
-     */
     if (epoll_ctl(loop->backend_fd, op, w->fd, &e))
     {
       if (errno != EEXIST)
@@ -279,7 +392,7 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
         abort();
     }
 
-    w->events = w->pevents;
+    w->events = e.events;
   }
 
   psigset = NULL;
@@ -292,6 +405,9 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
 
   assert(timeout >= -1);
   base = loop->time;
+  hrtime = uv__get_internal_fields(loop)->flags & UV__LOOP_HRTIME;
+  // 每次调用最多空转一次
+  spin = uv__get_internal_fields(loop)->busy_poll_us != 0;
   // 吞吐量
   count = 48; /* Benchmarks suggest this gives the best throughput. */
   real_timeout = timeout;
@@ -308,11 +424,77 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
     // timeout为最大等待时长
     // timeout是一个动态变化的值，当timeout=0时epoll_wait返回
     // timeout也是uv__io_poll返回的依据
-    nfds = epoll_pwait(loop->backend_fd,
-                       events,
-                       ARRAY_SIZE(events),
-                       timeout,
-                       psigset);
+    // 空转也算作等待事件的空闲时间
+    idle = timeout != 0;
+    if (idle)
+      uv__metrics_set_provider_entry_time(loop);
+
+    // 忙轮询：先空转，空转期间有事件就不必进入内核睡眠
+    nfds = 0;
+    if (spin && timeout != 0)
+    {
+      spin = 0;
+      spin_ns = uv__get_internal_fields(loop)->busy_poll_us * (uint64_t)1000;
+      if (timeout > 0 && spin_ns > timeout * (uint64_t)1000000)
+        spin_ns = timeout * (uint64_t)1000000;
+
+      nfds = uv__epoll_spin(loop,
+                            events,
+                            ARRAY_SIZE(events),
+                            psigset,
+                            spin_ns);
+
+      if (nfds != 0)
+      {
+        uv__metrics_add(loop, spin_hits, 1);
+      }
+      else
+      {
+        uv__metrics_add(loop, spin_blocks, 1);
+        // 扣除空转的时间
+        if (timeout > 0)
+        {
+          SAVE_ERRNO(uv__update_time(loop));
+          timeout = real_timeout - (int)(loop->time - base);
+          if (timeout < 0)
+            timeout = 0;
+        }
+      }
+    }
+
+    // 纳秒定时器：正的 timeout 一定来自定时器，按纳秒精度等待到第一个定时器到期
+    if (nfds == 0 && hrtime && timeout > 0 && !no_epoll_pwait2)
+    {
+      timeout_ns = uv__next_timeout_ns(loop);
+      ts.tv_sec = timeout_ns / 1000000000;
+      ts.tv_nsec = timeout_ns % 1000000000;
+      nfds = uv__epoll_pwait2(loop->backend_fd,
+                              events,
+                              ARRAY_SIZE(events),
+                              &ts,
+                              psigset);
+      if (nfds == -1 && errno == ENOSYS)
+      {
+        no_epoll_pwait2 = 1;
+        nfds = epoll_pwait(loop->backend_fd,
+                           events,
+                           ARRAY_SIZE(events),
+                           timeout,
+                           psigset);
+      }
+    }
+    else if (nfds == 0)
+    {
+      nfds = epoll_pwait(loop->backend_fd,
+                         events,
+                         ARRAY_SIZE(events),
+                         timeout,
+                         psigset);
+    }
+
+    if (idle)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
 
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
@@ -354,6 +536,7 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
 
     have_signals = 0;
     nevents = 0;
+    uv__metrics_add(loop, events, nfds);
 
     assert(loop->watchers != NULL);
     loop->watchers[loop->nwatchers] = (void *)events;
@@ -389,6 +572,38 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
         continue;
       }
 
+      /* Edge-triggered watchers get every event: they need to record
+       * readiness and hangups that happen while they're not interested,
+       * which also makes the workaround below unnecessary for them.
+       */
+      if (w->pevents & UV__POLLET)
+      {
+        w->cb(loop, w, pe->events);
+        nevents++;
+        continue;
+      }
+
+      /* uv__io_stop() doesn't tell the kernel when the watcher stops watching
+       * events, disarm them now that they fired again. This has to happen
+       * right away, level-triggered events keep firing until they're
+       * disarmed.
+       */
+      if (w->pevents == 0)
+      {
+        epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, fd, pe);
+        uv__io_remove(loop, w);
+        continue;
+      }
+
+      if (pe->events & ~w->pevents & w->events)
+      {
+        e.events = w->pevents;
+        e.data.fd = fd;
+        if (epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, fd, &e))
+          abort();
+        w->events = w->pevents;
+      }
+
       /* Give users only events they're interested in. Prevents spurious
        * callbacks when previous callback invocation in this loop has stopped
        * the current watcher. Also, filters out events that users has not
@@ -435,6 +650,8 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
     if (have_signals != 0)
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
 
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, nevents);
+
     loop->watchers[loop->nwatchers] = NULL;
     loop->watchers[loop->nwatchers + 1] = NULL;
 
@@ -463,6 +680,10 @@ void uv__io_poll(uv_loop_t *loop, int timeout)
   update_timeout:
     assert(timeout > 0);
 
+    // 毫秒 timeout 是向上取整的，纳秒定时器可能已经到期
+    if (hrtime && uv__next_timeout_ns(loop) == 0)
+      return;
+
     // 实际超时时间
     real_timeout -= (loop->time - base);
     if (real_timeout <= 0)
@@ -0,0 +1,569 @@
+/* Copyright libuv contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* io_uring based replacement for the epoll loop in linux-core.c.
+ *
+ * Every watcher is armed with a one-shot IORING_OP_POLL_ADD request.  Interest
+ * changes are queued as submission queue entries and handed to the kernel in
+ * the same io_uring_enter() call that waits for completions, instead of one
+ * epoll_ctl() system call per watcher per tick.
+ *
+ * Each armed request is tagged with a token that combines the file descriptor
+ * with a generation number.  The token of the request that is currently armed
+ * for a file descriptor is kept in |tokens|; completions with any other token
+ * are stale (cancelled, superseded or from a closed file) and are dropped.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <time.h>
+
+#define UV__IOU_SQ_ENTRIES 1024
+#define UV__IOU_CQ_ENTRIES 8192
+
+#define uv__load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define uv__store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+struct uv__iou {
+  uint32_t* sqhead;
+  uint32_t* sqtail;
+  uint32_t sqmask;
+  uint32_t* cqhead;
+  uint32_t* cqtail;
+  uint32_t cqmask;
+  struct uv__io_uring_sqe* sqe;
+  struct uv__io_uring_cqe* cqe;
+  void* ring;  /* mmap()'d submission and completion rings. */
+  size_t ringlen;
+  size_t sqelen;
+  int ringfd;
+  uint32_t generation;
+  uint64_t* tokens;  /* Token of the armed poll request per fd, 0 if none. */
+  unsigned int ntokens;
+};
+
+
+static void uv__iou_submit(struct uv__iou* iou) {
+  uint32_t pending;
+
+  pending = *iou->sqtail - uv__load_acquire(iou->sqhead);
+  if (pending == 0)
+    return;
+
+  while (-1 == uv__io_uring_enter(iou->ringfd, pending, 0, 0, NULL, 0))
+    if (errno != EINTR)
+      abort();
+}
+
+
+static struct uv__io_uring_sqe* uv__iou_get_sqe(struct uv__iou* iou) {
+  struct uv__io_uring_sqe* sqe;
+  uint32_t tail;
+
+  tail = *iou->sqtail;
+
+  /* Submission queue is full, hand it to the kernel to make room. */
+  if (tail - uv__load_acquire(iou->sqhead) > iou->sqmask)
+    uv__iou_submit(iou);
+
+  sqe = iou->sqe + (tail & iou->sqmask);
+  memset(sqe, 0, sizeof(*sqe));
+
+  return sqe;
+}
+
+
+static void uv__iou_sqe_commit(struct uv__iou* iou) {
+  uv__store_release(iou->sqtail, *iou->sqtail + 1);
+}
+
+
+static void uv__iou_disarm(struct uv__iou* iou, int fd) {
+  struct uv__io_uring_sqe* sqe;
+
+  if ((unsigned) fd >= iou->ntokens || iou->tokens[fd] == 0)
+    return;
+
+  /* The completion of the cancelled request carries the old token and is
+   * dropped in uv__iou_poll(); the completion of the POLL_REMOVE itself has
+   * token 0 and is dropped too.
+   */
+  sqe = uv__iou_get_sqe(iou);
+  sqe->opcode = UV__IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = iou->tokens[fd];
+  sqe->user_data = 0;
+  uv__iou_sqe_commit(iou);
+
+  iou->tokens[fd] = 0;
+}
+
+
+static void uv__iou_arm(uv_loop_t* loop, struct uv__iou* iou, uv__io_t* w) {
+  struct uv__io_uring_sqe* sqe;
+  uint64_t* tokens;
+  uint32_t events;
+  unsigned int i;
+
+  if ((unsigned) w->fd >= iou->ntokens) {
+    assert(loop->nwatchers > (unsigned) w->fd);
+    tokens = uv__realloc(iou->tokens, loop->nwatchers * sizeof(*tokens));
+    if (tokens == NULL)
+      abort();
+    for (i = iou->ntokens; i < loop->nwatchers; i++)
+      tokens[i] = 0;
+    iou->tokens = tokens;
+    iou->ntokens = loop->nwatchers;
+  }
+
+  /* A request with a different event mask may still be armed, e.g. when the
+   * watcher was stopped and restarted.  Poll requests can't be modified in
+   * place on older kernels so cancel it and arm a new one.
+   */
+  uv__iou_disarm(iou, w->fd);
+
+  if (++iou->generation == 0)
+    iou->generation = 1;
+
+  /* Poll requests are one-shot, edge-triggered watchers are armed like any
+   * other watcher.
+   */
+  events = w->pevents & ~UV__POLLET;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  /* The kernel swaps the halves of poll32_events on big endian systems. */
+  events = (events << 16) | (events >> 16);
+#endif
+
+  sqe = uv__iou_get_sqe(iou);
+  sqe->opcode = UV__IORING_OP_POLL_ADD;
+  sqe->fd = w->fd;
+  sqe->poll32_events = events;
+  sqe->user_data = (uint64_t) iou->generation << 32 | (uint32_t) w->fd;
+  uv__iou_sqe_commit(iou);
+
+  iou->tokens[w->fd] = sqe->user_data;
+  w->events = w->pevents & ~UV__POLLET;
+}
+
+
+int uv__iou_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__io_uring_params params;
+  struct epoll_event e;
+  struct uv__iou* iou;
+  uint32_t* sqarray;
+  uv__io_t* w;
+  size_t ringlen;
+  size_t sqelen;
+  size_t cqlen;
+  unsigned int i;
+  char* ring;
+  void* sqe;
+  int ringfd;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->iou != NULL)
+    return 0;
+
+  memset(&params, 0, sizeof(params));
+  params.flags = UV__IORING_SETUP_CQSIZE;
+  params.cq_entries = UV__IOU_CQ_ENTRIES;
+
+  ringfd = uv__io_uring_setup(UV__IOU_SQ_ENTRIES, &params);
+  if (ringfd == -1)
+    return UV__ERR(errno);
+
+  /* Needs one mmap for both rings (linux 5.4), a completion queue that queues
+   * rather than drops on overflow (5.5) and io_uring_enter() timeouts (5.11).
+   */
+  if (!(params.features & UV__IORING_FEAT_SINGLE_MMAP) ||
+      !(params.features & UV__IORING_FEAT_NODROP) ||
+      !(params.features & UV__IORING_FEAT_EXT_ARG)) {
+    uv__close(ringfd);
+    return UV_ENOSYS;
+  }
+
+  ringlen = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cqlen = params.cq_off.cqes +
+          params.cq_entries * sizeof(struct uv__io_uring_cqe);
+  if (ringlen < cqlen)
+    ringlen = cqlen;
+  sqelen = params.sq_entries * sizeof(struct uv__io_uring_sqe);
+
+  iou = NULL;
+  sqe = MAP_FAILED;
+  ring = mmap(NULL,
+              ringlen,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE,
+              ringfd,
+              UV__IORING_OFF_SQ_RING);
+  if (ring == MAP_FAILED)
+    goto fail;
+
+  sqe = mmap(NULL,
+             sqelen,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             ringfd,
+             UV__IORING_OFF_SQES);
+  if (sqe == MAP_FAILED)
+    goto fail;
+
+  iou = uv__calloc(1, sizeof(*iou));
+  if (iou == NULL)
+    goto fail;
+
+  /* Watch the ring from the epoll set so that uv_backend_fd() keeps working
+   * for embedders: the ring file descriptor is readable when completions are
+   * pending.
+   */
+  memset(&e, 0, sizeof(e));
+  e.events = POLLIN;
+  e.data.fd = -1;
+  if (epoll_ctl(loop->backend_fd, EPOLL_CTL_ADD, ringfd, &e))
+    goto fail;
+
+  iou->sqhead = (uint32_t*) (ring + params.sq_off.head);
+  iou->sqtail = (uint32_t*) (ring + params.sq_off.tail);
+  iou->sqmask = *(uint32_t*) (ring + params.sq_off.ring_mask);
+  iou->cqhead = (uint32_t*) (ring + params.cq_off.head);
+  iou->cqtail = (uint32_t*) (ring + params.cq_off.tail);
+  iou->cqmask = *(uint32_t*) (ring + params.cq_off.ring_mask);
+  iou->sqe = sqe;
+  iou->cqe = (struct uv__io_uring_cqe*) (ring + params.cq_off.cqes);
+  iou->ring = ring;
+  iou->ringlen = ringlen;
+  iou->sqelen = sqelen;
+  iou->ringfd = ringfd;
+
+  /* Slot N of the submission queue always refers to SQE N. */
+  sqarray = (uint32_t*) (ring + params.sq_off.array);
+  for (i = 0; i <= iou->sqmask; i++)
+    sqarray[i] = i;
+
+  lfields->iou = iou;
+
+  /* Move watchers that are already registered with epoll over to the ring. */
+  for (i = 0; i < loop->nwatchers; i++) {
+    w = loop->watchers[i];
+    if (w == NULL)
+      continue;
+
+    if (w->events != 0) {
+      epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e);
+      w->events = 0;
+    }
+
+    if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue))
+      QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+  }
+
+  return 0;
+
+fail:
+  if (sqe != MAP_FAILED)
+    munmap(sqe, sqelen);
+  if (ring != MAP_FAILED)
+    munmap(ring, ringlen);
+  uv__free(iou);
+  uv__close(ringfd);
+
+  return UV_ENOMEM;
+}
+
+
+void uv__iou_delete(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__iou* iou;
+
+  lfields = uv__get_internal_fields(loop);
+  iou = lfields->iou;
+  if (iou == NULL)
+    return;
+
+  /* Closing the ring cancels all armed requests. */
+  munmap(iou->sqe, iou->sqelen);
+  munmap(iou->ring, iou->ringlen);
+  uv__close(iou->ringfd);
+  uv__free(iou->tokens);
+  uv__free(iou);
+  lfields->iou = NULL;
+}
+
+
+void uv__iou_invalidate_fd(uv_loop_t* loop, int fd) {
+  struct uv__iou* iou;
+
+  iou = uv__get_internal_fields(loop)->iou;
+  if ((unsigned) fd >= iou->ntokens || iou->tokens[fd] == 0)
+    return;
+
+  /* An armed poll request holds a reference to the file, which would keep
+   * e.g. a socket from closing.  Cancel it right away rather than on the
+   * next tick because the loop may not tick again.
+   */
+  uv__iou_disarm(iou, fd);
+  uv__iou_submit(iou);
+}
+
+
+void uv__iou_poll(uv_loop_t* loop, int timeout) {
+  struct uv__io_uring_getevents_arg arg;
+  struct uv__kernel_timespec ts;
+  struct uv__io_uring_cqe* cqe;
+  struct uv__iou* iou;
+  sigset_t sigset;
+  uint64_t token;
+  uint64_t base;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t to_submit;
+  unsigned int events;
+  unsigned int flags;
+  uv__io_t* w;
+  QUEUE* q;
+  uint64_t timeout_ns;
+  int real_timeout;
+  int hrtime;
+  int have_signals;
+  int nevents;
+  int ncqes;
+  int count;
+  int res;
+  int fd;
+  int rc;
+
+  if (loop->nfds == 0) {
+    assert(QUEUE_EMPTY(&loop->watcher_queue));
+    return;
+  }
+
+  iou = uv__get_internal_fields(loop)->iou;
+
+  memset(&arg, 0, sizeof(arg));
+  if (loop->flags & UV_LOOP_BLOCK_SIGPROF) {
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGPROF);
+    arg.sigmask = (uint64_t) (uintptr_t) &sigset;
+    arg.sigmask_sz = _NSIG / 8;
+  }
+
+  assert(timeout >= -1);
+  base = loop->time;
+  count = 48; /* Benchmarks suggest this gives the best throughput. */
+  real_timeout = timeout;
+  hrtime = uv__get_internal_fields(loop)->flags & UV__LOOP_HRTIME;
+
+  for (;;) {
+    /* One-shot requests that completed in the previous iteration are back on
+     * the watcher queue, rearm them before going to sleep again.
+     */
+    while (!QUEUE_EMPTY(&loop->watcher_queue)) {
+      q = QUEUE_HEAD(&loop->watcher_queue);
+      QUEUE_REMOVE(q);
+      QUEUE_INIT(q);
+
+      w = QUEUE_DATA(q, uv__io_t, watcher_queue);
+      assert(w->fd >= 0);
+      assert(w->fd < (int) loop->nwatchers);
+
+      /* Watcher that isn't interested in anything right now. */
+      if ((w->pevents & ~UV__POLLET) == 0)
+        continue;
+
+      uv__iou_arm(loop, iou, w);
+    }
+
+    to_submit = *iou->sqtail - uv__load_acquire(iou->sqhead);
+    flags = 0;
+    rc = 0;
+
+    if (timeout != 0) {
+      flags = UV__IORING_ENTER_GETEVENTS | UV__IORING_ENTER_EXT_ARG;
+      arg.ts = 0;
+      if (timeout > 0 && hrtime) {
+        /* A positive timeout comes from the timers, sleep until the first
+         * one is due to the nanosecond.
+         */
+        timeout_ns = uv__next_timeout_ns(loop);
+        ts.tv_sec = timeout_ns / 1000000000;
+        ts.tv_nsec = timeout_ns % 1000000000;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+      } else if (timeout > 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000LL;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+      }
+    }
+
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
+    /* Submit the interest changes and wait for completions in one go. */
+    if (to_submit != 0 || flags != 0)
+      rc = uv__io_uring_enter(iou->ringfd,
+                              to_submit,
+                              flags != 0,
+                              flags,
+                              flags != 0 ? &arg : NULL,
+                              flags != 0 ? sizeof(arg) : 0);
+
+    if (timeout != 0)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
+
+    /* Update loop->time unconditionally. It's tempting to skip the update when
+     * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
+     * operating system didn't reschedule our process while in the syscall.
+     */
+    SAVE_ERRNO(uv__update_time(loop));
+
+    if (rc == -1 && errno != ETIME) {
+      if (errno == EAGAIN || errno == EBUSY) {
+        /* Completion queue backlog, reap it and try again. */
+        timeout = 0;
+      } else if (errno != EINTR) {
+        abort();
+      }
+    }
+
+    have_signals = 0;
+    nevents = 0;
+    ncqes = 0;
+
+    head = *iou->cqhead;
+    tail = uv__load_acquire(iou->cqtail);
+
+    for (; head != tail && ncqes < 1024; head++, ncqes++) {
+      cqe = iou->cqe + (head & iou->cqmask);
+      token = cqe->user_data;
+      res = cqe->res;
+
+      /* Release the slot before running callbacks. */
+      uv__store_release(iou->cqhead, head + 1);
+
+      if (token == 0)
+        continue;  /* POLL_REMOVE completion. */
+
+      fd = (int) (uint32_t) token;
+      if ((unsigned) fd >= iou->ntokens || iou->tokens[fd] != token)
+        continue;  /* Stale, see the comment at the top of this file. */
+
+      iou->tokens[fd] = 0;
+
+      w = loop->watchers[fd];
+      if (w == NULL)
+        continue;  /* Watcher was stopped, nothing left to disarm. */
+
+      /* Stopped but left armed by uv__io_stop(), the request is spent now. */
+      if ((w->pevents & ~UV__POLLET) == 0) {
+        uv__io_remove(loop, w);
+        continue;
+      }
+
+      /* The request is spent.  Rearm on the next iteration if the watcher is
+       * still interested after the callback has run.
+       */
+      w->events = 0;
+      if (QUEUE_EMPTY(&w->watcher_queue))
+        QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+
+      if (res < 0)
+        events = POLLERR;
+      else
+        events = res;
+
+      /* Give users only events they're interested in. */
+      events &= w->pevents | POLLERR | POLLHUP;
+
+      /* Same quirk as in the epoll backend: merge in the read/write events
+       * that the watcher is interested in so that uv__read() and uv__write()
+       * deal with the error or hangup.
+       */
+      if (events == POLLERR || events == POLLHUP)
+        events |= w->pevents & (POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+
+      if (events != 0) {
+        /* Run signal watchers last.  This also affects child process watchers
+         * because those are implemented in terms of signal watchers.
+         */
+        if (w == &loop->signal_io_watcher)
+          have_signals = 1;
+        else
+          w->cb(loop, w, events);
+
+        nevents++;
+      }
+    }
+
+    if (have_signals != 0)
+      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+
+    /* Spent requests are rearmed, every completion that reaches a watcher is
+     * an event.
+     */
+    uv__metrics_add(loop, events, nevents);
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, nevents);
+
+    if (have_signals != 0)
+      return;  /* Event loop should cycle now so don't poll again. */
+
+    if (nevents != 0) {
+      if (ncqes == 1024 && --count != 0) {
+        /* Poll for more events but don't block this time. */
+        timeout = 0;
+        continue;
+      }
+      return;
+    }
+
+    if (timeout == 0)
+      return;
+
+    if (timeout == -1)
+      continue;
+
+    assert(timeout > 0);
+
+    /* The millisecond timeout is rounded up, a nanosecond timer may be due
+     * already.
+     */
+    if (hrtime && uv__next_timeout_ns(loop) == 0)
+      return;
+
+    real_timeout -= (loop->time - base);
+    if (real_timeout <= 0)
+      return;
+
+    timeout = real_timeout;
+  }
+}
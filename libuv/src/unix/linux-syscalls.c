@@ -203,6 +203,19 @@
 # endif
 #endif /* __NR_statx */
 
+/* Same number on all architectures except alpha, which we don't support. */
+#ifndef __NR_io_uring_setup
+# define __NR_io_uring_setup 425
+#endif /* __NR_io_uring_setup */
+
+#ifndef __NR_io_uring_enter
+# define __NR_io_uring_enter 426
+#endif /* __NR_io_uring_enter */
+
+#ifndef __NR_epoll_pwait2
+# define __NR_epoll_pwait2 441
+#endif /* __NR_epoll_pwait2 */
+
 int uv__accept4(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags) {
 #if defined(__i386__)
   unsigned long args[4];
@@ -367,3 +380,42 @@ int uv__statx(int dirfd,
   return errno = ENOSYS, -1;
 #endif
 }
+
+
+int uv__io_uring_setup(unsigned int entries, struct uv__io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+
+int uv__io_uring_enter(int fd,
+                       unsigned int to_submit,
+                       unsigned int min_complete,
+                       unsigned int flags,
+                       const void* arg,
+                       size_t argsz) {
+  /* io_uring_enter() used to take a sigset_t* as its fifth argument but
+   * with IORING_ENTER_EXT_ARG it's a struct io_uring_getevents_arg*.
+   */
+  return syscall(__NR_io_uring_enter,
+                 fd,
+                 to_submit,
+                 min_complete,
+                 flags,
+                 arg,
+                 argsz);
+}
+
+
+int uv__epoll_pwait2(int epfd,
+                     struct epoll_event* events,
+                     int nevents,
+                     const struct uv__kernel_timespec* timeout,
+                     const sigset_t* sigmask) {
+  return syscall(__NR_epoll_pwait2,
+                 epfd,
+                 events,
+                 nevents,
+                 timeout,
+                 sigmask,
+                 (size_t) _NSIG / 8);
+}
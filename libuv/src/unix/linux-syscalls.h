@@ -123,6 +123,90 @@ struct uv__mmsghdr {
   unsigned int msg_len;
 };
 
+/* io_uring flags and opcodes, see <linux/io_uring.h>. */
+#define UV__IORING_SETUP_CQSIZE     0x8
+#define UV__IORING_FEAT_SINGLE_MMAP 0x1
+#define UV__IORING_FEAT_NODROP      0x2
+#define UV__IORING_FEAT_EXT_ARG     0x100
+#define UV__IORING_ENTER_GETEVENTS  0x1
+#define UV__IORING_ENTER_EXT_ARG    0x8
+#define UV__IORING_OFF_SQ_RING      0ULL
+#define UV__IORING_OFF_SQES         0x10000000ULL
+#define UV__IORING_OP_POLL_ADD      6
+#define UV__IORING_OP_POLL_REMOVE   7
+
+struct uv__io_sqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_cqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_uring_params {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t reserved[3];
+  struct uv__io_sqring_offsets sq_off;
+  struct uv__io_cqring_offsets cq_off;
+};
+
+/* The kernel's struct io_uring_sqe is a maze of unions.  This is the subset
+ * of fields that the poll backend needs, laid out with the same offsets.
+ */
+struct uv__io_uring_sqe {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t poll32_events;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct uv__io_uring_cqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+/* struct __kernel_timespec, 64 bits seconds on all architectures. */
+struct uv__kernel_timespec {
+  int64_t tv_sec;
+  long long tv_nsec;
+};
+
+struct uv__io_uring_getevents_arg {
+  uint64_t sigmask;
+  uint32_t sigmask_sz;
+  uint32_t pad;
+  uint64_t ts;
+};
+
 int uv__accept4(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags);
 int uv__eventfd(unsigned int count);
 int uv__eventfd2(unsigned int count, int flags);
@@ -148,5 +232,19 @@ int uv__statx(int dirfd,
               int flags,
               unsigned int mask,
               struct uv__statx* statxbuf);
+int uv__io_uring_setup(unsigned int entries, struct uv__io_uring_params* params);
+int uv__io_uring_enter(int fd,
+                       unsigned int to_submit,
+                       unsigned int min_complete,
+                       unsigned int flags,
+                       const void* arg,
+                       size_t argsz);
+
+struct epoll_event;
+int uv__epoll_pwait2(int epfd,
+                     struct epoll_event* events,
+                     int nevents,
+                     const struct uv__kernel_timespec* timeout,
+                     const sigset_t* sigmask);
 
 #endif /* UV_LINUX_SYSCALL_H_ */
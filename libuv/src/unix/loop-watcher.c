@@ -55,6 +55,7 @@
       h = QUEUE_DATA(q, uv_##name##_t, queue);                                \
       QUEUE_REMOVE(q);                                                        \
       QUEUE_INSERT_TAIL(&loop->name##_handles, q);                            \
+      uv__metrics_callbacks(loop, UV_LOOP_PHASE_##type, 1);                   \
       h->name##_cb(h);                                                        \
     }                                                                         \
   }                                                                           \
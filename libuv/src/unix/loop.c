@@ -27,7 +27,6 @@
 #include "uv.h"
 #include "uv/tree.h"
 #include "internal.h"
-#include "heap-inl.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -35,6 +34,7 @@
 // 主循环初始化
 int uv_loop_init(uv_loop_t *loop)
 {
+  uv__loop_internal_fields_t *lfields;
   void *saved_data;
   int err;
 
@@ -43,14 +43,21 @@ int uv_loop_init(uv_loop_t *loop)
   memset(loop, 0, sizeof(*loop));
   loop->data = saved_data;
 
-  // 堆实现优先队列，定时器试使用堆方式实现(最小堆)
-  heap_init((struct heap *)&loop->timer_heap);
+  lfields = (uv__loop_internal_fields_t *)uv__calloc(1, sizeof(*lfields));
+  if (lfields == NULL)
+    return UV_ENOMEM;
+  loop->internal_fields = lfields;
+
+  err = uv_mutex_init(&lfields->loop_metrics.lock);
+  if (err)
+    goto fail_metrics_mutex_init;
+
   // 初始化队列
-  // work queue，文件操作、getAddrInfo、getNameInfo、用户任务通过线程池运行完毕后均添加到loop->wq队列中
-  QUEUE_INIT(&loop->wq);
+  // 文件操作、getAddrInfo、getNameInfo、用户任务通过线程池运行完毕后均压入 lfields->work_done 无锁栈
   QUEUE_INIT(&loop->idle_handles);
   // 异步IO
   QUEUE_INIT(&loop->async_handles);
+  QUEUE_INIT(&lfields->async_ready);
   QUEUE_INIT(&loop->check_handles);
   QUEUE_INIT(&loop->prepare_handles);
   // 上面的所有初始化的 handle 均会放到该队列中
@@ -96,7 +103,7 @@ int uv_loop_init(uv_loop_t *loop)
   // 平台特定初始化：UV_LOOP_PRIVATE_FIELDS
   err = uv__platform_loop_init(loop);
   if (err)
-    return err;
+    goto fail_platform_init;
 
   // 初始化进程信号 uv_signal_t
   uv__signal_global_once_init();
@@ -118,11 +125,6 @@ int uv_loop_init(uv_loop_t *loop)
   if (err)
     goto fail_rwlock_init;
 
-  // 互斥锁
-  err = uv_mutex_init(&loop->wq_mutex);
-  if (err)
-    goto fail_mutex_init;
-
   // 线程池任务完成后 通知主线程处理
   // 这里注册了一个 IO 观察者，epoll_wait 通过观察用于线程间通信的fd状态
   // 当 fd 状态发生有效变化时，epoll_wait 不在阻塞，从而 IO 观察者内部的回调得到执行
@@ -138,9 +140,6 @@ int uv_loop_init(uv_loop_t *loop)
   return 0;
 
 fail_async_init:
-  uv_mutex_destroy(&loop->wq_mutex);
-
-fail_mutex_init:
   uv_rwlock_destroy(&loop->cloexec_lock);
 
 fail_rwlock_init:
@@ -149,6 +148,13 @@ fail_rwlock_init:
 fail_signal_init:
   uv__platform_loop_delete(loop);
 
+fail_platform_init:
+  uv_mutex_destroy(&lfields->loop_metrics.lock);
+
+fail_metrics_mutex_init:
+  uv__free(lfields);
+  loop->internal_fields = NULL;
+
   return err;
 }
 
@@ -166,6 +172,9 @@ int uv_loop_fork(uv_loop_t *loop)
   if (err)
     return err;
 
+  // fork 时正在压栈的线程在子进程里不存在了
+  uv__get_internal_fields(loop)->work_pushing = 0;
+
   err = uv__signal_loop_fork(loop);
   if (err)
     return err;
@@ -177,11 +186,9 @@ int uv_loop_fork(uv_loop_t *loop)
     if (w == NULL)
       continue;
 
+    w->events = 0; /* Force re-registration in uv__io_poll. */
     if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue))
-    {
-      w->events = 0; /* Force re-registration in uv__io_poll. */
       QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
-    }
   }
 
   return 0;
@@ -205,11 +212,7 @@ void uv__loop_close(uv_loop_t *loop)
     loop->backend_fd = -1;
   }
 
-  uv_mutex_lock(&loop->wq_mutex);
-  assert(QUEUE_EMPTY(&loop->wq) && "thread pool work queue not empty!");
   assert(!uv__has_active_reqs(loop));
-  uv_mutex_unlock(&loop->wq_mutex);
-  uv_mutex_destroy(&loop->wq_mutex);
 
   /*
    * Note that all thread pool stuff is finished at this point and
@@ -230,6 +233,41 @@ void uv__loop_close(uv_loop_t *loop)
 
 int uv__loop_configure(uv_loop_t *loop, uv_loop_option option, va_list ap)
 {
+  if (option == UV_LOOP_USE_IO_URING)
+  {
+#if defined(__linux__)
+    /* Not an error when the kernel lacks io_uring: the loop keeps using
+     * epoll in that case.
+     */
+    uv__iou_init(loop);
+    return 0;
+#else
+    return UV_ENOSYS;
+#endif
+  }
+
+  if (option == UV_LOOP_USE_EDGE_TRIGGERED)
+  {
+#if defined(__linux__)
+    loop->flags |= UV_LOOP_EDGE_TRIGGERED;
+    return 0;
+#else
+    return UV_ENOSYS;
+#endif
+  }
+
+  if (option == UV_LOOP_USE_HRTIME)
+    return uv__timer_use_hrtime(loop);
+
+  if (option == UV_LOOP_BUSY_POLL)
+  {
+#if defined(__linux__)
+    return uv__epoll_busy_poll(loop, va_arg(ap, unsigned int));
+#else
+    return UV_ENOSYS;
+#endif
+  }
+
   if (option != UV_LOOP_BLOCK_SIGNAL)
     return UV_ENOSYS;
 
@@ -875,9 +875,16 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (sizeof(int32_t) == sizeof(long) && timeout >= max_safe_timeout)
       timeout = max_safe_timeout;
 
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     nfds = epoll_wait(loop->ep, events,
                       ARRAY_SIZE(events), timeout);
 
+    if (timeout != 0)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
+
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
      * operating system didn't reschedule our process while in the syscall.
@@ -910,6 +917,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       goto update_timeout;
     }
 
+    uv__metrics_add(loop, events, nfds);
 
     assert(loop->watchers != NULL);
     loop->watchers[loop->nwatchers] = (void*) events;
@@ -954,6 +962,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         pe->events |= w->pevents & (POLLIN | POLLOUT);
 
       if (pe->events != 0) {
+        uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, 1);
         w->cb(loop, w, pe->events);
         nevents++;
       }
@@ -108,6 +108,7 @@ int uv_pipe_listen(uv_pipe_t* handle, int backlog, uv_connection_cb cb) {
 
   handle->connection_cb = cb;
   handle->io_watcher.cb = uv__server_io;
+  uv__io_set_edge_triggered(handle->loop, &handle->io_watcher, 0);
   uv__io_start(handle->loop, &handle->io_watcher, POLLIN);
   return 0;
 }
@@ -45,7 +45,7 @@ static void uv__poll_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
    * to check for both.
    */
   if ((events & POLLERR) && !(events & UV__POLLPRI)) {
-    uv__io_stop(loop, w, POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+    uv__io_close(loop, w);
     uv__handle_stop(handle);
     handle->poll_cb(handle, UV_EBADF, 0);
     return;
@@ -102,11 +102,11 @@ int uv_poll_init_socket(uv_loop_t* loop, uv_poll_t* handle,
 
 
 static void uv__poll_stop(uv_poll_t* handle) {
-  uv__io_stop(handle->loop,
-              &handle->io_watcher,
-              POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+  /* The file descriptor belongs to the user, who may close it right after
+   * this, so really let go of it.
+   */
+  uv__io_close(handle->loop, &handle->io_watcher);
   uv__handle_stop(handle);
-  uv__platform_invalidate_fd(handle->loop, handle->io_watcher.fd);
 }
 
 
@@ -182,6 +182,9 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
    * our caller then we need to loop around and poll() again.
    */
   for (;;) {
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     if (pset != NULL)
       if (pthread_sigmask(SIG_BLOCK, pset, NULL))
         abort();
@@ -190,6 +193,10 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       if (pthread_sigmask(SIG_UNBLOCK, pset, NULL))
         abort();
 
+    if (timeout != 0)
+      SAVE_ERRNO(uv__metrics_update_idle_time(loop));
+    uv__metrics_add(loop, poll_count, 1);
+
     /* Update loop->time unconditionally. It's tempting to skip the update when
      * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
      * operating system didn't reschedule our process while in the syscall.
@@ -223,6 +230,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     /* Initialize a count of events that we care about.  */
     nevents = 0;
     have_signals = 0;
+    uv__metrics_add(loop, events, nfds);
 
     /* Loop over the entire poll fds array looking for returned events.  */
     for (i = 0; i < loop->poll_fds_used; i++) {
@@ -264,6 +272,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     if (have_signals != 0)
       loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
 
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_POLL, nevents);
+
     loop->poll_fds_iterating = 0;
 
     /* Purge invalidated fds from our poll fds array.  */
@@ -413,7 +413,7 @@ static void uv__process_child_init(const uv_process_options_t *options,
 #endif
 
     if (SIG_ERR != signal(n, SIG_DFL))
-      continue;)
+      continue;
 
     uv__write_int(error_fd, UV__ERR(errno));
     _exit(127);
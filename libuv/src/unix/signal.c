@@ -277,7 +277,7 @@ static int uv__signal_loop_once_init(uv_loop_t* loop) {
 
 
 int uv__signal_loop_fork(uv_loop_t* loop) {
-  uv__io_stop(loop, &loop->signal_io_watcher, POLLIN);
+  uv__io_close(loop, &loop->signal_io_watcher);
   uv__close(loop->signal_pipefd[0]);
   uv__close(loop->signal_pipefd[1]);
   loop->signal_pipefd[0] = -1;
@@ -125,6 +125,21 @@ void uv__stream_init(uv_loop_t *loop,
 
   // 注入 io 观察者
   uv__io_init(&stream->io_watcher, uv__stream_io, -1);
+  uv__io_set_edge_triggered(loop,
+                            &stream->io_watcher,
+                            type == UV_TCP || type == UV_NAMED_PIPE);
+}
+
+/* Edge-triggered watchers don't get another event for data that is already
+ * waiting in the socket buffer, schedule a read on the next tick instead.
+ */
+static void uv__stream_edge_feed(uv_stream_t *stream)
+{
+  if (uv__io_edge_triggered(&stream->io_watcher) &&
+      uv__stream_fd(stream) != -1 &&
+      (stream->flags & UV_HANDLE_READING) &&
+      (stream->flags & UV_HANDLE_EDGE_READABLE))
+    uv__io_feed(stream->loop, &stream->io_watcher);
 }
 
 static void uv__stream_osx_interrupt_select(uv_stream_t *stream)
@@ -1184,7 +1199,8 @@ static void uv__read(uv_stream_t *stream)
   stream->flags &= ~UV_HANDLE_READ_PARTIAL;
 
   /* Prevent loop starvation when the data comes in as fast as (or faster than)
-   * we can read it. XXX Need to rearm fd if we switch to edge-triggered I/O.
+   * we can read it. Edge-triggered streams pick up where they left off on the
+   * next tick, see uv__stream_edge_feed().
    */
   count = 32;
 
@@ -1205,6 +1221,7 @@ static void uv__read(uv_stream_t *stream)
       /* User indicates it can't or won't handle the read. */
       // 读数据
       stream->read_cb(stream, UV_ENOBUFS, &buf);
+      uv__stream_edge_feed(stream);
       return;
     }
 
@@ -1241,7 +1258,8 @@ static void uv__read(uv_stream_t *stream)
       /* Error */
       if (errno == EAGAIN || errno == EWOULDBLOCK)
       {
-        /* Wait for the next one. */
+        /* Wait for the next one. Also means there is no EOF to report. */
+        stream->flags &= ~(UV_HANDLE_EDGE_READABLE | UV_HANDLE_EDGE_HANGUP);
         if (stream->flags & UV_HANDLE_READING)
         {
           uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
@@ -1325,14 +1343,24 @@ static void uv__read(uv_stream_t *stream)
 #endif
       stream->read_cb(stream, nread, &buf);
 
-      /* Return if we didn't fill the buffer, there is no more data to read. */
+      /* Return if we didn't fill the buffer, there is no more data to read.
+       * Unless the peer hung up, then keep going so the EOF gets reported now;
+       * an edge-triggered watcher won't be told about it again.
+       */
       if (nread < buflen)
       {
         stream->flags |= UV_HANDLE_READ_PARTIAL;
-        return;
+        if (!(stream->flags & UV_HANDLE_EDGE_HANGUP))
+        {
+          stream->flags &= ~UV_HANDLE_EDGE_READABLE;
+          return;
+        }
       }
     }
   }
+
+  if (count < 0)
+    uv__stream_edge_feed(stream);
 }
 
 #ifdef __clang__
@@ -1385,6 +1413,23 @@ static void uv__stream_io(uv_loop_t *loop, uv__io_t *w, unsigned int events)
          stream->type == UV_TTY);
   assert(!(stream->flags & UV_HANDLE_CLOSING));
 
+  /* Edge-triggered watchers see every event once, whether the handle is
+   * interested or not. Remember readability and hangups for when the user
+   * (re)starts reading; they're also what drives uv__read() from here on,
+   * the write side copes with spurious POLLOUT events.
+   */
+  if (uv__io_edge_triggered(w))
+  {
+    if (events & (POLLIN | POLLERR | POLLHUP | UV__POLLRDHUP))
+      stream->flags |= UV_HANDLE_EDGE_READABLE;
+    if (events & (POLLERR | POLLHUP | UV__POLLRDHUP))
+      stream->flags |= UV_HANDLE_EDGE_HANGUP;
+
+    events &= ~(POLLIN | UV__POLLRDHUP);
+    if (uv__io_active(w, POLLIN) && (stream->flags & UV_HANDLE_EDGE_READABLE))
+      events |= POLLIN;
+  }
+
   // 执行connect???
   if (stream->connect_req)
   {
@@ -1694,6 +1739,7 @@ int uv_read_start(uv_stream_t *stream,
   // 标识stream handle准备好
   uv__handle_start(stream);
   uv__stream_osx_interrupt_select(stream);
+  uv__stream_edge_feed(stream);
 
   return 0;
 }
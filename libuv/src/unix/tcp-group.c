@@ -0,0 +1,384 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Listener groups shard one TCP port across several event loops.
+ *
+ * Every loop runs on its own thread and owns a listen socket bound with
+ * SO_REUSEPORT, so the kernel spreads new connections across the loops
+ * instead of waking all of them for every connection on a shared socket.
+ *
+ * The sockets are bound and put in listen mode one after the other by the
+ * thread that starts the group, which makes the index of a socket in the
+ * kernel's reuseport group equal to the index of its loop.  With
+ * UV_TCP_GROUP_STEER_CPU, a classic BPF program attached to the group maps
+ * the CPU that received the connection to the loop that is pinned to it.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+# include <linux/filter.h>
+# ifndef SO_INCOMING_CPU
+#  define SO_INCOMING_CPU 49
+# endif
+# ifndef SO_ATTACH_REUSEPORT_CBPF
+#  define SO_ATTACH_REUSEPORT_CBPF 51
+# endif
+#endif
+
+#define UV__TCP_GROUP_MAX_CPUS 1024
+
+typedef struct uv__tcp_group_member_s uv__tcp_group_member_t;
+
+struct uv__tcp_group_member_s {
+  uv_loop_t loop;
+  uv_tcp_t server;
+  uv_async_t stop_async;
+  uv_thread_t thread;
+  uv_tcp_group_t* group;
+  unsigned int index;
+  int cpu;  /* -1 when the thread isn't pinned. */
+};
+
+
+/* Fills |cpus| with the CPUs the process may run on, returns how many. */
+static unsigned int uv__tcp_group_cpus(int* cpus, unsigned int size) {
+  unsigned int n;
+  long ncpus;
+#if defined(__linux__)
+  cpu_set_t set;
+  int cpu;
+
+  n = 0;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (cpu = 0; cpu < CPU_SETSIZE && n < size; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus[n++] = cpu;
+
+  if (n > 0)
+    return n;
+#endif
+
+  ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpus < 1)
+    ncpus = 1;
+
+  for (n = 0; n < size && n < (unsigned long) ncpus; n++)
+    cpus[n] = n;
+
+  return n;
+}
+
+
+#if defined(__linux__)
+/* Attach a program to the reuseport group of |fd| that sends a connection to
+ * the socket of the loop that runs on the receiving CPU. Connections that
+ * arrive on other CPUs are spread by CPU number.
+ */
+static int uv__tcp_group_attach_cbpf(int fd,
+                                     uv__tcp_group_member_t* members,
+                                     unsigned int nloops) {
+  struct sock_fprog prog;
+  struct sock_filter* code;
+  unsigned int len;
+  unsigned int i;
+  int err;
+
+  len = 2 * nloops + 3;
+  code = uv__malloc(len * sizeof(*code));
+  if (code == NULL)
+    return UV_ENOMEM;
+
+  code[0] = (struct sock_filter)
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+
+  for (i = 0; i < nloops; i++) {
+    code[1 + 2 * i] = (struct sock_filter)
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, members[i].cpu, 0, 1);
+    code[2 + 2 * i] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, i);
+  }
+
+  code[len - 2] = (struct sock_filter)
+      BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, nloops);
+  code[len - 1] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_A, 0);
+
+  prog.len = len;
+  prog.filter = code;
+
+  err = 0;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)))
+    err = UV__ERR(errno);
+
+  uv__free(code);
+  return err;
+}
+#endif
+
+
+static void uv__tcp_group_stop_cb(uv_async_t* handle) {
+  uv__tcp_group_member_t* m;
+
+  m = container_of(handle, uv__tcp_group_member_t, stop_async);
+  uv_close((uv_handle_t*) &m->server, NULL);
+  uv_close((uv_handle_t*) &m->stop_async, NULL);
+}
+
+
+static void uv__tcp_group_run(void* arg) {
+  uv__tcp_group_member_t* m;
+
+  m = arg;
+
+#if defined(__linux__)
+  if (m->cpu != -1) {
+    cpu_set_t set;
+
+    /* Best effort, the cpuset of the process may have changed since. */
+    CPU_ZERO(&set);
+    CPU_SET(m->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+
+  if (m->group->loop_cb != NULL)
+    m->group->loop_cb(m->group, &m->loop, m->index);
+
+  uv_run(&m->loop, UV_RUN_DEFAULT);
+}
+
+
+static void uv__tcp_group_close_walk_cb(uv_handle_t* handle, void* arg) {
+  if (!uv_is_closing(handle))
+    uv_close(handle, NULL);
+}
+
+
+/* Closes whatever is left on the loop of a member whose thread is gone, or
+ * never started, and releases the loop.
+ */
+static void uv__tcp_group_close_loop(uv__tcp_group_member_t* m) {
+  uv_walk(&m->loop, uv__tcp_group_close_walk_cb, NULL);
+  uv_run(&m->loop, UV_RUN_DEFAULT);
+  if (uv_loop_close(&m->loop))
+    abort();
+}
+
+
+static int uv__tcp_group_member_init(uv__tcp_group_member_t* m,
+                                     const struct sockaddr* addr,
+                                     unsigned int bind_flags,
+                                     int backlog,
+                                     uv_connection_cb cb) {
+  int err;
+
+  err = uv_tcp_init(&m->loop, &m->server);
+  if (err)
+    return err;
+
+  m->server.data = m->group;
+
+  err = uv_tcp_bind(&m->server, addr, bind_flags | UV_TCP_REUSEPORT);
+  if (err)
+    return err;
+
+  err = uv_listen((uv_stream_t*) &m->server, backlog, cb);
+  if (err)
+    return err;
+
+#if defined(__linux__)
+  if (m->cpu != -1)
+    if (setsockopt(m->server.io_watcher.fd,
+                   SOL_SOCKET,
+                   SO_INCOMING_CPU,
+                   &m->cpu,
+                   sizeof(m->cpu)))
+      return UV__ERR(errno);
+#endif
+
+  err = uv_async_init(&m->loop, &m->stop_async, uv__tcp_group_stop_cb);
+  if (err)
+    return err;
+
+  /* Only the listen socket and the user's own handles keep the loop alive. */
+  uv_unref((uv_handle_t*) &m->stop_async);
+
+  return 0;
+}
+
+
+int uv_tcp_group_start(uv_tcp_group_t* group,
+                       const struct sockaddr* addr,
+                       const uv_tcp_group_options_t* options,
+                       uv_connection_cb cb) {
+  uv__tcp_group_member_t* members;
+  uv__tcp_group_member_t* m;
+  unsigned int bind_flags;
+  unsigned int nloops;
+  unsigned int ncpus;
+  unsigned int ninit;
+  unsigned int nrun;
+  unsigned int flags;
+  int* cpus;
+  int backlog;
+  int err;
+
+  if (group == NULL || addr == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  flags = 0;
+  nloops = 0;
+  backlog = SOMAXCONN;
+  bind_flags = 0;
+  group->loop_cb = NULL;
+
+  if (options != NULL) {
+    flags = options->flags;
+    nloops = options->nloops;
+    bind_flags = options->bind_flags;
+    group->loop_cb = options->loop_cb;
+    if (options->backlog > 0)
+      backlog = options->backlog;
+  }
+
+  if (flags & UV_TCP_GROUP_STEER_CPU)
+    flags |= UV_TCP_GROUP_PIN_THREADS;
+
+#if !defined(__linux__)
+  if (flags & UV_TCP_GROUP_PIN_THREADS)
+    return UV_ENOTSUP;
+#endif
+
+  cpus = uv__malloc(UV__TCP_GROUP_MAX_CPUS * sizeof(*cpus));
+  if (cpus == NULL)
+    return UV_ENOMEM;
+
+  ncpus = uv__tcp_group_cpus(cpus, UV__TCP_GROUP_MAX_CPUS);
+  if (nloops == 0)
+    nloops = ncpus;
+
+  /* Steering maps CPUs to loops, a second loop on a CPU would starve. */
+  if ((flags & UV_TCP_GROUP_STEER_CPU) && nloops > ncpus) {
+    uv__free(cpus);
+    return UV_EINVAL;
+  }
+
+  members = uv__calloc(nloops, sizeof(*members));
+  if (members == NULL) {
+    uv__free(cpus);
+    return UV_ENOMEM;
+  }
+
+  group->members = members;
+  group->nloops = nloops;
+  group->connection_cb = cb;
+
+  err = 0;
+  nrun = 0;
+
+  for (ninit = 0; ninit < nloops; ninit++) {
+    m = members + ninit;
+    m->group = group;
+    m->index = ninit;
+    m->cpu = -1;
+    if (flags & UV_TCP_GROUP_PIN_THREADS)
+      m->cpu = cpus[ninit % ncpus];
+
+    err = uv_loop_init(&m->loop);
+    if (err)
+      goto fail;
+
+    err = uv__tcp_group_member_init(m, addr, bind_flags, backlog, cb);
+    if (err) {
+      uv__tcp_group_close_loop(m);
+      goto fail;
+    }
+  }
+
+#if defined(__linux__)
+  if (flags & UV_TCP_GROUP_STEER_CPU) {
+    err = uv__tcp_group_attach_cbpf(members[0].server.io_watcher.fd,
+                                    members,
+                                    nloops);
+    if (err)
+      goto fail;
+  }
+#endif
+
+  for (nrun = 0; nrun < nloops; nrun++) {
+    m = members + nrun;
+    err = uv_thread_create(&m->thread, uv__tcp_group_run, m);
+    if (err)
+      goto fail;
+  }
+
+  uv__free(cpus);
+  return 0;
+
+fail:
+  while (ninit-- > 0) {
+    m = members + ninit;
+    if (ninit < nrun) {
+      uv_async_send(&m->stop_async);
+      if (uv_thread_join(&m->thread))
+        abort();
+    }
+    uv__tcp_group_close_loop(m);
+  }
+
+  uv__free(members);
+  uv__free(cpus);
+  group->members = NULL;
+  group->nloops = 0;
+
+  return err;
+}
+
+
+int uv_tcp_group_stop(uv_tcp_group_t* group) {
+  uv__tcp_group_member_t* members;
+  unsigned int i;
+
+  members = group->members;
+  if (members == NULL)
+    return UV_EINVAL;
+
+  for (i = 0; i < group->nloops; i++)
+    uv_async_send(&members[i].stop_async);
+
+  for (i = 0; i < group->nloops; i++) {
+    if (uv_thread_join(&members[i].thread))
+      abort();
+    uv__tcp_group_close_loop(members + i);
+  }
+
+  uv__free(members);
+  group->members = NULL;
+  group->nloops = 0;
+
+  return 0;
+}
@@ -179,6 +179,29 @@ int uv__tcp_bind(uv_tcp_t *tcp,
   if (setsockopt(tcp->io_watcher.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))
     return UV__ERR(errno);
 
+  // 多个 socket 监听同一端口，由内核分发连接
+  if (flags & UV_TCP_REUSEPORT)
+  {
+#if defined(SO_REUSEPORT_LB)
+    if (setsockopt(tcp->io_watcher.fd,
+                   SOL_SOCKET,
+                   SO_REUSEPORT_LB,
+                   &on,
+                   sizeof(on)))
+      return UV__ERR(errno);
+#elif defined(__linux__) && defined(SO_REUSEPORT)
+    if (setsockopt(tcp->io_watcher.fd,
+                   SOL_SOCKET,
+                   SO_REUSEPORT,
+                   &on,
+                   sizeof(on)))
+      return UV__ERR(errno);
+#else
+    /* Elsewhere SO_REUSEPORT doesn't balance, the last socket gets it all. */
+    return UV_ENOTSUP;
+#endif
+  }
+
 #ifndef __OpenBSD__
 #ifdef IPV6_V6ONLY
   if (addr->sa_family == AF_INET6)
@@ -346,6 +369,87 @@ int uv_tcp_close_reset(uv_tcp_t *handle, uv_close_cb close_cb)
   return 0;
 }
 
+struct uv__tcp_transfer
+{
+  struct uv__work work;
+  uv_tcp_t *handle;
+  uv_tcp_transfer_cb cb;
+  int reading;
+};
+
+// 在目标 loop 的线程上接管 handle
+static void uv__tcp_adopt(struct uv__work *w, int status)
+{
+  struct uv__tcp_transfer *t;
+  uv_tcp_transfer_cb cb;
+  uv_tcp_t *handle;
+  int reading;
+  int err;
+
+  assert(status == 0);
+  t = container_of(w, struct uv__tcp_transfer, work);
+  handle = t->handle;
+  reading = t->reading;
+  cb = t->cb;
+  uv__free(t);
+
+  QUEUE_INSERT_TAIL(&handle->loop->handle_queue, &handle->handle_queue);
+
+  /* Data that arrived in between is still in the socket buffer. */
+  err = 0;
+  if (reading)
+    err = uv_read_start((uv_stream_t *)handle,
+                        handle->alloc_cb,
+                        handle->read_cb);
+
+  cb(handle, err);
+}
+
+// 把连接交给另一个 loop：fd 不变，只是从当前 loop 摘下来，到目标 loop 的线程上再挂上去
+int uv_tcp_transfer(uv_tcp_t *handle, uv_loop_t *loop, uv_tcp_transfer_cb cb)
+{
+  struct uv__tcp_transfer *t;
+
+  if (cb == NULL || uv__is_closing(handle) || uv__stream_fd(handle) == -1)
+    return UV_EINVAL;
+
+  /* Listen sockets have connections of their own in flight. */
+  if (handle->connection_cb != NULL)
+    return UV_EINVAL;
+
+  /* Requests complete on the loop they were made on. */
+  if (handle->connect_req != NULL ||
+      handle->shutdown_req != NULL ||
+      !QUEUE_EMPTY(&handle->write_queue) ||
+      !QUEUE_EMPTY(&handle->write_completed_queue))
+    return UV_EBUSY;
+
+  t = uv__malloc(sizeof(*t));
+  if (t == NULL)
+    return UV_ENOMEM;
+
+  t->handle = handle;
+  t->cb = cb;
+  t->reading = (handle->flags & UV_HANDLE_READING) != 0;
+  handle->flags &= ~UV_HANDLE_READING;
+
+  // 从当前 loop 的 watchers 和内核里摘掉 fd，但不关闭它
+  uv__io_close(handle->loop, &handle->io_watcher);
+  /* An edge-triggered watcher may have been waiting on the old loop's
+   * pending queue, uv__io_feed() on the new loop must see it as unlinked.
+   */
+  QUEUE_INIT(&handle->io_watcher.pending_queue);
+  uv__handle_stop(handle);
+  QUEUE_REMOVE(&handle->handle_queue);
+
+  handle->loop = loop;
+  uv__io_set_edge_triggered(loop, &handle->io_watcher, 1);
+  t->work.done = uv__tcp_adopt;
+  uv__work_post(loop, &t->work);
+
+  return 0;
+}
+
 // 监听 tcp 连接
 // 调用 uv__io_start 绑定需要监听的 fd
 int uv_tcp_listen(uv_tcp_t *tcp, int backlog, uv_connection_cb cb)
@@ -387,6 +491,7 @@ int uv_tcp_listen(uv_tcp_t *tcp, int backlog, uv_connection_cb cb)
   /* Start listening for connections. */
   // connect 事件回调函数
   tcp->io_watcher.cb = uv__server_io;
+  uv__io_set_edge_triggered(tcp->loop, &tcp->io_watcher, 0);
   // 挂载 io watcher，监听 POLLIN 事件
   uv__io_start(tcp->loop, &tcp->io_watcher, POLLIN);
 
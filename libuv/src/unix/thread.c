@@ -31,6 +31,8 @@
 #include <unistd.h>  /* getpagesize() */
 
 #include <limits.h>
+#include <sched.h>
+#include <string.h>
 
 #ifdef __MVS__
 #include <sys/ipc.h>
@@ -213,10 +215,153 @@ int uv_thread_create(uv_thread_t *tid, void (*entry)(void *arg), void *arg) {
   return uv_thread_create_ex(tid, &params, entry, arg);
 }
 
+#if defined(__linux__)
+/* Fills `cpuset` from a uv_cpumask_size() bytes long mask. */
+static int uv__thread_cpuset(cpu_set_t* cpuset,
+                             const char* cpumask,
+                             size_t mask_size) {
+  int i;
+  int n;
+
+  if (mask_size < (size_t) CPU_SETSIZE)
+    return EINVAL;
+
+  CPU_ZERO(cpuset);
+  n = 0;
+  for (i = 0; i < CPU_SETSIZE; i++) {
+    if (cpumask[i]) {
+      CPU_SET(i, cpuset);
+      n++;
+    }
+  }
+
+  return n > 0 ? 0 : EINVAL;
+}
+#endif
+
+
+/* Applied by the new thread to itself before it runs `entry`. Not all of it
+ * can be set through pthread attributes, glibc for example rejects
+ * SCHED_BATCH and SCHED_IDLE there.
+ */
+struct uv__thread_setup {
+  void (*entry)(void* arg);
+  void* arg;
+  const uv_thread_options_t* params;
+  uv_sem_t done;
+  int err;
+};
+
+
+static int uv__thread_set_sched(const uv_thread_options_t* params) {
+  struct sched_param param;
+  int policy;
+
+  switch (params->sched_policy) {
+    case UV_THREAD_SCHED_OTHER:
+      policy = SCHED_OTHER;
+      break;
+#if defined(SCHED_BATCH)
+    case UV_THREAD_SCHED_BATCH:
+      policy = SCHED_BATCH;
+      break;
+#endif
+#if defined(SCHED_IDLE)
+    case UV_THREAD_SCHED_IDLE:
+      policy = SCHED_IDLE;
+      break;
+#endif
+    case UV_THREAD_SCHED_FIFO:
+      policy = SCHED_FIFO;
+      break;
+    case UV_THREAD_SCHED_RR:
+      policy = SCHED_RR;
+      break;
+    default:
+      return ENOTSUP;
+  }
+
+  if (params->sched_priority < sched_get_priority_min(policy) ||
+      params->sched_priority > sched_get_priority_max(policy)) {
+    return EINVAL;
+  }
+
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = params->sched_priority;
+
+  return pthread_setschedparam(pthread_self(), policy, &param);
+}
+
+
+static int uv__thread_set_options(const uv_thread_options_t* params) {
+  char name[16];
+  int err;
+#if defined(__linux__)
+  cpu_set_t cpuset;
+#endif
+
+  if (params->flags & UV_THREAD_HAS_AFFINITY) {
+#if defined(__linux__)
+    err = uv__thread_cpuset(&cpuset, params->cpumask, params->mask_size);
+    if (err)
+      return err;
+
+    err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err)
+      return err;
+#else
+    return ENOTSUP;
+#endif
+  }
+
+  if (params->flags & UV_THREAD_HAS_SCHED) {
+    err = uv__thread_set_sched(params);
+    if (err)
+      return err;
+  }
+
+  /* Best effort, names are limited to 15 characters. */
+  if (params->flags & UV_THREAD_HAS_NAME) {
+    uv__strscpy(name, params->name, sizeof(name));
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), name);
+#elif defined(__APPLE__)
+    pthread_setname_np(name);
+#endif
+  }
+
+  return 0;
+}
+
+
+static void* uv__thread_start(void* arg) {
+  struct uv__thread_setup* setup;
+  void (*entry)(void* arg);
+  int err;
+
+  setup = arg;
+  entry = setup->entry;
+  arg = setup->arg;
+
+  /* `setup` lives on the stack of the creating thread, don't touch it after
+   * posting `done`.
+   */
+  err = uv__thread_set_options(setup->params);
+  setup->err = err;
+  uv_sem_post(&setup->done);
+
+  if (err == 0)
+    entry(arg);
+
+  return NULL;
+}
+
+
 int uv_thread_create_ex(uv_thread_t* tid,
                         const uv_thread_options_t* params,
                         void (*entry)(void *arg),
                         void *arg) {
+  struct uv__thread_setup setup;
   int err;
   pthread_attr_t* attr;
   pthread_attr_t attr_storage;
@@ -255,8 +400,28 @@ int uv_thread_create_ex(uv_thread_t* tid,
       abort();
   }
 
-  f.in = entry;
-  err = pthread_create(tid, attr, f.out, arg);
+  if (params->flags &
+      (UV_THREAD_HAS_AFFINITY | UV_THREAD_HAS_NAME | UV_THREAD_HAS_SCHED)) {
+    setup.entry = entry;
+    setup.arg = arg;
+    setup.params = params;
+    if (uv_sem_init(&setup.done, 0))
+      abort();
+
+    err = pthread_create(tid, attr, uv__thread_start, &setup);
+    if (err == 0) {
+      uv_sem_wait(&setup.done);
+      err = setup.err;
+      /* The thread exits right away without running `entry`. */
+      if (err)
+        pthread_join(*tid, NULL);
+    }
+
+    uv_sem_destroy(&setup.done);
+  } else {
+    f.in = entry;
+    err = pthread_create(tid, attr, f.out, arg);
+  }
 
   if (attr != NULL)
     pthread_attr_destroy(attr);
@@ -279,6 +444,79 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+int uv_cpumask_size(void) {
+#if defined(__linux__)
+  return CPU_SETSIZE;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_thread_setaffinity(uv_thread_t* tid,
+                          char* cpumask,
+                          char* oldmask,
+                          size_t mask_size) {
+#if defined(__linux__)
+  cpu_set_t cpuset;
+  int err;
+
+  err = uv__thread_cpuset(&cpuset, cpumask, mask_size);
+  if (err)
+    return UV__ERR(err);
+
+  if (oldmask != NULL) {
+    err = uv_thread_getaffinity(tid, oldmask, mask_size);
+    if (err)
+      return err;
+  }
+
+  return UV__ERR(pthread_setaffinity_np(*tid, sizeof(cpuset), &cpuset));
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_thread_getaffinity(uv_thread_t* tid, char* cpumask, size_t mask_size) {
+#if defined(__linux__)
+  cpu_set_t cpuset;
+  int err;
+  int i;
+
+  if (mask_size < (size_t) CPU_SETSIZE)
+    return UV_EINVAL;
+
+  CPU_ZERO(&cpuset);
+  err = pthread_getaffinity_np(*tid, sizeof(cpuset), &cpuset);
+  if (err)
+    return UV__ERR(err);
+
+  for (i = 0; i < CPU_SETSIZE; i++)
+    cpumask[i] = !!CPU_ISSET(i, &cpuset);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_thread_getcpu(void) {
+#if defined(__linux__)
+  int cpu;
+
+  cpu = sched_getcpu();
+  if (cpu < 0)
+    return UV__ERR(errno);
+
+  return cpu;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
 #if defined(NDEBUG) || !defined(PTHREAD_MUTEX_ERRORCHECK)
   return UV__ERR(pthread_mutex_init(mutex, NULL));
@@ -44,6 +44,7 @@
 static void uv__udp_run_completed(uv_udp_t* handle);
 static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents);
 static void uv__udp_recvmsg(uv_udp_t* handle);
+static void uv__udp_edge_feed(uv_udp_t* handle);
 static void uv__udp_sendmsg(uv_udp_t* handle);
 static int uv__udp_maybe_deferred_bind(uv_udp_t* handle,
                                        int domain,
@@ -139,6 +140,18 @@ static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
   handle = container_of(w, uv_udp_t, io_watcher);
   assert(handle->type == UV_UDP);
 
+  /* See uv__stream_io(). Errors are queued on the socket and reported by the
+   * next recvmsg() call so treat them like data.
+   */
+  if (uv__io_edge_triggered(w)) {
+    if (revents & (POLLIN | POLLERR | POLLHUP))
+      handle->flags |= UV_HANDLE_EDGE_READABLE;
+
+    revents &= ~POLLIN;
+    if (uv__io_active(w, POLLIN) && (handle->flags & UV_HANDLE_EDGE_READABLE))
+      revents |= POLLIN;
+  }
+
   if (revents & POLLIN)
     uv__udp_recvmsg(handle);
 
@@ -161,7 +174,7 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
   assert(handle->alloc_cb != NULL);
 
   /* Prevent loop starvation when the data comes in as fast as (or faster than)
-   * we can read it. XXX Need to rearm fd if we switch to edge-triggered I/O.
+   * we can read it. Edge-triggered handles continue on the next tick.
    */
   count = 32;
 
@@ -173,6 +186,7 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
     handle->alloc_cb((uv_handle_t*) handle, 64 * 1024, &buf);
     if (buf.base == NULL || buf.len == 0) {
       handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
+      uv__udp_edge_feed(handle);
       return;
     }
     assert(buf.base != NULL);
@@ -187,9 +201,10 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
     while (nread == -1 && errno == EINTR);
 
     if (nread == -1) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        handle->flags &= ~UV_HANDLE_EDGE_READABLE;
         handle->recv_cb(handle, 0, &buf, NULL, 0);
-      else
+      } else
         handle->recv_cb(handle, UV__ERR(errno), &buf, NULL, 0);
     }
     else {
@@ -211,6 +226,20 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
       && count-- > 0
       && handle->io_watcher.fd != -1
       && handle->recv_cb != NULL);
+
+  uv__udp_edge_feed(handle);
+}
+
+
+/* Edge-triggered watchers don't get another event for datagrams that are
+ * already queued, schedule a read on the next tick instead.
+ */
+static void uv__udp_edge_feed(uv_udp_t* handle) {
+  if (uv__io_edge_triggered(&handle->io_watcher) &&
+      handle->io_watcher.fd != -1 &&
+      handle->recv_cb != NULL &&
+      (handle->flags & UV_HANDLE_EDGE_READABLE))
+    uv__io_feed(handle->loop, &handle->io_watcher);
 }
 
 
@@ -779,6 +808,7 @@ int uv_udp_init_ex(uv_loop_t* loop, uv_udp_t* handle, unsigned int flags) {
   handle->send_queue_size = 0;
   handle->send_queue_count = 0;
   uv__io_init(&handle->io_watcher, uv__udp_io, fd);
+  uv__io_set_edge_triggered(loop, &handle->io_watcher, 1);
   QUEUE_INIT(&handle->write_queue);
   QUEUE_INIT(&handle->write_completed_queue);
 
@@ -1118,6 +1148,7 @@ int uv__udp_recv_start(uv_udp_t* handle,
 
   uv__io_start(handle->loop, &handle->io_watcher, POLLIN);
   uv__handle_start(handle);
+  uv__udp_edge_feed(handle);
 
   return 0;
 }
@@ -525,6 +525,136 @@ uint64_t uv_now(const uv_loop_t* loop) {
 }
 
 
+uint64_t uv_metrics_saved_syscalls(const uv_loop_t* loop) {
+  return uv__get_internal_fields(loop)->saved_syscalls;
+}
+
+
+/* Called with loop_metrics->lock held. */
+static uint64_t uv__metrics_idle_time_locked(uv__loop_metrics_t* loop_metrics) {
+  uint64_t idle_time;
+
+  idle_time = loop_metrics->provider_idle_time;
+  /* The loop is blocked right now; count the time so far. */
+  if (loop_metrics->provider_entry_time > 0)
+    idle_time += uv_hrtime() - loop_metrics->provider_entry_time;
+
+  return idle_time;
+}
+
+
+int uv_metrics_info(uv_loop_t* loop, uv_metrics_t* metrics) {
+  uv__loop_metrics_t* loop_metrics;
+
+  if (metrics == NULL)
+    return UV_EINVAL;
+
+  if (!uv__metrics_enabled(loop))
+    return UV_ENOTSUP;
+
+  loop_metrics = &uv__get_internal_fields(loop)->loop_metrics;
+  uv_mutex_lock(&loop_metrics->lock);
+  *metrics = loop_metrics->published;
+  metrics->idle_time = uv__metrics_idle_time_locked(loop_metrics);
+  uv_mutex_unlock(&loop_metrics->lock);
+
+  return 0;
+}
+
+
+uint64_t uv_metrics_idle_time(uv_loop_t* loop) {
+  uv__loop_metrics_t* loop_metrics;
+  uint64_t idle_time;
+
+  if (!uv__metrics_enabled(loop))
+    return 0;
+
+  loop_metrics = &uv__get_internal_fields(loop)->loop_metrics;
+  uv_mutex_lock(&loop_metrics->lock);
+  idle_time = uv__metrics_idle_time_locked(loop_metrics);
+  uv_mutex_unlock(&loop_metrics->lock);
+
+  return idle_time;
+}
+
+
+void uv__metrics_loop_begin(uv_loop_t* loop) {
+  if (uv__metrics_enabled(loop))
+    uv__get_internal_fields(loop)->loop_metrics.phase_start = uv_hrtime();
+}
+
+
+void uv__metrics_phase(uv_loop_t* loop, uv_loop_phase phase) {
+  uv__loop_metrics_t* loop_metrics;
+  uint64_t now;
+
+  if (!uv__metrics_enabled(loop))
+    return;
+
+  loop_metrics = &uv__get_internal_fields(loop)->loop_metrics;
+  now = uv_hrtime();
+  loop_metrics->live.phase_time[phase] += now - loop_metrics->phase_start;
+  loop_metrics->phase_start = now;
+}
+
+
+void uv__metrics_loop_end(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  uv__loop_metrics_t* loop_metrics;
+
+  lfields = uv__get_internal_fields(loop);
+  loop_metrics = &lfields->loop_metrics;
+  loop_metrics->live.loop_count++;
+
+  if (!(lfields->flags & UV__LOOP_METRICS))
+    return;
+
+  loop_metrics->live.saved_syscalls = lfields->saved_syscalls;
+  uv_mutex_lock(&loop_metrics->lock);
+  loop_metrics->published = loop_metrics->live;
+  uv_mutex_unlock(&loop_metrics->lock);
+}
+
+
+void uv__metrics_set_provider_entry_time(uv_loop_t* loop) {
+  uv__loop_metrics_t* loop_metrics;
+  uint64_t now;
+
+  if (!uv__metrics_enabled(loop))
+    return;
+
+  loop_metrics = &uv__get_internal_fields(loop)->loop_metrics;
+  now = uv_hrtime();
+  uv_mutex_lock(&loop_metrics->lock);
+  loop_metrics->provider_entry_time = now;
+  uv_mutex_unlock(&loop_metrics->lock);
+}
+
+
+void uv__metrics_update_idle_time(uv_loop_t* loop) {
+  uv__loop_metrics_t* loop_metrics;
+  uint64_t entry_time;
+  uint64_t exit_time;
+
+  if (!uv__metrics_enabled(loop))
+    return;
+
+  loop_metrics = &uv__get_internal_fields(loop)->loop_metrics;
+
+  /* The metrics may have been enabled while the loop was blocked. */
+  if (loop_metrics->provider_entry_time == 0)
+    return;
+
+  exit_time = uv_hrtime();
+
+  uv_mutex_lock(&loop_metrics->lock);
+  entry_time = loop_metrics->provider_entry_time;
+  loop_metrics->provider_entry_time = 0;
+  loop_metrics->provider_idle_time += exit_time - entry_time;
+  uv_mutex_unlock(&loop_metrics->lock);
+}
+
+
 
 size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs) {
   unsigned int i;
@@ -700,11 +830,24 @@ void uv__fs_readdir_cleanup(uv_fs_t* req) {
 
 
 int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...) {
+  uv__loop_internal_fields_t* lfields;
   va_list ap;
   int err;
 
-  va_start(ap, option);
   /* Any platform-agnostic options should be handled here. */
+  if (option == UV_LOOP_ENABLE_METRICS) {
+    lfields = uv__get_internal_fields(loop);
+    /* May be called from a callback, in the middle of a phase. */
+    if (!(lfields->flags & UV__LOOP_METRICS))
+      lfields->loop_metrics.phase_start = uv_hrtime();
+    lfields->flags |= UV__LOOP_METRICS;
+    return 0;
+  }
+
+  if (option == UV_LOOP_USE_TIMER_WHEEL)
+    return uv__timer_use_wheel(loop);
+
+  va_start(ap, option);
   err = uv__loop_configure(loop, option, ap);
   va_end(ap);
 
@@ -728,6 +871,64 @@ uv_loop_t* uv_default_loop(void) {
 }
 
 
+int uv_loop_defer(uv_loop_t* loop, uv_defer_cb cb, void* arg) {
+  uv__defer_queue_t* queue;
+  uv__defer_entry_t* entries;
+  unsigned int size;
+  unsigned int i;
+
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  queue = &uv__get_internal_fields(loop)->defer_queue;
+
+  if (queue->count == queue->size) {
+    size = queue->size ? 2 * queue->size : 16;
+    if (size < queue->size)
+      return UV_ENOMEM;
+
+    entries = uv__malloc(size * sizeof(*entries));
+    if (entries == NULL)
+      return UV_ENOMEM;
+
+    /* Unwrap the ring while copying, the oldest entry goes first. */
+    for (i = 0; i < queue->count; i++)
+      entries[i] = queue->entries[(queue->head + i) & (queue->size - 1)];
+
+    uv__free(queue->entries);
+    queue->entries = entries;
+    queue->head = 0;
+    queue->size = size;
+  }
+
+  i = (queue->head + queue->count) & (queue->size - 1);
+  queue->entries[i].cb = cb;
+  queue->entries[i].arg = arg;
+  queue->count++;
+
+  return 0;
+}
+
+
+void uv__run_deferred(uv_loop_t* loop) {
+  uv__defer_queue_t* queue;
+  uv__defer_entry_t entry;
+  unsigned int n;
+
+  /* Callbacks deferred from a deferred callback run on the next iteration,
+   * otherwise one that keeps deferring itself would starve the loop.
+   */
+  queue = &uv__get_internal_fields(loop)->defer_queue;
+  for (n = queue->count; n > 0; n--) {
+    entry = queue->entries[queue->head];
+    queue->head = (queue->head + 1) & (queue->size - 1);
+    queue->count--;
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_CHECK, 1);
+    entry.cb(loop, entry.arg);
+  }
+}
+
+
 uv_loop_t* uv_loop_new(void) {
   uv_loop_t* loop;
 
@@ -745,13 +946,17 @@ uv_loop_t* uv_loop_new(void) {
 
 
 int uv_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
   QUEUE* q;
   uv_handle_t* h;
 #ifndef NDEBUG
   void* saved_data;
 #endif
 
-  if (uv__has_active_reqs(loop))
+  if (uv__has_active_reqs(loop) || uv__has_deferred(loop))
+    return UV_EBUSY;
+
+  if (uv__get_internal_fields(loop)->channels != 0)
     return UV_EBUSY;
 
   QUEUE_FOREACH(q, &loop->handle_queue) {
@@ -760,8 +965,18 @@ int uv_loop_close(uv_loop_t* loop) {
       return UV_EBUSY;
   }
 
+  uv__threadpool_loop_close(loop);
   uv__loop_close(loop);
 
+  lfields = uv__get_internal_fields(loop);
+  uv_mutex_destroy(&lfields->loop_metrics.lock);
+  uv__timer_heap_free(&lfields->timer_heap);
+  uv__free(lfields->defer_queue.entries);
+  if (lfields->timer_wheel != NULL)
+    uv__timer_wheel_free(lfields->timer_wheel);
+  uv__free(lfields);
+  loop->internal_fields = NULL;
+
 #ifndef NDEBUG
   saved_data = loop->data;
   memset(loop, -1, sizeof(*loop));
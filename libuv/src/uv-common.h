@@ -93,6 +93,10 @@ enum {
   /* Used by uv_tcp_t and uv_udp_t handles */
   UV_HANDLE_IPV6                        = 0x00400000,
 
+  /* Used by edge-triggered uv_stream_t and uv_udp_t handles. */
+  UV_HANDLE_EDGE_READABLE               = 0x00800000,
+  UV_HANDLE_EDGE_HANGUP                 = 0x40000000,
+
   /* Only used by uv_tcp_t handles. */
   UV_HANDLE_TCP_NODELAY                 = 0x01000000,
   UV_HANDLE_TCP_KEEPALIVE               = 0x02000000,
@@ -123,8 +127,137 @@ enum {
   UV_HANDLE_POLL_SLOW                   = 0x01000000
 };
 
+typedef struct uv__loop_metrics_s uv__loop_metrics_t;
+typedef struct uv__timer_heap_entry_s uv__timer_heap_entry_t;
+typedef struct uv__timer_heap_s uv__timer_heap_t;
+typedef struct uv__timer_wheel_s uv__timer_wheel_t;
+typedef struct uv__defer_entry_s uv__defer_entry_t;
+typedef struct uv__defer_queue_s uv__defer_queue_t;
+typedef struct uv__loop_internal_fields_s uv__loop_internal_fields_t;
+
+/* Bits in uv__loop_internal_fields_t.flags. */
+enum {
+  UV__LOOP_METRICS = 1, /* Set by uv_loop_configure(UV_LOOP_ENABLE_METRICS). */
+  UV__LOOP_HRTIME = 2   /* Set by uv_loop_configure(UV_LOOP_USE_HRTIME). */
+};
+
+struct uv__loop_metrics_s {
+  uv_metrics_t live;             /* Only touched by the loop thread. */
+  uv_metrics_t published;        /* Snapshot for other threads, under lock. */
+  uint64_t phase_start;          /* uv_hrtime() at the start of the phase. */
+  uint64_t provider_entry_time;  /* Non-zero while blocked, under lock. */
+  uint64_t provider_idle_time;   /* Under lock. */
+  uv_mutex_t lock;
+};
+
+/* The sort key of a timer is copied into its heap entry, so sifting never has
+ * to look at the uv_timer_t itself.
+ */
+struct uv__timer_heap_entry_s {
+  uint64_t timeout;
+  uint64_t start_id;
+  uv_timer_t* handle;
+};
+
+struct uv__defer_entry_s {
+  uv_defer_cb cb;
+  void* arg;
+};
+
+/* Ring of uv_loop_defer() callbacks, `size` is a power of two. It only grows,
+ * so once it's big enough queueing a callback doesn't allocate.
+ */
+struct uv__defer_queue_s {
+  uv__defer_entry_t* entries;
+  unsigned int head;
+  unsigned int count;
+  unsigned int size;
+};
+
+/* 4-ary min-heap of the active timers, see timer-heap.c. */
+struct uv__timer_heap_s {
+  uv__timer_heap_entry_t* entries;
+  unsigned int nelts;
+  unsigned int size;
+};
+
+/* Per-loop state that does not fit in uv_loop_t without breaking the ABI.
+ * Allocated by uv_loop_init() and released by uv_loop_close().
+ */
+struct uv__loop_internal_fields_s {
+  unsigned int flags;
+  uint64_t saved_syscalls;  /* Interest updates that didn't need a syscall. */
+  uint64_t time_ns;  /* Loop clock in nanoseconds, with UV__LOOP_HRTIME only. */
+  uv__loop_metrics_t loop_metrics;
+  uv__timer_heap_t timer_heap;
+  uv__timer_wheel_t* timer_wheel;  /* NULL when timers are kept in the heap. */
+  uv__defer_queue_t defer_queue;
+  uv_threadpool_t* threadpools[UV_WORK_KIND_MAX];  /* NULL: the global pool. */
+  unsigned int threadpool_next;  /* Round robin over work stealing threads. */
+  struct uv__work* work_done;  /* Finished work, a lock-free stack. */
+  unsigned int work_pushing;  /* Threads pushing to work_done right now. */
+  uv_work_timing_cb work_timing_cb;  /* See uv_loop_set_work_timing_cb(). */
+  uv_async_t* async_pending;  /* Sent async handles, a lock-free stack. */
+  QUEUE async_ready;  /* Taken from async_pending, loop thread only. */
+  int async_awake;  /* Loop checks async_pending before it blocks again. */
+  int async_sending;  /* Senders that still write to the eventfd. */
+  unsigned int channels;  /* Open channels, their async handle is internal. */
+#if defined(__linux__)
+  struct uv__iou* iou;  /* io_uring poll backend, NULL when using epoll. */
+  unsigned int busy_poll_us;  /* Spin before blocking, see UV_LOOP_BUSY_POLL. */
+#endif
+};
+
+#define uv__get_internal_fields(loop)                                         \
+  ((uv__loop_internal_fields_t*) (loop)->internal_fields)
+
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap);
 
+/* Event loop metrics. The counters are cheap enough to bump unconditionally;
+ * everything that reads the clock or takes the lock only runs once the
+ * UV_LOOP_ENABLE_METRICS option has been set.
+ */
+#define uv__metrics_enabled(loop)                                             \
+  (uv__get_internal_fields(loop)->flags & UV__LOOP_METRICS)
+
+#define uv__metrics_add(loop, field, n)                                       \
+  (uv__get_internal_fields(loop)->loop_metrics.live.field += (n))
+
+#define uv__metrics_callbacks(loop, phase, n)                                 \
+  uv__metrics_add(loop, phase_callbacks[phase], n)
+
+/* Default timer store, see timer-heap.c. */
+int uv__timer_heap_insert(uv__timer_heap_t* heap, uv_timer_t* handle);
+void uv__timer_heap_remove(uv__timer_heap_t* heap, uv_timer_t* handle);
+void uv__timer_heap_free(uv__timer_heap_t* heap);
+
+/* Timing wheel timer store, see timer-wheel.c. */
+int uv__timer_wheel_init(uv__timer_wheel_t** wheel, uint64_t now);
+void uv__timer_wheel_free(uv__timer_wheel_t* w);
+void uv__timer_wheel_insert(uv__timer_wheel_t* w, uv_timer_t* handle);
+void uv__timer_wheel_remove(uv__timer_wheel_t* w, uv_timer_t* handle);
+uv_timer_t* uv__timer_wheel_due(uv__timer_wheel_t* w, uint64_t time);
+uint64_t uv__timer_wheel_min(uv__timer_wheel_t* w);
+int uv__timer_use_wheel(uv_loop_t* loop);
+
+/* With UV__LOOP_HRTIME, timer deadlines are in nanoseconds and the backends
+ * use uv__next_timeout_ns() for the exact poll timeout.
+ */
+int uv__timer_use_hrtime(uv_loop_t* loop);
+uint64_t uv__next_timeout_ns(const uv_loop_t* loop);
+
+/* uv_loop_defer() callbacks run after the check handles. */
+void uv__run_deferred(uv_loop_t* loop);
+
+#define uv__has_deferred(loop)                                                \
+  (uv__get_internal_fields(loop)->defer_queue.count != 0)
+
+void uv__metrics_loop_begin(uv_loop_t* loop);
+void uv__metrics_phase(uv_loop_t* loop, uv_loop_phase phase);
+void uv__metrics_loop_end(uv_loop_t* loop);
+void uv__metrics_set_provider_entry_time(uv_loop_t* loop);
+void uv__metrics_update_idle_time(uv_loop_t* loop);
+
 void uv__loop_close(uv_loop_t* loop);
 
 int uv__tcp_bind(uv_tcp_t* tcp,
@@ -175,12 +308,13 @@ void uv__fs_poll_close(uv_fs_poll_t* handle);
 int uv__getaddrinfo_translate_error(int sys_err);    /* EAI_* error. */
 
 enum uv__work_kind {
-  UV__WORK_CPU,
-  UV__WORK_FAST_IO,
-  UV__WORK_SLOW_IO
+  UV__WORK_CPU = UV_WORK_CPU,
+  UV__WORK_FAST_IO = UV_WORK_FAST_IO,
+  UV__WORK_SLOW_IO = UV_WORK_SLOW_IO
 };
 
 void uv__work_submit(uv_loop_t* loop,
+                     uv_req_t* req,
                      struct uv__work *w,
                      enum uv__work_kind kind,
                      void (*work)(struct uv__work *w),
@@ -188,6 +322,11 @@ void uv__work_submit(uv_loop_t* loop,
 
 void uv__work_done(uv_async_t* handle);
 
+/* Calls w->done on the thread of `loop`, from any thread. */
+void uv__work_post(uv_loop_t* loop, struct uv__work* w);
+
+void uv__threadpool_loop_close(uv_loop_t* loop);
+
 size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs);
 
 int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value);
@@ -33,7 +33,6 @@
 #include "internal.h"
 #include "queue.h"
 #include "handle-inl.h"
-#include "heap-inl.h"
 #include "req-inl.h"
 
 /* uv_once initialization guards */
@@ -222,16 +221,27 @@ static void uv_init(void) {
 
 
 int uv_loop_init(uv_loop_t* loop) {
-  struct heap* timer_heap;
+  uv__loop_internal_fields_t* lfields;
   int err;
 
   /* Initialize libuv itself first */
   uv__once_init();
 
+  lfields = (uv__loop_internal_fields_t*) uv__calloc(1, sizeof(*lfields));
+  if (lfields == NULL)
+    return UV_ENOMEM;
+  loop->internal_fields = lfields;
+
+  err = uv_mutex_init(&lfields->loop_metrics.lock);
+  if (err)
+    goto fail_metrics_mutex_init;
+
   /* Create an I/O completion port */
   loop->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
-  if (loop->iocp == NULL)
-    return uv_translate_sys_error(GetLastError());
+  if (loop->iocp == NULL) {
+    err = uv_translate_sys_error(GetLastError());
+    goto fail_iocp;
+  }
 
   /* To prevent uninitialized memory access, loop->time must be initialized
    * to zero before calling uv_update_time for the first time.
@@ -239,7 +249,6 @@ int uv_loop_init(uv_loop_t* loop) {
   loop->time = 0;
   uv_update_time(loop);
 
-  QUEUE_INIT(&loop->wq);
   QUEUE_INIT(&loop->handle_queue);
   loop->active_reqs.count = 0;
   loop->active_handles = 0;
@@ -248,13 +257,8 @@ int uv_loop_init(uv_loop_t* loop) {
 
   loop->endgame_handles = NULL;
 
-  loop->timer_heap = timer_heap = uv__malloc(sizeof(*timer_heap));
-  if (timer_heap == NULL) {
-    err = UV_ENOMEM;
-    goto fail_timers_alloc;
-  }
-
-  heap_init(timer_heap);
+  /* Timers live in the internal fields, see uv__timer_heap_t. */
+  loop->timer_heap = NULL;
 
   loop->check_handles = NULL;
   loop->prepare_handles = NULL;
@@ -272,10 +276,6 @@ int uv_loop_init(uv_loop_t* loop) {
   loop->timer_counter = 0;
   loop->stop_flag = 0;
 
-  err = uv_mutex_init(&loop->wq_mutex);
-  if (err)
-    goto fail_mutex_init;
-
   err = uv_async_init(loop, &loop->wq_async, uv__work_done);
   if (err)
     goto fail_async_init;
@@ -290,16 +290,16 @@ int uv_loop_init(uv_loop_t* loop) {
   return 0;
 
 fail_async_init:
-  uv_mutex_destroy(&loop->wq_mutex);
-
-fail_mutex_init:
-  uv__free(timer_heap);
-  loop->timer_heap = NULL;
-
-fail_timers_alloc:
   CloseHandle(loop->iocp);
   loop->iocp = INVALID_HANDLE_VALUE;
 
+fail_iocp:
+  uv_mutex_destroy(&lfields->loop_metrics.lock);
+
+fail_metrics_mutex_init:
+  uv__free(lfields);
+  loop->internal_fields = NULL;
+
   return err;
 }
 
@@ -333,14 +333,7 @@ void uv__loop_close(uv_loop_t* loop) {
       closesocket(sock);
   }
 
-  uv_mutex_lock(&loop->wq_mutex);
-  assert(QUEUE_EMPTY(&loop->wq) && "thread pool work queue not empty!");
   assert(!uv__has_active_reqs(loop));
-  uv_mutex_unlock(&loop->wq_mutex);
-  uv_mutex_destroy(&loop->wq_mutex);
-
-  uv__free(loop->timer_heap);
-  loop->timer_heap = NULL;
 
   CloseHandle(loop->iocp);
 }
@@ -377,6 +370,9 @@ int uv_backend_timeout(const uv_loop_t* loop) {
   if (loop->idle_handles)
     return 0;
 
+  if (uv__has_deferred(loop))
+    return 0;
+
   return uv__next_timeout(loop);
 }
 
@@ -392,14 +388,22 @@ static void uv__poll_wine(uv_loop_t* loop, DWORD timeout) {
   timeout_time = loop->time + timeout;
 
   for (repeat = 0; ; repeat++) {
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     GetQueuedCompletionStatus(loop->iocp,
                               &bytes,
                               &key,
                               &overlapped,
                               timeout);
 
+    if (timeout != 0)
+      uv__metrics_update_idle_time(loop);
+    uv__metrics_add(loop, poll_count, 1);
+
     if (overlapped) {
       /* Package was dequeued */
+      uv__metrics_add(loop, events, 1);
       req = uv_overlapped_to_req(overlapped);
       uv_insert_pending_req(loop, req);
 
@@ -444,6 +448,9 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
   timeout_time = loop->time + timeout;
 
   for (repeat = 0; ; repeat++) {
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
     success = GetQueuedCompletionStatusEx(loop->iocp,
                                           overlappeds,
                                           ARRAY_SIZE(overlappeds),
@@ -451,7 +458,12 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
                                           timeout,
                                           FALSE);
 
+    if (timeout != 0)
+      uv__metrics_update_idle_time(loop);
+    uv__metrics_add(loop, poll_count, 1);
+
     if (success) {
+      uv__metrics_add(loop, events, count);
       for (i = 0; i < count; i++) {
         /* Package was dequeued, but see if it is not a empty package
          * meant only to wake us up.
@@ -494,6 +506,7 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
 static int uv__loop_alive(const uv_loop_t* loop) {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
+         uv__has_deferred(loop) ||
          loop->endgame_handles != NULL;
 }
 
@@ -514,11 +527,16 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
 
   while (r != 0 && loop->stop_flag == 0) {
     uv_update_time(loop);
+    uv__metrics_loop_begin(loop);
     uv__run_timers(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_TIMERS);
 
     ran_pending = uv_process_reqs(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_PENDING);
     uv_idle_invoke(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_IDLE);
     uv_prepare_invoke(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_PREPARE);
 
     timeout = 0;
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
@@ -528,10 +546,14 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
       uv__poll(loop, timeout);
     else
       uv__poll_wine(loop, timeout);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_POLL);
 
 
     uv_check_invoke(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_CHECK);
     uv_process_endgames(loop);
+    uv__metrics_phase(loop, UV_LOOP_PHASE_CLOSING);
 
     if (mode == UV_RUN_ONCE) {
       /* UV_RUN_ONCE implies forward progress: at least one callback must have
@@ -543,8 +565,11 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
        * the check.
        */
       uv__run_timers(loop);
+      uv__metrics_phase(loop, UV_LOOP_PHASE_TIMERS);
     }
 
+    uv__metrics_loop_end(loop);
+
     r = uv__loop_alive(loop);
     if (mode == UV_RUN_ONCE || mode == UV_RUN_NOWAIT)
       break;
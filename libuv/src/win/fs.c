@@ -57,6 +57,7 @@
     if (cb != NULL) {                                                         \
       uv__req_register(loop, req);                                            \
       uv__work_submit(loop,                                                   \
+                      (uv_req_t*) req,                                        \
                       &req->work_req,                                         \
                       UV__WORK_FAST_IO,                                       \
                       uv__fs_work,                                            \
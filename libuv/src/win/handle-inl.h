@@ -103,6 +103,7 @@ INLINE static void uv_process_endgames(uv_loop_t* loop) {
     loop->endgame_handles = handle->endgame_next;
 
     handle->flags &= ~UV_HANDLE_ENDGAME_QUEUED;
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_CLOSING, 1);
 
     switch (handle->type) {
       case UV_TCP:
@@ -153,6 +153,7 @@ INLINE static int uv_process_reqs(uv_loop_t* loop) {
   while (next != NULL) {
     req = next;
     next = req->next_req != first ? req->next_req : NULL;
+    uv__metrics_callbacks(loop, UV_LOOP_PHASE_PENDING, 1);
 
     switch (req->type) {
       case UV_READ:
@@ -632,6 +632,12 @@ int uv_tcp_close_reset(uv_tcp_t *handle, uv_close_cb close_cb)
   return 0;
 }
 
+int uv_tcp_transfer(uv_tcp_t *handle, uv_loop_t *loop, uv_tcp_transfer_cb cb)
+{
+  /* A socket stays associated with the completion port of its loop. */
+  return UV_ENOTSUP;
+}
+
 int uv_tcp_listen(uv_tcp_t *handle, int backlog, uv_connection_cb cb)
 {
   unsigned int i, simultaneous_accepts;
@@ -1703,6 +1709,10 @@ int uv__tcp_bind(uv_tcp_t *handle,
 {
   int err;
 
+  /* Windows has no load-balancing equivalent of SO_REUSEPORT. */
+  if (flags & UV_TCP_REUSEPORT)
+    return UV_ENOTSUP;
+
   err = uv_tcp_try_bind(handle, addr, addrlen, flags);
   if (err)
     return uv_translate_sys_error(err);
@@ -1727,3 +1737,17 @@ int uv__tcp_connect(uv_connect_t *req,
 
   return 0;
 }
+
+
+int uv_tcp_group_start(uv_tcp_group_t* group,
+                       const struct sockaddr* addr,
+                       const uv_tcp_group_options_t* options,
+                       uv_connection_cb cb) {
+  /* Needs UV_TCP_REUSEPORT. */
+  return UV_ENOTSUP;
+}
+
+
+int uv_tcp_group_stop(uv_tcp_group_t* group) {
+  return UV_EINVAL;
+}
@@ -117,6 +117,37 @@ int uv_thread_create(uv_thread_t *tid, void (*entry)(void *arg), void *arg) {
   return uv_thread_create_ex(tid, &params, entry, arg);
 }
 
+/* Turns a uv_cpumask_size() bytes long mask into an affinity mask, CPUs
+ * must be a subset of the process affinity mask.
+ */
+static int uv__thread_mask(const char* cpumask,
+                           size_t mask_size,
+                           DWORD_PTR* mask) {
+  DWORD_PTR procmask;
+  DWORD_PTR sysmask;
+  int cpumasksize;
+  int i;
+
+  cpumasksize = uv_cpumask_size();
+  if (mask_size < (size_t) cpumasksize)
+    return UV_EINVAL;
+
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &procmask, &sysmask))
+    return uv_translate_sys_error(GetLastError());
+
+  *mask = 0;
+  for (i = 0; i < cpumasksize; i++) {
+    if (cpumask[i] == 0)
+      continue;
+    if (!(procmask & ((DWORD_PTR) 1 << i)))
+      return UV_EINVAL;
+    *mask |= (DWORD_PTR) 1 << i;
+  }
+
+  return *mask != 0 ? 0 : UV_EINVAL;
+}
+
+
 int uv_thread_create_ex(uv_thread_t* tid,
                         const uv_thread_options_t* params,
                         void (*entry)(void *arg),
@@ -125,9 +156,24 @@ int uv_thread_create_ex(uv_thread_t* tid,
   int err;
   HANDLE thread;
   SYSTEM_INFO sysinfo;
+  DWORD_PTR mask;
   size_t stack_size;
   size_t pagesize;
 
+  /* Scheduling policies are a POSIX concept. */
+  if ((params->flags & UV_THREAD_HAS_SCHED) &&
+      (params->sched_policy != UV_THREAD_SCHED_OTHER ||
+       params->sched_priority != 0)) {
+    return UV_ENOTSUP;
+  }
+
+  mask = 0;
+  if (params->flags & UV_THREAD_HAS_AFFINITY) {
+    err = uv__thread_mask(params->cpumask, params->mask_size, &mask);
+    if (err)
+      return err;
+  }
+
   stack_size =
       params->flags & UV_THREAD_HAS_STACK_SIZE ? params->stack_size : 0;
 
@@ -163,6 +209,9 @@ int uv_thread_create_ex(uv_thread_t* tid,
     err = 0;
     *tid = thread;
     ctx->self = thread;
+    /* The mask is a subset of the process mask, this doesn't fail. */
+    if (mask != 0)
+      SetThreadAffinityMask(thread, mask);
     ResumeThread(thread);
   }
 
@@ -204,6 +253,62 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+int uv_thread_setaffinity(uv_thread_t* tid,
+                          char* cpumask,
+                          char* oldmask,
+                          size_t mask_size) {
+  DWORD_PTR mask;
+  int err;
+  int i;
+
+  err = uv__thread_mask(cpumask, mask_size, &mask);
+  if (err)
+    return err;
+
+  mask = SetThreadAffinityMask(*tid, mask);
+  if (mask == 0)
+    return uv_translate_sys_error(GetLastError());
+
+  if (oldmask != NULL)
+    for (i = 0; i < uv_cpumask_size(); i++)
+      oldmask[i] = (mask >> i) & 1;
+
+  return 0;
+}
+
+
+int uv_thread_getaffinity(uv_thread_t* tid, char* cpumask, size_t mask_size) {
+  DWORD_PTR procmask;
+  DWORD_PTR sysmask;
+  DWORD_PTR mask;
+  int i;
+
+  if (mask_size < (size_t) uv_cpumask_size())
+    return UV_EINVAL;
+
+  /* There is no GetThreadAffinityMask(), setting the mask returns the old
+   * one. Set it to the process mask and back.
+   */
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &procmask, &sysmask))
+    return uv_translate_sys_error(GetLastError());
+
+  mask = SetThreadAffinityMask(*tid, procmask);
+  if (mask == 0)
+    return uv_translate_sys_error(GetLastError());
+  SetThreadAffinityMask(*tid, mask);
+
+  for (i = 0; i < uv_cpumask_size(); i++)
+    cpumask[i] = (mask >> i) & 1;
+
+  return 0;
+}
+
+
+int uv_thread_getcpu(void) {
+  return GetCurrentProcessorNumber();
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
   InitializeCriticalSection(mutex);
   return 0;
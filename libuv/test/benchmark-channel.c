@@ -0,0 +1,171 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_MESSAGES (1000 * 1000)
+
+static uv_channel_t* channel;
+static uv_async_t async;
+static unsigned int nsenders;
+static unsigned int received;
+
+/* What a producer/consumer pair without uv_channel_t looks like: an array
+ * behind a mutex, swapped out by the async callback.
+ */
+static uv_mutex_t mutex;
+static void** pending;
+static unsigned int npending;
+static unsigned int pending_size;
+
+
+static void channel_sender(void* arg) {
+  unsigned int i;
+
+  for (i = 0; i < NUM_MESSAGES / nsenders; i++)
+    ASSERT(0 == uv_channel_send_wait(channel, &received));
+}
+
+
+static void channel_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  received += nmsgs;
+  if (received == NUM_MESSAGES)
+    uv_channel_close(handle, NULL);
+}
+
+
+static void mutex_sender(void* arg) {
+  unsigned int i;
+
+  for (i = 0; i < NUM_MESSAGES / nsenders; i++) {
+    uv_mutex_lock(&mutex);
+    if (npending == pending_size) {
+      pending_size = pending_size ? 2 * pending_size : 256;
+      pending = realloc(pending, pending_size * sizeof(*pending));
+      ASSERT(pending != NULL);
+    }
+    pending[npending++] = &received;
+    uv_mutex_unlock(&mutex);
+    ASSERT(0 == uv_async_send(&async));
+  }
+}
+
+
+static void mutex_async_cb(uv_async_t* handle) {
+  static void** msgs;
+  static unsigned int msgs_size;
+  unsigned int nmsgs;
+  void** tmp;
+
+  uv_mutex_lock(&mutex);
+  tmp = msgs;
+  msgs = pending;
+  pending = tmp;
+  nmsgs = npending;
+  npending = 0;
+  tmp = (void**) (uintptr_t) msgs_size;
+  msgs_size = pending_size;
+  pending_size = (unsigned int) (uintptr_t) tmp;
+  uv_mutex_unlock(&mutex);
+
+  received += nmsgs;
+  if (received == NUM_MESSAGES) {
+    uv_close((uv_handle_t*) handle, NULL);
+    free(msgs);
+    msgs = NULL;
+    msgs_size = 0;
+  }
+}
+
+
+/* capacity < 0 means async + mutex instead of a channel. */
+static double run(int capacity, unsigned int nthreads) {
+  uv_thread_t threads[8];
+  uv_loop_t* loop;
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  ASSERT(nthreads <= ARRAY_SIZE(threads));
+  loop = uv_default_loop();
+  nsenders = nthreads;
+  received = 0;
+
+  if (capacity < 0) {
+    ASSERT(0 == uv_mutex_init(&mutex));
+    ASSERT(0 == uv_async_init(loop, &async, mutex_async_cb));
+  } else {
+    ASSERT(0 == uv_channel_create(loop, &channel, capacity, channel_cb));
+  }
+
+  start = uv_hrtime();
+  for (i = 0; i < nthreads; i++)
+    ASSERT(0 == uv_thread_create(threads + i,
+                                 capacity < 0 ? mutex_sender : channel_sender,
+                                 NULL));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  duration = uv_hrtime() - start;
+
+  for (i = 0; i < nthreads; i++)
+    ASSERT(0 == uv_thread_join(threads + i));
+
+  ASSERT(received == NUM_MESSAGES);
+  if (capacity < 0) {
+    uv_mutex_destroy(&mutex);
+    free(pending);
+    pending = NULL;
+    npending = 0;
+    pending_size = 0;
+  }
+
+  return NUM_MESSAGES / (duration / 1e9);
+}
+
+
+BENCHMARK_IMPL(channel_throughput) {
+  static const unsigned int nthreads[] = { 1, 2, 4, 8 };
+  double mutex_rate;
+  double unbounded;
+  double bounded;
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(nthreads); i++) {
+    mutex_rate = run(-1, nthreads[i]);
+    unbounded = run(0, nthreads[i]);
+    bounded = run(1024, nthreads[i]);
+    fprintf(stderr,
+            "channel: %u senders: async+mutex %.0f/s, "
+            "unbounded %.0f/s, bounded(1024) %.0f/s\n",
+            nthreads[i],
+            mutex_rate,
+            unbounded,
+            bounded);
+    fflush(stderr);
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
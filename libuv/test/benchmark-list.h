@@ -23,6 +23,7 @@ BENCHMARK_DECLARE (sizes)
 BENCHMARK_DECLARE (loop_count)
 BENCHMARK_DECLARE (loop_count_timed)
 BENCHMARK_DECLARE (ping_pongs)
+BENCHMARK_DECLARE (ping_pongs_busy_poll)
 BENCHMARK_DECLARE (tcp_write_batch)
 BENCHMARK_DECLARE (tcp4_pound_100)
 BENCHMARK_DECLARE (tcp4_pound_1000)
@@ -36,6 +37,13 @@ BENCHMARK_DECLARE (pipe_pump1_client)
 BENCHMARK_DECLARE (tcp_multi_accept2)
 BENCHMARK_DECLARE (tcp_multi_accept4)
 BENCHMARK_DECLARE (tcp_multi_accept8)
+BENCHMARK_DECLARE (tcp_multi_accept_single4)
+BENCHMARK_DECLARE (tcp_multi_accept_reuseport2)
+BENCHMARK_DECLARE (tcp_multi_accept_reuseport4)
+BENCHMARK_DECLARE (tcp_multi_accept_reuseport8)
+BENCHMARK_DECLARE (tcp_multi_accept_steer2)
+BENCHMARK_DECLARE (tcp_multi_accept_steer4)
+BENCHMARK_DECLARE (tcp_multi_accept_steer8)
 
 /* Run until X packets have been sent/received. */
 BENCHMARK_DECLARE (udp_pummel_1v1)
@@ -73,8 +81,20 @@ BENCHMARK_DECLARE (async_pummel_4)
 BENCHMARK_DECLARE (async_pummel_8)
 BENCHMARK_DECLARE (spawn)
 BENCHMARK_DECLARE (thread_create)
+BENCHMARK_DECLARE (queue_work_throughput)
+BENCHMARK_DECLARE (queue_work_batch)
+BENCHMARK_DECLARE (queue_work_latency)
+BENCHMARK_DECLARE (channel_throughput)
+BENCHMARK_DECLARE (loop_defer)
+BENCHMARK_DECLARE (tcp_transfer)
 BENCHMARK_DECLARE (million_async)
+BENCHMARK_DECLARE (million_async_one_active)
 BENCHMARK_DECLARE (million_timers)
+BENCHMARK_DECLARE (million_timers_wheel)
+BENCHMARK_DECLARE (timer_churn)
+BENCHMARK_DECLARE (timer_churn_wheel)
+BENCHMARK_DECLARE (timer_keepalive)
+BENCHMARK_DECLARE (timer_keepalive_slack)
 HELPER_DECLARE    (tcp4_blackhole_server)
 HELPER_DECLARE    (tcp_pump_server)
 HELPER_DECLARE    (pipe_pump_server)
@@ -90,6 +110,9 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (ping_pongs)
   BENCHMARK_HELPER (ping_pongs, tcp4_echo_server)
 
+  BENCHMARK_ENTRY  (ping_pongs_busy_poll)
+  BENCHMARK_HELPER (ping_pongs_busy_poll, tcp4_echo_server)
+
   BENCHMARK_ENTRY  (tcp_write_batch)
   BENCHMARK_HELPER (tcp_write_batch, tcp4_blackhole_server)
 
@@ -120,6 +143,13 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_multi_accept2)
   BENCHMARK_ENTRY  (tcp_multi_accept4)
   BENCHMARK_ENTRY  (tcp_multi_accept8)
+  BENCHMARK_ENTRY  (tcp_multi_accept_single4)
+  BENCHMARK_ENTRY  (tcp_multi_accept_reuseport2)
+  BENCHMARK_ENTRY  (tcp_multi_accept_reuseport4)
+  BENCHMARK_ENTRY  (tcp_multi_accept_reuseport8)
+  BENCHMARK_ENTRY  (tcp_multi_accept_steer2)
+  BENCHMARK_ENTRY  (tcp_multi_accept_steer4)
+  BENCHMARK_ENTRY  (tcp_multi_accept_steer8)
 
   BENCHMARK_ENTRY  (udp_pummel_1v1)
   BENCHMARK_ENTRY  (udp_pummel_1v10)
@@ -158,6 +188,18 @@ TASK_LIST_START
 
   BENCHMARK_ENTRY  (spawn)
   BENCHMARK_ENTRY  (thread_create)
+  BENCHMARK_ENTRY  (queue_work_throughput)
+  BENCHMARK_ENTRY  (queue_work_batch)
+  BENCHMARK_ENTRY  (queue_work_latency)
+  BENCHMARK_ENTRY  (channel_throughput)
+  BENCHMARK_ENTRY  (loop_defer)
+  BENCHMARK_ENTRY  (tcp_transfer)
   BENCHMARK_ENTRY  (million_async)
+  BENCHMARK_ENTRY  (million_async_one_active)
   BENCHMARK_ENTRY  (million_timers)
+  BENCHMARK_ENTRY  (million_timers_wheel)
+  BENCHMARK_ENTRY  (timer_churn)
+  BENCHMARK_ENTRY  (timer_churn_wheel)
+  BENCHMARK_ENTRY  (timer_keepalive)
+  BENCHMARK_ENTRY  (timer_keepalive_slack)
 TASK_LIST_END
@@ -0,0 +1,110 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_CALLBACKS (1000 * 1000)
+#define IN_FLIGHT 64
+
+static unsigned int called;
+
+
+static void defer_cb(uv_loop_t* loop, void* arg) {
+  if (++called + IN_FLIGHT <= NUM_CALLBACKS)
+    ASSERT(0 == uv_loop_defer(loop, defer_cb, arg));
+}
+
+
+/* What "run this on the next tick" takes without uv_loop_defer(): an idle
+ * handle per callback, allocated and closed every time.
+ */
+static void idle_cb(uv_idle_t* handle);
+
+
+static void idle_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+
+static void idle_next(uv_loop_t* loop) {
+  uv_idle_t* handle;
+
+  handle = malloc(sizeof(*handle));
+  ASSERT(handle != NULL);
+  ASSERT(0 == uv_idle_init(loop, handle));
+  ASSERT(0 == uv_idle_start(handle, idle_cb));
+}
+
+
+static void idle_cb(uv_idle_t* handle) {
+  if (++called + IN_FLIGHT <= NUM_CALLBACKS)
+    idle_next(handle->loop);
+  uv_close((uv_handle_t*) handle, idle_close_cb);
+}
+
+
+static double run(int use_defer) {
+  uv_loop_t* loop;
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  called = 0;
+  start = uv_hrtime();
+
+  for (i = 0; i < IN_FLIGHT; i++) {
+    if (use_defer)
+      ASSERT(0 == uv_loop_defer(loop, defer_cb, NULL));
+    else
+      idle_next(loop);
+  }
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  duration = uv_hrtime() - start;
+  ASSERT(called == NUM_CALLBACKS);
+
+  return NUM_CALLBACKS / (duration / 1e9);
+}
+
+
+BENCHMARK_IMPL(loop_defer) {
+  double idle;
+  double defer;
+
+  idle = run(0);
+  defer = run(1);
+  fprintf(stderr,
+          "next tick callbacks, %d in flight: idle handles %.0f/s, "
+          "uv_loop_defer %.0f/s\n",
+          IN_FLIGHT,
+          idle,
+          defer);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -110,3 +110,59 @@ BENCHMARK_IMPL(million_async) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static void one_active_cb(uv_async_t* handle) {
+  container->async_events++;
+  if (done == 0)
+    ASSERT(0 == uv_async_send(handle));
+}
+
+
+static void one_active_timer_cb(uv_timer_t* handle) {
+  unsigned i;
+
+  done = 1;
+  for (i = 0; i < ARRAY_SIZE(container->async_handles); i++)
+    uv_close((uv_handle_t*) (container->async_handles + i), NULL);
+
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+/* A million handles but only one of them is ever sent to. Its callback
+ * sends to it again, so every wakeup of the loop handles one send and the
+ * rate shouldn't depend on the number of handles.
+ */
+BENCHMARK_IMPL(million_async_one_active) {
+  uv_timer_t timer_handle;
+  uv_loop_t* loop;
+  int timeout;
+  unsigned i;
+
+  loop = uv_default_loop();
+  timeout = 5000;
+  done = 0;
+
+  container = malloc(sizeof(*container));
+  ASSERT(container != NULL);
+  container->async_events = 0;
+
+  for (i = 0; i < ARRAY_SIZE(container->async_handles); i++)
+    ASSERT(0 == uv_async_init(loop, container->async_handles + i, async_cb));
+  container->async_handles[0].async_cb = one_active_cb;
+
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, one_active_timer_cb, timeout, 0));
+  ASSERT(0 == uv_async_send(container->async_handles));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  printf("%s async events in %.1f seconds (%s/s, 1 of %s handles active)\n",
+          fmt(container->async_events),
+          timeout / 1000.,
+          fmt(container->async_events / (timeout / 1000.)),
+          fmt(ARRAY_SIZE(container->async_handles)));
+  free(container);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
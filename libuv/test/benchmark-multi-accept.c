@@ -22,6 +22,8 @@
 #include "task.h"
 #include "uv.h"
 
+#include <string.h>
+
 #define IPC_PIPE_NAME TEST_PIPENAME
 #define NUM_CONNECTS  (250 * 1000)
 
@@ -103,6 +105,12 @@ static void cl_close_cb(uv_handle_t* handle);
 
 static struct sockaddr_in listen_addr;
 
+/* Accept one connection per wakeup, the UV_TCP_SINGLE_ACCEPT workaround. */
+static int single_accept;
+
+/* Per-loop accept counts of the listener group benchmarks. */
+static unsigned int* group_connects;
+
 
 static void ipc_connection_cb(uv_stream_t* ipc_pipe, int status) {
   struct ipc_server_ctx* sc;
@@ -265,6 +273,9 @@ static void server_cb(void *arg) {
   get_listen_handle(&loop, (uv_stream_t*) &ctx->server_handle);
   uv_sem_post(&ctx->semaphore);
 
+  if (single_accept)
+    uv_tcp_simultaneous_accepts((uv_tcp_t*) &ctx->server_handle, 0);
+
   /* Now start the actual benchmark. */
   ASSERT(0 == uv_listen((uv_stream_t*) &ctx->server_handle,
                         128,
@@ -306,6 +317,28 @@ static void sv_connection_cb(uv_stream_t* server_handle, int status) {
 }
 
 
+static void grp_loop_cb(uv_tcp_group_t* group,
+                        uv_loop_t* loop,
+                        unsigned int index) {
+  loop->data = group_connects + index;
+}
+
+
+static void grp_connection_cb(uv_stream_t* server_handle, int status) {
+  uv_tcp_t* handle;
+
+  ASSERT(status == 0);
+
+  handle = malloc(sizeof(*handle));
+  ASSERT(handle != NULL);
+
+  ASSERT(0 == uv_tcp_init(server_handle->loop, handle));
+  ASSERT(0 == uv_accept(server_handle, (uv_stream_t*) handle));
+  ASSERT(0 == uv_read_start((uv_stream_t*) handle, sv_alloc_cb, sv_read_cb));
+  (*(unsigned int*) server_handle->loop->data)++;
+}
+
+
 static void sv_alloc_cb(uv_handle_t* handle,
                         size_t suggested_size,
                         uv_buf_t* buf) {
@@ -355,34 +388,39 @@ static void cl_close_cb(uv_handle_t* handle) {
 }
 
 
-static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
-  struct server_ctx* servers;
+static void print_results(const char* name,
+                          unsigned int num_servers,
+                          const unsigned int* num_connects,
+                          double time) {
+  unsigned int i;
+
+  printf("%s%u: %.0f accepts/sec (%u total)\n",
+         name,
+         num_servers,
+         NUM_CONNECTS / time,
+         NUM_CONNECTS);
+
+  for (i = 0; i < num_servers; i++) {
+    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%)\n",
+           i,
+           num_connects[i] / time,
+           num_connects[i],
+           num_connects[i] * 100.0 / NUM_CONNECTS);
+  }
+}
+
+
+static double run_clients(unsigned int num_clients) {
   struct client_ctx* clients;
   uv_loop_t* loop;
   uv_tcp_t* handle;
   unsigned int i;
-  double time;
+  uint64_t t;
 
-  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
   loop = uv_default_loop();
-
-  servers = calloc(num_servers, sizeof(servers[0]));
   clients = calloc(num_clients, sizeof(clients[0]));
-  ASSERT(servers != NULL);
   ASSERT(clients != NULL);
 
-  /* We're making the assumption here that from the perspective of the
-   * OS scheduler, threads are functionally equivalent to and interchangeable
-   * with full-blown processes.
-   */
-  for (i = 0; i < num_servers; i++) {
-    struct server_ctx* ctx = servers + i;
-    ASSERT(0 == uv_sem_init(&ctx->semaphore, 0));
-    ASSERT(0 == uv_thread_create(&ctx->thread_id, server_cb, ctx));
-  }
-
-  send_listen_handles(UV_TCP, num_servers, servers);
-
   for (i = 0; i < num_clients; i++) {
     struct client_ctx* ctx = clients + i;
     ctx->num_connects = NUM_CONNECTS / num_clients;
@@ -396,36 +434,104 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
     ASSERT(0 == uv_idle_init(loop, &ctx->idle_handle));
   }
 
-  {
-    uint64_t t = uv_hrtime();
-    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
-    t = uv_hrtime() - t;
-    time = t / 1e9;
+  t = uv_hrtime();
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  t = uv_hrtime() - t;
+
+  free(clients);
+  return t / 1e9;
+}
+
+
+static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
+  struct server_ctx* servers;
+  unsigned int* num_connects;
+  unsigned int i;
+  double time;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
+
+  servers = calloc(num_servers, sizeof(servers[0]));
+  num_connects = calloc(num_servers, sizeof(num_connects[0]));
+  ASSERT(servers != NULL);
+  ASSERT(num_connects != NULL);
+
+  /* We're making the assumption here that from the perspective of the
+   * OS scheduler, threads are functionally equivalent to and interchangeable
+   * with full-blown processes.
+   */
+  for (i = 0; i < num_servers; i++) {
+    struct server_ctx* ctx = servers + i;
+    ASSERT(0 == uv_sem_init(&ctx->semaphore, 0));
+    ASSERT(0 == uv_thread_create(&ctx->thread_id, server_cb, ctx));
   }
 
+  send_listen_handles(UV_TCP, num_servers, servers);
+
+  time = run_clients(num_clients);
+
   for (i = 0; i < num_servers; i++) {
     struct server_ctx* ctx = servers + i;
     uv_async_send(&ctx->async_handle);
     ASSERT(0 == uv_thread_join(&ctx->thread_id));
     uv_sem_destroy(&ctx->semaphore);
+    num_connects[i] = ctx->num_connects;
   }
 
-  printf("accept%u: %.0f accepts/sec (%u total)\n",
-         num_servers,
-         NUM_CONNECTS / time,
-         NUM_CONNECTS);
+  print_results(single_accept ? "single_accept" : "accept",
+                num_servers,
+                num_connects,
+                time);
 
-  for (i = 0; i < num_servers; i++) {
-    struct server_ctx* ctx = servers + i;
-    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%)\n",
-           i,
-           ctx->num_connects / time,
-           ctx->num_connects,
-           ctx->num_connects * 100.0 / NUM_CONNECTS);
+  free(num_connects);
+  free(servers);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+/* Same workload, but every thread has its own SO_REUSEPORT listen socket. */
+static int test_tcp_group(unsigned int flags,
+                          unsigned int num_servers,
+                          unsigned int num_clients) {
+  uv_tcp_group_options_t options;
+  uv_tcp_group_t group;
+  double time;
+  int err;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
+
+  group_connects = calloc(num_servers, sizeof(group_connects[0]));
+  ASSERT(group_connects != NULL);
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nloops = num_servers;
+  options.loop_cb = grp_loop_cb;
+
+  err = uv_tcp_group_start(&group,
+                           (const struct sockaddr*) &listen_addr,
+                           &options,
+                           grp_connection_cb);
+  if (err != 0) {
+    fprintf(stderr, "uv_tcp_group_start: %s\n", uv_strerror(err));
+    free(group_connects);
+    return 0;
   }
 
-  free(clients);
-  free(servers);
+  time = run_clients(num_clients);
+
+  /* Waits for the loops to see the clients hang up. */
+  ASSERT(0 == uv_tcp_group_stop(&group));
+
+  print_results(flags & UV_TCP_GROUP_STEER_CPU ? "steer" : "reuseport",
+                num_servers,
+                group_connects,
+                time);
+
+  free(group_connects);
+  group_connects = NULL;
 
   MAKE_VALGRIND_HAPPY();
   return 0;
@@ -445,3 +551,39 @@ BENCHMARK_IMPL(tcp_multi_accept4) {
 BENCHMARK_IMPL(tcp_multi_accept8) {
   return test_tcp(8, 40);
 }
+
+
+BENCHMARK_IMPL(tcp_multi_accept_single4) {
+  single_accept = 1;
+  return test_tcp(4, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_reuseport2) {
+  return test_tcp_group(0, 2, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_reuseport4) {
+  return test_tcp_group(0, 4, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_reuseport8) {
+  return test_tcp_group(0, 8, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_steer2) {
+  return test_tcp_group(UV_TCP_GROUP_STEER_CPU, 2, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_steer4) {
+  return test_tcp_group(UV_TCP_GROUP_STEER_CPU, 4, 40);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept_steer8) {
+  return test_tcp_group(UV_TCP_GROUP_STEER_CPU, 8, 40);
+}
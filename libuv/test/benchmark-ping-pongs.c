@@ -28,10 +28,14 @@
 /* Run the benchmark for this many ms */
 #define TIME 5000
 
+/* Keep at most this many round trip times for the percentiles. */
+#define MAX_SAMPLES (1000 * 1000)
+
 
 typedef struct {
   int pongs;
   int state;
+  uint64_t ping_time;
   uv_tcp_t tcp;
   uv_connect_t connect_req;
   uv_shutdown_t shutdown_req;
@@ -51,6 +55,8 @@ static buf_t* buf_freelist = NULL;
 static int pinger_shutdown_cb_called;
 static int completed_pingers = 0;
 static int64_t start_time;
+static uint64_t* samples;
+static unsigned int nsamples;
 
 
 static void buf_alloc(uv_handle_t* tcp, size_t size, uv_buf_t* buf) {
@@ -76,11 +82,31 @@ static void buf_free(const uv_buf_t* buf) {
 }
 
 
+static int sample_cmp(const void* a, const void* b) {
+  uint64_t x;
+  uint64_t y;
+
+  x = *(const uint64_t*) a;
+  y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+
+static double percentile(unsigned int p) {
+  return samples[(uint64_t) (nsamples - 1) * p / 100] / 1e3;
+}
+
+
 static void pinger_close_cb(uv_handle_t* handle) {
   pinger_t* pinger;
 
   pinger = (pinger_t*)handle->data;
-  fprintf(stderr, "ping_pongs: %d roundtrips/s\n", (1000 * pinger->pongs) / TIME);
+  qsort(samples, nsamples, sizeof(samples[0]), sample_cmp);
+  fprintf(stderr,
+          "ping_pongs: %d roundtrips/s, p50 %.1f us, p99 %.1f us\n",
+          (1000 * pinger->pongs) / TIME,
+          percentile(50),
+          percentile(99));
   fflush(stderr);
 
   free(pinger);
@@ -101,6 +127,7 @@ static void pinger_write_ping(pinger_t* pinger) {
   uv_buf_t buf;
 
   buf = uv_buf_init(PING, sizeof(PING) - 1);
+  pinger->ping_time = uv_hrtime();
 
   req = malloc(sizeof *req);
   if (uv_write(req, (uv_stream_t*) &pinger->tcp, &buf, 1, pinger_write_cb)) {
@@ -148,6 +175,8 @@ static void pinger_read_cb(uv_stream_t* tcp,
     pinger->state = (pinger->state + 1) % (sizeof(PING) - 1);
     if (pinger->state == 0) {
       pinger->pongs++;
+      if (nsamples < MAX_SAMPLES)
+        samples[nsamples++] = uv_hrtime() - pinger->ping_time;
       if (uv_now(loop) - start_time > TIME) {
         uv_shutdown(&pinger->shutdown_req,
                     (uv_stream_t*) tcp,
@@ -206,16 +235,39 @@ static void pinger_new(void) {
 }
 
 
-BENCHMARK_IMPL(ping_pongs) {
+static int ping_pongs(unsigned int busy_poll_us) {
   loop = uv_default_loop();
 
+  if (busy_poll_us != 0) {
+    if (uv_loop_configure(loop, UV_LOOP_BUSY_POLL, busy_poll_us)) {
+      fprintf(stderr, "ping_pongs: busy polling is not supported\n");
+      fflush(stderr);
+      return 0;
+    }
+  }
+
+  samples = malloc(MAX_SAMPLES * sizeof(samples[0]));
+  ASSERT(samples != NULL);
+  nsamples = 0;
+
   start_time = uv_now(loop);
 
   pinger_new();
   uv_run(loop, UV_RUN_DEFAULT);
 
   ASSERT(completed_pingers == 1);
+  free(samples);
 
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+BENCHMARK_IMPL(ping_pongs) {
+  return ping_pongs(0);
+}
+
+
+BENCHMARK_IMPL(ping_pongs_busy_poll) {
+  return ping_pongs(50);
+}
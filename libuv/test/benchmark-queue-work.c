@@ -0,0 +1,293 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_WORK (200 * 1000)
+#define IN_FLIGHT 4096
+
+static uv_work_t reqs[IN_FLIGHT];
+static unsigned int submitted;
+static unsigned int completed;
+
+
+static void work_cb(uv_work_t* req) {
+  /* Small items, so the cost of the queue dominates. */
+}
+
+
+static void after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  completed++;
+
+  if (submitted < NUM_WORK) {
+    submitted++;
+    ASSERT(0 == uv_queue_work(req->loop, req, work_cb, after_work_cb));
+  }
+}
+
+
+static double run(unsigned int flags, unsigned int nthreads) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_loop_t loop;
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nthreads = nthreads;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_set_threadpool(&loop, UV_WORK_CPU, &pool));
+
+  submitted = 0;
+  completed = 0;
+  start = uv_hrtime();
+
+  for (i = 0; i < IN_FLIGHT; i++) {
+    submitted++;
+    ASSERT(0 == uv_queue_work(&loop, reqs + i, work_cb, after_work_cb));
+  }
+
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  duration = uv_hrtime() - start;
+  ASSERT(completed == NUM_WORK);
+
+  ASSERT(0 == uv_loop_close(&loop));
+  ASSERT(0 == uv_threadpool_close(&pool));
+
+  return NUM_WORK / (duration / 1e9);
+}
+
+
+BENCHMARK_IMPL(queue_work_throughput) {
+  static const unsigned int nthreads[] = { 1, 2, 4, 8, 16, 32 };
+  double shared;
+  double stealing;
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(nthreads); i++) {
+    shared = run(0, nthreads[i]);
+    stealing = run(UV_THREADPOOL_WORK_STEALING, nthreads[i]);
+    fprintf(stderr,
+            "queue_work: %2u threads: shared queue %.0f/s, "
+            "work stealing %.0f/s\n",
+            nthreads[i],
+            shared,
+            stealing);
+    fflush(stderr);
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_work_t* batch_reqs[IN_FLIGHT];
+static uv_work_batch_t batch;
+
+
+static void batch_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  completed++;
+}
+
+
+static void fan_out(uv_loop_t* loop, int use_batch) {
+  unsigned int i;
+
+  submitted += IN_FLIGHT;
+  if (use_batch) {
+    ASSERT(0 == uv_queue_work_batch(loop,
+                                    batch_reqs,
+                                    IN_FLIGHT,
+                                    NULL,
+                                    work_cb,
+                                    batch_after_work_cb,
+                                    &batch,
+                                    NULL));
+    return;
+  }
+
+  for (i = 0; i < IN_FLIGHT; i++)
+    ASSERT(0 == uv_queue_work(loop, reqs + i, work_cb, batch_after_work_cb));
+}
+
+
+/* Submits IN_FLIGHT items at a time and waits for all of them, like a job
+ * that fans out over its input.
+ */
+static double run_fan_out(unsigned int nthreads, int use_batch) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_loop_t loop;
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  memset(&options, 0, sizeof(options));
+  options.nthreads = nthreads;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_set_threadpool(&loop, UV_WORK_CPU, &pool));
+
+  for (i = 0; i < IN_FLIGHT; i++)
+    batch_reqs[i] = reqs + i;
+
+  submitted = 0;
+  completed = 0;
+  start = uv_hrtime();
+
+  while (submitted < NUM_WORK) {
+    fan_out(&loop, use_batch);
+    ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  }
+
+  duration = uv_hrtime() - start;
+  ASSERT(completed == submitted);
+
+  ASSERT(0 == uv_loop_close(&loop));
+  ASSERT(0 == uv_threadpool_close(&pool));
+
+  return completed / (duration / 1e9);
+}
+
+
+BENCHMARK_IMPL(queue_work_batch) {
+  static const unsigned int nthreads[] = { 1, 4, 16 };
+  double single;
+  double batched;
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(nthreads); i++) {
+    single = run_fan_out(nthreads[i], 0);
+    batched = run_fan_out(nthreads[i], 1);
+    fprintf(stderr,
+            "queue_work: %2u threads, fan out of %u: "
+            "one by one %.0f/s, batch %.0f/s\n",
+            nthreads[i],
+            IN_FLIGHT,
+            single,
+            batched);
+    fflush(stderr);
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define NUM_ROUND_TRIPS (20 * 1000)
+
+static uint64_t round_trip_start;
+static uint64_t round_trip_max;
+
+
+static void round_trip_after_work_cb(uv_work_t* req, int status) {
+  uint64_t t;
+
+  ASSERT(status == 0);
+  completed++;
+
+  t = uv_hrtime() - round_trip_start;
+  if (t > round_trip_max)
+    round_trip_max = t;
+
+  if (completed < NUM_ROUND_TRIPS) {
+    round_trip_start = uv_hrtime();
+    ASSERT(0 == uv_queue_work(req->loop, req, work_cb,
+                              round_trip_after_work_cb));
+  }
+}
+
+
+/* One item in flight at a time, so every item finds the threads idle and
+ * the time is dominated by waking a thread and waking the loop again.
+ */
+static double run_round_trips(unsigned int flags, unsigned int nthreads) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_loop_t loop;
+  uint64_t start;
+  uint64_t duration;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nthreads = nthreads;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_loop_set_threadpool(&loop, UV_WORK_CPU, &pool));
+
+  completed = 0;
+  round_trip_max = 0;
+  start = uv_hrtime();
+  round_trip_start = start;
+  ASSERT(0 == uv_queue_work(&loop, reqs, work_cb, round_trip_after_work_cb));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  duration = uv_hrtime() - start;
+  ASSERT(completed == NUM_ROUND_TRIPS);
+
+  ASSERT(0 == uv_loop_close(&loop));
+  ASSERT(0 == uv_threadpool_close(&pool));
+
+  return duration / 1e3 / NUM_ROUND_TRIPS;
+}
+
+
+BENCHMARK_IMPL(queue_work_latency) {
+  static const unsigned int flags[] = {
+    0,
+    UV_THREADPOOL_SPIN,
+    UV_THREADPOOL_WORK_STEALING,
+    UV_THREADPOOL_WORK_STEALING | UV_THREADPOOL_SPIN
+  };
+  static const unsigned int nthreads[] = { 1, 4 };
+  double mean;
+  unsigned int i;
+  unsigned int j;
+
+  for (i = 0; i < ARRAY_SIZE(nthreads); i++) {
+    for (j = 0; j < ARRAY_SIZE(flags); j++) {
+      mean = run_round_trips(flags[j], nthreads[i]);
+      fprintf(stderr,
+              "queue_work: %u threads, %s%s: "
+              "round trip %.1f us mean, %.1f us max\n",
+              nthreads[i],
+              flags[j] & UV_THREADPOOL_WORK_STEALING ? "work stealing" :
+                                                       "shared queue",
+              flags[j] & UV_THREADPOOL_SPIN ? ", spinning" : "",
+              mean,
+              round_trip_max / 1e3);
+      fflush(stderr);
+    }
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,255 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+
+#include <sys/socket.h>
+
+#define NUM_HANDOFFS 20000
+
+/* One connection is handed back and forth between two loops, either with
+ * uv_tcp_transfer() or the way it's done without it: uv_write2() over an
+ * IPC pipe, then uv_accept() on the other end.
+ */
+struct side {
+  uv_loop_t* loop;
+  uv_async_t stop;
+  uv_pipe_t ipc;
+  struct side* peer;
+};
+
+static struct side sides[2];
+static uv_loop_t worker_loop;
+static unsigned int handoffs;
+static int use_ipc;
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t* conn;
+static uv_connect_t connect_req;
+
+
+static void free_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+
+static void stop_cb(uv_async_t* handle) {
+  struct side* side;
+
+  side = container_of(handle, struct side, stop);
+  uv_close((uv_handle_t*) &side->stop, NULL);
+  if (use_ipc)
+    uv_close((uv_handle_t*) &side->ipc, NULL);
+}
+
+
+static void finish(uv_tcp_t* handle) {
+  uv_close((uv_handle_t*) handle, free_close_cb);
+  ASSERT(0 == uv_async_send(&sides[0].stop));
+  ASSERT(0 == uv_async_send(&sides[1].stop));
+}
+
+
+static void transfer_cb(uv_tcp_t* handle, int status) {
+  struct side* side;
+
+  ASSERT(status == 0);
+  if (++handoffs == NUM_HANDOFFS) {
+    finish(handle);
+    return;
+  }
+
+  side = handle->loop == sides[0].loop ? &sides[0] : &sides[1];
+  ASSERT(0 == uv_tcp_transfer(handle, side->peer->loop, transfer_cb));
+}
+
+
+static void ipc_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  /* The other side has its own copy of the fd now. */
+  uv_close((uv_handle_t*) req->data, free_close_cb);
+  free(req);
+}
+
+
+static void ipc_send(struct side* side, uv_tcp_t* handle) {
+  uv_write_t* req;
+  uv_buf_t buf;
+
+  req = malloc(sizeof(*req));
+  ASSERT(req != NULL);
+  req->data = handle;
+  buf = uv_buf_init(".", 1);
+  ASSERT(0 == uv_write2(req,
+                        (uv_stream_t*) &side->ipc,
+                        &buf,
+                        1,
+                        (uv_stream_t*) handle,
+                        ipc_write_cb));
+}
+
+
+static void ipc_alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void ipc_read_cb(uv_stream_t* stream,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  struct side* side;
+  uv_tcp_t* handle;
+
+  if (nread == UV_EOF || nread == 0)
+    return;
+
+  ASSERT(nread > 0);
+  side = container_of(stream, struct side, ipc);
+
+  while (uv_pipe_pending_count(&side->ipc) > 0) {
+    ASSERT(UV_TCP == uv_pipe_pending_type(&side->ipc));
+    handle = malloc(sizeof(*handle));
+    ASSERT(handle != NULL);
+    ASSERT(0 == uv_tcp_init(side->loop, handle));
+    ASSERT(0 == uv_accept(stream, (uv_stream_t*) handle));
+
+    if (++handoffs == NUM_HANDOFFS)
+      finish(handle);
+    else
+      ipc_send(side, handle);
+  }
+}
+
+
+static void worker(void* arg) {
+  ASSERT(0 == uv_run(&worker_loop, UV_RUN_DEFAULT));
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  conn = malloc(sizeof(*conn));
+  ASSERT(conn != NULL);
+  ASSERT(0 == uv_tcp_init(stream->loop, conn));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) stream, NULL);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static double run(int ipc) {
+  struct sockaddr_in addr;
+  uv_thread_t thread;
+  int fds[2];
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  use_ipc = ipc;
+  handoffs = 0;
+  sides[0].loop = uv_default_loop();
+  sides[1].loop = &worker_loop;
+  sides[0].peer = &sides[1];
+  sides[1].peer = &sides[0];
+  ASSERT(0 == uv_loop_init(&worker_loop));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(sides[0].loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT(0 == uv_tcp_init(sides[0].loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+  ASSERT(0 == uv_run(sides[0].loop, UV_RUN_DEFAULT));
+
+  if (ipc)
+    ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  for (i = 0; i < 2; i++) {
+    ASSERT(0 == uv_async_init(sides[i].loop, &sides[i].stop, stop_cb));
+    if (ipc) {
+      ASSERT(0 == uv_pipe_init(sides[i].loop, &sides[i].ipc, 1));
+      ASSERT(0 == uv_pipe_open(&sides[i].ipc, fds[i]));
+      ASSERT(0 == uv_read_start((uv_stream_t*) &sides[i].ipc,
+                                ipc_alloc_cb,
+                                ipc_read_cb));
+    }
+  }
+
+  ASSERT(0 == uv_thread_create(&thread, worker, NULL));
+  start = uv_hrtime();
+
+  if (ipc)
+    ipc_send(&sides[0], conn);
+  else
+    ASSERT(0 == uv_tcp_transfer(conn, &worker_loop, transfer_cb));
+
+  ASSERT(0 == uv_run(sides[0].loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&thread));
+  duration = uv_hrtime() - start;
+  ASSERT(handoffs == NUM_HANDOFFS);
+
+  uv_close((uv_handle_t*) &client, NULL);
+  ASSERT(0 == uv_run(sides[0].loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_close(&worker_loop));
+
+  return NUM_HANDOFFS / (duration / 1e9);
+}
+
+#endif
+
+
+BENCHMARK_IMPL(tcp_transfer) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_tcp_transfer() isn't supported on Windows.");
+#else
+  double ipc;
+  double transfer;
+
+  ipc = run(1);
+  transfer = run(0);
+  fprintf(stderr,
+          "tcp handoffs between two loops: uv_write2 over IPC %.0f/s, "
+          "uv_tcp_transfer %.0f/s\n",
+          ipc,
+          transfer);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
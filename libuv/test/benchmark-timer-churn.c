@@ -0,0 +1,107 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Timers that are restarted or stopped long before they expire, the way
+ * network code uses them for idle and request timeouts.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#define NUM_TIMERS (1000 * 1000)
+#define NUM_ROUNDS 10
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "timer_cb should not have been called");
+}
+
+
+static int timer_churn(int use_wheel) {
+  uv_timer_t* timers;
+  uv_loop_t* loop;
+  uint64_t before;
+  uint64_t after;
+  uint64_t ops;
+  int round;
+  int i;
+
+  timers = malloc(NUM_TIMERS * sizeof(timers[0]));
+  ASSERT(timers != NULL);
+
+  loop = uv_default_loop();
+  if (use_wheel)
+    ASSERT(0 == uv_loop_configure(loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  for (i = 0; i < NUM_TIMERS; i++) {
+    ASSERT(0 == uv_timer_init(loop, timers + i));
+    ASSERT(0 == uv_timer_start(timers + i, timer_cb, 60000 + i % 1000, 0));
+  }
+
+  ops = 0;
+  before = uv_hrtime();
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    uv_update_time(loop);
+
+    /* Push every timer back, then stop and restart every other one. */
+    for (i = 0; i < NUM_TIMERS; i++)
+      ASSERT(0 == uv_timer_start(timers + i, timer_cb, 60000 + i % 1000, 0));
+
+    for (i = 0; i < NUM_TIMERS; i += 2)
+      ASSERT(0 == uv_timer_stop(timers + i));
+
+    for (i = 0; i < NUM_TIMERS; i += 2)
+      ASSERT(0 == uv_timer_start(timers + i, timer_cb, 30000 + i % 1000, 0));
+
+    ops += NUM_TIMERS + NUM_TIMERS / 2 * 2;
+
+    /* Let the loop compute its poll timeout with the timers in place. */
+    ASSERT(0 != uv_run(loop, UV_RUN_NOWAIT));
+  }
+
+  after = uv_hrtime();
+
+  for (i = 0; i < NUM_TIMERS; i++)
+    uv_close((uv_handle_t*) (timers + i), NULL);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  free(timers);
+
+  fprintf(stderr,
+          "%s: %.0f start/stop ops/s\n",
+          use_wheel ? "timer_churn_wheel" : "timer_churn",
+          ops / ((after - before) / 1e9));
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(timer_churn) {
+  return timer_churn(0);
+}
+
+
+BENCHMARK_IMPL(timer_churn_wheel) {
+  return timer_churn(1);
+}
@@ -0,0 +1,106 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Many repeating timers with staggered deadlines, the way keepalive timers
+ * of idle connections look.  Reports how often the loop woke up.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#define NUM_TIMERS (10 * 1000)
+#define INTERVAL 100
+#define DURATION 3000
+
+static uv_timer_t timers[NUM_TIMERS];
+static uv_timer_t stop_timer;
+static unsigned int timer_cb_called;
+
+
+static void timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+}
+
+
+static void stop_cb(uv_timer_t* handle) {
+  int i;
+
+  for (i = 0; i < NUM_TIMERS; i++)
+    uv_close((uv_handle_t*) (timers + i), NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static int timer_keepalive(uint64_t slack) {
+  uv_metrics_t metrics;
+  uv_rusage_t before;
+  uv_rusage_t after;
+  uv_loop_t* loop;
+  double cpu;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_ENABLE_METRICS));
+
+  for (i = 0; i < NUM_TIMERS; i++) {
+    ASSERT(0 == uv_timer_init(loop, timers + i));
+    uv_timer_set_slack(timers + i, slack);
+    ASSERT(0 == uv_timer_start(timers + i,
+                               timer_cb,
+                               i % INTERVAL + 1,
+                               INTERVAL));
+  }
+
+  ASSERT(0 == uv_timer_init(loop, &stop_timer));
+  ASSERT(0 == uv_timer_start(&stop_timer, stop_cb, DURATION, 0));
+
+  ASSERT(0 == uv_getrusage(&before));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_getrusage(&after));
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+
+  cpu = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) +
+        (after.ru_stime.tv_sec - before.ru_stime.tv_sec) +
+        (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1e6 +
+        (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1e6;
+
+  fprintf(stderr,
+          "timer_keepalive, slack %u ms: %u callbacks, %llu wakeups, "
+          "%.3f seconds cpu\n",
+          (unsigned int) slack,
+          timer_cb_called,
+          (unsigned long long) metrics.poll_count,
+          cpu);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(timer_keepalive) {
+  return timer_keepalive(0);
+}
+
+
+BENCHMARK_IMPL(timer_keepalive_slack) {
+  return timer_keepalive(INTERVAL / 2);
+}
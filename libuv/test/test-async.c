@@ -24,6 +24,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifndef _WIN32
+# include <poll.h>
+#endif
+
 static uv_thread_t thread;
 static uv_mutex_t mutex;
 
@@ -132,3 +136,139 @@ TEST_IMPL(async) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_async_t pending_handles[3];
+static int pending_cb_called[3];
+
+
+static void pending_async_cb(uv_async_t* handle) {
+  pending_cb_called[handle - pending_handles]++;
+
+  /* The first callback closes a handle that has been sent to but not yet
+   * dispatched; its callback must not run.
+   */
+  if (handle == &pending_handles[0]) {
+    uv_close((uv_handle_t*) &pending_handles[1], NULL);
+    uv_close((uv_handle_t*) &pending_handles[0], NULL);
+    return;
+  }
+
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(async_close_pending) {
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+
+  for (i = 0; i < 3; i++)
+    ASSERT(0 == uv_async_init(loop, &pending_handles[i], pending_async_cb));
+
+  ASSERT(0 == uv_async_send(&pending_handles[0]));
+  ASSERT(0 == uv_async_send(&pending_handles[1]));
+  ASSERT(0 == uv_async_send(&pending_handles[2]));
+  ASSERT(0 == uv_async_send(&pending_handles[1]));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(pending_cb_called[0] == 1);
+  ASSERT(pending_cb_called[1] == 0);
+  ASSERT(pending_cb_called[2] == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_check_t check_handle;
+static int awake_cb_called;
+
+
+static void awake_async_cb(uv_async_t* handle) {
+  awake_cb_called++;
+}
+
+
+static void send_from_check_cb(uv_check_t* handle) {
+  /* The loop is awake, so this doesn't write to the backend's eventfd. */
+  ASSERT(0 == uv_async_send(&async));
+  uv_check_stop(handle);
+}
+
+
+TEST_IMPL(async_send_awake) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_backend_fd() isn't pollable on Windows.");
+#else
+  struct pollfd pfd;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_async_init(loop, &async, awake_async_cb));
+  ASSERT(0 == uv_check_init(loop, &check_handle));
+  ASSERT(0 == uv_check_start(&check_handle, send_from_check_cb));
+
+  ASSERT(0 != uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT(awake_cb_called == 0);
+
+  /* An embedder that polls the backend fd still has to see the send that
+   * happened while uv_run() was running.
+   */
+  pfd.fd = uv_backend_fd(loop);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  ASSERT(1 == poll(&pfd, 1, 0));
+
+  ASSERT(0 != uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT(awake_cb_called == 1);
+
+  uv_close((uv_handle_t*) &async, NULL);
+  uv_close((uv_handle_t*) &check_handle, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static uv_timer_t timer_handle;
+static uv_async_t awake_handles[2];
+
+
+static void close_awake_async_cb(uv_async_t* handle) {
+  ASSERT(handle == &awake_handles[0]);
+  awake_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void send_close_timer_cb(uv_timer_t* handle) {
+  /* Closing a pending handle outside of the async callbacks must not
+   * strand the handles that were sent to before it.
+   */
+  ASSERT(0 == uv_async_send(&awake_handles[0]));
+  ASSERT(0 == uv_async_send(&awake_handles[1]));
+  uv_close((uv_handle_t*) &awake_handles[1], NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(async_close_pending_awake) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_async_init(loop, &awake_handles[0], close_awake_async_cb));
+  ASSERT(0 == uv_async_init(loop, &awake_handles[1], close_awake_async_cb));
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, send_close_timer_cb, 1, 0));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(awake_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,210 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_SENDERS 4
+#define NUM_MESSAGES 20000
+
+static uv_channel_t* channel;
+static int channel_cb_called;
+static int close_cb_called;
+static unsigned int received;
+static unsigned int last_seen[NUM_SENDERS];
+static int messages[3];
+
+
+static void close_cb(uv_channel_t* handle) {
+  ASSERT(handle == channel);
+  ASSERT(uv_channel_get_data(handle) == &channel_cb_called);
+  close_cb_called++;
+}
+
+
+static void fail_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  ASSERT(0 && "fail_cb should not have been called");
+}
+
+
+static void basic_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  ASSERT(handle == channel);
+  ASSERT(nmsgs == 3);
+  ASSERT(msgs[0] == &messages[0]);
+  ASSERT(msgs[1] == &messages[1]);
+  ASSERT(msgs[2] == &messages[2]);
+  channel_cb_called++;
+  uv_channel_close(handle, close_cb);
+}
+
+
+TEST_IMPL(channel_basic) {
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT(UV_EINVAL == uv_channel_create(loop, &channel, 0, NULL));
+  ASSERT(0 == uv_channel_create(loop, &channel, 0, basic_cb));
+  ASSERT(uv_channel_get_loop(channel) == loop);
+  uv_channel_set_data(channel, &channel_cb_called);
+
+  for (i = 0; i < 3; i++)
+    ASSERT(0 == uv_channel_send(channel, &messages[i]));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(channel_cb_called == 1);
+  ASSERT(close_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void bounded_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  channel_cb_called++;
+
+  if (channel_cb_called == 1) {
+    ASSERT(nmsgs == 2);
+    ASSERT(msgs[0] == &messages[0]);
+    ASSERT(msgs[1] == &messages[1]);
+    /* There's room again. */
+    ASSERT(0 == uv_channel_send(handle, &messages[2]));
+    return;
+  }
+
+  ASSERT(nmsgs == 1);
+  ASSERT(msgs[0] == &messages[2]);
+  uv_channel_close(handle, close_cb);
+}
+
+
+TEST_IMPL(channel_bounded) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_channel_create(loop, &channel, 2, bounded_cb));
+  uv_channel_set_data(channel, &channel_cb_called);
+  ASSERT(0 == uv_channel_send(channel, &messages[0]));
+  ASSERT(0 == uv_channel_send(channel, &messages[1]));
+  ASSERT(UV_EAGAIN == uv_channel_send(channel, &messages[2]));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(channel_cb_called == 2);
+  ASSERT(close_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(channel_close_pending) {
+  uv_loop_t* loop;
+  int i;
+
+  /* Messages still queued when the channel is closed are dropped. */
+  loop = uv_default_loop();
+  ASSERT(0 == uv_channel_create(loop, &channel, 0, fail_cb));
+  uv_channel_set_data(channel, &channel_cb_called);
+  for (i = 0; i < 3; i++)
+    ASSERT(0 == uv_channel_send(channel, &messages[i]));
+
+  /* The loop can't go away under an open channel. */
+  ASSERT(UV_EBUSY == uv_loop_close(loop));
+  uv_channel_close(channel, close_cb);
+  ASSERT(UV_EBUSY == uv_loop_close(loop));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(close_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void sender(void* arg) {
+  uintptr_t id;
+  uintptr_t i;
+
+  id = (uintptr_t) arg;
+  for (i = 1; i <= NUM_MESSAGES; i++)
+    ASSERT(0 == uv_channel_send_wait(channel, (void*) (id << 20 | i)));
+}
+
+
+static void threads_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  unsigned int i;
+  uintptr_t msg;
+  uintptr_t id;
+
+  ASSERT(nmsgs > 0);
+  channel_cb_called++;
+
+  /* Messages from one sender arrive in the order they were sent. */
+  for (i = 0; i < nmsgs; i++) {
+    msg = (uintptr_t) msgs[i];
+    id = msg >> 20;
+    ASSERT(id < NUM_SENDERS);
+    ASSERT((msg & 0xfffff) == last_seen[id] + 1);
+    last_seen[id]++;
+  }
+
+  received += nmsgs;
+  if (received == NUM_SENDERS * NUM_MESSAGES)
+    uv_channel_close(handle, close_cb);
+}
+
+
+static int channel_threads(size_t capacity) {
+  uv_thread_t threads[NUM_SENDERS];
+  uv_loop_t* loop;
+  uintptr_t i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_channel_create(loop, &channel, capacity, threads_cb));
+  uv_channel_set_data(channel, &channel_cb_called);
+
+  for (i = 0; i < NUM_SENDERS; i++)
+    ASSERT(0 == uv_thread_create(threads + i, sender, (void*) i));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  for (i = 0; i < NUM_SENDERS; i++) {
+    ASSERT(0 == uv_thread_join(threads + i));
+    ASSERT(last_seen[i] == NUM_MESSAGES);
+  }
+
+  ASSERT(received == NUM_SENDERS * NUM_MESSAGES);
+  ASSERT(channel_cb_called > 0);
+  ASSERT(close_cb_called == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(channel_threads) {
+  return channel_threads(0);
+}
+
+
+TEST_IMPL(channel_threads_bounded) {
+  /* Small enough that the senders have to wait for the loop thread. */
+  return channel_threads(16);
+}
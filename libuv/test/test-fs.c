@@ -4130,3 +4130,109 @@ TEST_IMPL(fs_statfs) {
 
   return 0;
 }
+
+
+#ifdef __linux__
+static uv_work_kind slow_device_kind;
+static int slow_device_lease = -1;
+
+
+static void slow_device_timing_cb(uv_req_t* req,
+                                  const uv_work_timing_t* timing) {
+  ASSERT(req->type == UV_FS);
+  slow_device_kind = timing->kind;
+}
+
+
+static void slow_device_timer_cb(uv_timer_t* handle) {
+  /* Lets the open that broke the lease return. */
+  ASSERT(0 == fcntl(slow_device_lease, F_SETLEASE, F_UNLCK));
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void slow_device_open_cb(uv_fs_t* req) {
+  uv_fs_t close_req;
+
+  ASSERT(req->result >= 0);
+  ASSERT(0 == uv_fs_close(NULL, &close_req, req->result, NULL));
+  uv_fs_req_cleanup(&close_req);
+  uv_fs_req_cleanup(req);
+}
+
+
+static void slow_device_stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  uv_fs_req_cleanup(req);
+}
+#endif
+
+
+TEST_IMPL(fs_slow_device) {
+#ifndef __linux__
+  RETURN_SKIP("Paths are only classified on Linux");
+#else
+  uv_timer_t timer;
+  uv_fs_t req;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  unlink("test_file");
+  slow_device_lease = open("test_file", O_RDONLY | O_CREAT, 0600);
+  ASSERT(slow_device_lease >= 0);
+
+  /* The lease holder is told about the open with SIGIO, which would end
+   * the process.
+   */
+  signal(SIGIO, SIG_IGN);
+  if (fcntl(slow_device_lease, F_SETLEASE, F_RDLCK)) {
+    close(slow_device_lease);
+    unlink("test_file");
+    RETURN_SKIP("File leases are not supported");
+  }
+
+  ASSERT(0 == uv_loop_set_work_timing_cb(loop, slow_device_timing_cb));
+
+  /* Opening the file for writing waits until the lease is given up, the
+   * device of the file looks like it takes 300 ms per request.
+   */
+  ASSERT(0 == uv_fs_open(loop,
+                         &req,
+                         "test_file",
+                         O_WRONLY,
+                         0,
+                         slow_device_open_cb));
+  ASSERT(0 == uv_timer_init(loop, &timer));
+  ASSERT(0 == uv_timer_start(&timer, slow_device_timer_cb, 300, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(slow_device_kind == UV_WORK_FAST_IO);
+  ASSERT(0 == close(slow_device_lease));
+
+  /* Synchronous requests aren't sampled, they don't bring it back. */
+  for (i = 0; i < 20; i++) {
+    ASSERT(0 == uv_fs_stat(NULL, &req, "test_file", NULL));
+    uv_fs_req_cleanup(&req);
+  }
+
+  /* Requests for the same device now take the slow lane, until enough fast
+   * ones brought the average down again.
+   */
+  for (i = 0; i < 20; i++) {
+    ASSERT(0 == uv_fs_stat(loop, &req, "test_file", slow_device_stat_cb));
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    if (i == 0)
+      ASSERT(slow_device_kind == UV_WORK_SLOW_IO);
+    if (slow_device_kind == UV_WORK_FAST_IO)
+      break;
+  }
+
+  ASSERT(i > 0);
+  ASSERT(i < 20);
+
+  ASSERT(0 == uv_loop_set_work_timing_cb(loop, NULL));
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
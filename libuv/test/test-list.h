@@ -27,12 +27,21 @@ TEST_DECLARE   (close_order)
 TEST_DECLARE   (run_once)
 TEST_DECLARE   (run_nowait)
 TEST_DECLARE   (loop_alive)
+TEST_DECLARE   (loop_defer)
+TEST_DECLARE   (loop_defer_timeout)
 TEST_DECLARE   (loop_close)
 TEST_DECLARE   (loop_instant_close)
 TEST_DECLARE   (loop_stop)
 TEST_DECLARE   (loop_update_time)
 TEST_DECLARE   (loop_backend_timeout)
 TEST_DECLARE   (loop_configure)
+TEST_DECLARE   (loop_configure_io_uring)
+TEST_DECLARE   (loop_configure_edge_triggered)
+TEST_DECLARE   (metrics_saved_syscalls)
+TEST_DECLARE   (metrics_idle_time)
+TEST_DECLARE   (metrics_info)
+TEST_DECLARE   (metrics_busy_poll)
+TEST_DECLARE   (metrics_enable_in_callback)
 TEST_DECLARE   (default_loop_close)
 TEST_DECLARE   (barrier_1)
 TEST_DECLARE   (barrier_2)
@@ -106,12 +115,19 @@ TEST_DECLARE   (tcp_bind_error_fault)
 TEST_DECLARE   (tcp_bind_error_inval)
 TEST_DECLARE   (tcp_bind_localhost_ok)
 TEST_DECLARE   (tcp_bind_invalid_flags)
+TEST_DECLARE   (tcp_bind_reuseport)
+TEST_DECLARE   (tcp_group)
+TEST_DECLARE   (tcp_group_steer_cpu)
 TEST_DECLARE   (tcp_bind_writable_flags)
 TEST_DECLARE   (tcp_listen_without_bind)
 TEST_DECLARE   (tcp_connect_error_fault)
 TEST_DECLARE   (tcp_connect_timeout)
 TEST_DECLARE   (tcp_close_while_connecting)
 TEST_DECLARE   (tcp_close)
+TEST_DECLARE   (tcp_transfer)
+TEST_DECLARE   (tcp_transfer_edge_triggered)
+TEST_DECLARE   (tcp_transfer_edge_triggered_fed)
+TEST_DECLARE   (tcp_transfer_io_uring)
 TEST_DECLARE   (tcp_close_reset_accepted)
 TEST_DECLARE   (tcp_close_reset_accepted_after_shutdown)
 TEST_DECLARE   (tcp_close_reset_client)
@@ -200,6 +216,9 @@ TEST_DECLARE   (timer_from_check)
 TEST_DECLARE   (timer_is_closing)
 TEST_DECLARE   (timer_null_callback)
 TEST_DECLARE   (timer_early_check)
+TEST_DECLARE   (timer_wheel)
+TEST_DECLARE   (timer_slack)
+TEST_DECLARE   (timer_ns)
 TEST_DECLARE   (idle_starvation)
 TEST_DECLARE   (loop_handles)
 TEST_DECLARE   (get_loadavg)
@@ -239,6 +258,14 @@ TEST_DECLARE   (active)
 TEST_DECLARE   (embed)
 TEST_DECLARE   (async)
 TEST_DECLARE   (async_null_cb)
+TEST_DECLARE   (async_close_pending)
+TEST_DECLARE   (async_send_awake)
+TEST_DECLARE   (async_close_pending_awake)
+TEST_DECLARE   (channel_basic)
+TEST_DECLARE   (channel_bounded)
+TEST_DECLARE   (channel_close_pending)
+TEST_DECLARE   (channel_threads)
+TEST_DECLARE   (channel_threads_bounded)
 TEST_DECLARE   (eintr_handling)
 TEST_DECLARE   (get_currentexe)
 TEST_DECLARE   (process_title)
@@ -336,6 +363,7 @@ TEST_DECLARE   (fs_utime)
 TEST_DECLARE   (fs_futime)
 TEST_DECLARE   (fs_file_open_append)
 TEST_DECLARE   (fs_statfs)
+TEST_DECLARE   (fs_slow_device)
 TEST_DECLARE   (fs_stat_missing_path)
 TEST_DECLARE   (fs_read_bufs)
 TEST_DECLARE   (fs_read_file_eof)
@@ -392,6 +420,13 @@ TEST_DECLARE   (fs_invalid_mkdir_name)
 TEST_DECLARE   (strscpy)
 TEST_DECLARE   (threadpool_queue_work_simple)
 TEST_DECLARE   (threadpool_queue_work_einval)
+TEST_DECLARE   (threadpool_per_loop)
+TEST_DECLARE   (threadpool_work_stealing)
+TEST_DECLARE   (threadpool_elastic)
+TEST_DECLARE   (threadpool_priority)
+TEST_DECLARE   (threadpool_batch)
+TEST_DECLARE   (threadpool_metrics)
+TEST_DECLARE   (threadpool_pin_threads)
 TEST_DECLARE   (threadpool_multiple_event_loops)
 TEST_DECLARE   (threadpool_cancel_getaddrinfo)
 TEST_DECLARE   (threadpool_cancel_getnameinfo)
@@ -401,6 +436,8 @@ TEST_DECLARE   (threadpool_cancel_single)
 TEST_DECLARE   (thread_local_storage)
 TEST_DECLARE   (thread_stack_size)
 TEST_DECLARE   (thread_stack_size_explicit)
+TEST_DECLARE   (thread_affinity)
+TEST_DECLARE   (thread_sched_policy)
 TEST_DECLARE   (thread_mutex)
 TEST_DECLARE   (thread_mutex_recursive)
 TEST_DECLARE   (thread_rwlock)
@@ -500,12 +537,21 @@ TASK_LIST_START
   TEST_ENTRY  (run_once)
   TEST_ENTRY  (run_nowait)
   TEST_ENTRY  (loop_alive)
+  TEST_ENTRY  (loop_defer)
+  TEST_ENTRY  (loop_defer_timeout)
   TEST_ENTRY  (loop_close)
   TEST_ENTRY  (loop_instant_close)
   TEST_ENTRY  (loop_stop)
   TEST_ENTRY  (loop_update_time)
   TEST_ENTRY  (loop_backend_timeout)
   TEST_ENTRY  (loop_configure)
+  TEST_ENTRY  (loop_configure_io_uring)
+  TEST_ENTRY  (loop_configure_edge_triggered)
+  TEST_ENTRY  (metrics_saved_syscalls)
+  TEST_ENTRY  (metrics_idle_time)
+  TEST_ENTRY  (metrics_info)
+  TEST_ENTRY  (metrics_busy_poll)
+  TEST_ENTRY  (metrics_enable_in_callback)
   TEST_ENTRY  (default_loop_close)
   TEST_ENTRY  (barrier_1)
   TEST_ENTRY  (barrier_2)
@@ -623,12 +669,19 @@ TASK_LIST_START
   TEST_ENTRY  (tcp_bind_error_inval)
   TEST_ENTRY  (tcp_bind_localhost_ok)
   TEST_ENTRY  (tcp_bind_invalid_flags)
+  TEST_ENTRY  (tcp_bind_reuseport)
+  TEST_ENTRY  (tcp_group)
+  TEST_ENTRY  (tcp_group_steer_cpu)
   TEST_ENTRY  (tcp_bind_writable_flags)
   TEST_ENTRY  (tcp_listen_without_bind)
   TEST_ENTRY  (tcp_connect_error_fault)
   TEST_ENTRY  (tcp_connect_timeout)
   TEST_ENTRY  (tcp_close_while_connecting)
   TEST_ENTRY  (tcp_close)
+  TEST_ENTRY  (tcp_transfer)
+  TEST_ENTRY  (tcp_transfer_edge_triggered)
+  TEST_ENTRY  (tcp_transfer_edge_triggered_fed)
+  TEST_ENTRY  (tcp_transfer_io_uring)
   TEST_ENTRY  (tcp_close_reset_accepted)
   TEST_ENTRY  (tcp_close_reset_accepted_after_shutdown)
   TEST_ENTRY  (tcp_close_reset_client)
@@ -733,6 +786,9 @@ TASK_LIST_START
   TEST_ENTRY  (timer_is_closing)
   TEST_ENTRY  (timer_null_callback)
   TEST_ENTRY  (timer_early_check)
+  TEST_ENTRY  (timer_wheel)
+  TEST_ENTRY  (timer_slack)
+  TEST_ENTRY  (timer_ns)
 
   TEST_ENTRY  (idle_starvation)
 
@@ -778,6 +834,14 @@ TASK_LIST_START
 
   TEST_ENTRY  (async)
   TEST_ENTRY  (async_null_cb)
+  TEST_ENTRY  (async_close_pending)
+  TEST_ENTRY  (async_send_awake)
+  TEST_ENTRY  (async_close_pending_awake)
+  TEST_ENTRY  (channel_basic)
+  TEST_ENTRY  (channel_bounded)
+  TEST_ENTRY  (channel_close_pending)
+  TEST_ENTRY  (channel_threads)
+  TEST_ENTRY  (channel_threads_bounded)
   TEST_ENTRY  (eintr_handling)
 
   TEST_ENTRY  (get_currentexe)
@@ -940,6 +1004,7 @@ TASK_LIST_START
   TEST_ENTRY  (fs_fd_hash)
 #endif
   TEST_ENTRY  (fs_statfs)
+  TEST_ENTRY  (fs_slow_device)
   TEST_ENTRY  (fs_stat_missing_path)
   TEST_ENTRY  (fs_read_bufs)
   TEST_ENTRY  (fs_read_file_eof)
@@ -997,6 +1062,13 @@ TASK_LIST_START
   TEST_ENTRY  (strscpy)
   TEST_ENTRY  (threadpool_queue_work_simple)
   TEST_ENTRY  (threadpool_queue_work_einval)
+  TEST_ENTRY  (threadpool_per_loop)
+  TEST_ENTRY  (threadpool_work_stealing)
+  TEST_ENTRY  (threadpool_elastic)
+  TEST_ENTRY  (threadpool_priority)
+  TEST_ENTRY  (threadpool_batch)
+  TEST_ENTRY  (threadpool_metrics)
+  TEST_ENTRY  (threadpool_pin_threads)
   TEST_ENTRY_CUSTOM (threadpool_multiple_event_loops, 0, 0, 60000)
   TEST_ENTRY  (threadpool_cancel_getaddrinfo)
   TEST_ENTRY  (threadpool_cancel_getnameinfo)
@@ -1006,6 +1078,8 @@ TASK_LIST_START
   TEST_ENTRY  (thread_local_storage)
   TEST_ENTRY  (thread_stack_size)
   TEST_ENTRY  (thread_stack_size_explicit)
+  TEST_ENTRY  (thread_affinity)
+  TEST_ENTRY  (thread_sched_policy)
   TEST_ENTRY  (thread_mutex)
   TEST_ENTRY  (thread_mutex_recursive)
   TEST_ENTRY  (thread_rwlock)
@@ -16,6 +16,25 @@
 #include "uv.h"
 #include "task.h"
 
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+# include <string.h>
+
+static uv_poll_t poll_handle;
+static int poll_cb_called;
+static int sv[2];
+
+static uv_pipe_t pipe_handle;
+static uv_timer_t restart_timer;
+static char read_byte;
+static int bytes_read;
+static int eof_cb_called;
+
+static void restart_timer_cb(uv_timer_t* handle);
+#endif
+
+
 static void timer_cb(uv_timer_t* handle) {
   uv_close((uv_handle_t*) handle, NULL);
 }
@@ -36,3 +55,155 @@ TEST_IMPL(loop_configure) {
   ASSERT(0 == uv_loop_close(&loop));
   return 0;
 }
+
+
+#ifndef _WIN32
+static void poll_cb(uv_poll_t* handle, int status, int events) {
+  char c;
+
+  ASSERT(status == 0);
+  poll_cb_called++;
+
+  switch (poll_cb_called) {
+    case 1:
+      /* Switch the event mask, the backend has to replace the armed request. */
+      ASSERT(events & UV_READABLE);
+      ASSERT(1 == read(sv[0], &c, 1));
+      ASSERT(0 == uv_poll_start(handle, UV_WRITABLE, poll_cb));
+      break;
+
+    case 2:
+      ASSERT(events & UV_WRITABLE);
+      ASSERT(0 == uv_poll_start(handle, UV_READABLE, poll_cb));
+      ASSERT(1 == write(sv[1], "x", 1));
+      break;
+
+    case 3:
+      ASSERT(events & UV_READABLE);
+      ASSERT(1 == read(sv[0], &c, 1));
+      uv_close((uv_handle_t*) handle, NULL);
+      break;
+
+    default:
+      ASSERT(0 && "unreachable");
+  }
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring) {
+#ifdef _WIN32
+  RETURN_SKIP("Test does not currently work in Windows");
+#else
+  uv_loop_t loop;
+  int r;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING);
+#ifdef __linux__
+  ASSERT(r == 0);
+#else
+  ASSERT(r == UV_ENOSYS);
+#endif
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+  ASSERT(0 == uv_poll_init(&loop, &poll_handle, sv[0]));
+  ASSERT(0 == uv_poll_start(&poll_handle, UV_READABLE, poll_cb));
+  ASSERT(1 == write(sv[1], "x", 1));
+
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(3 == poll_cb_called);
+
+  ASSERT(0 == close(sv[0]));
+  ASSERT(0 == close(sv[1]));
+  ASSERT(0 == uv_loop_close(&loop));
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+static void alloc_byte_cb(uv_handle_t* handle,
+                          size_t suggested_size,
+                          uv_buf_t* buf) {
+  /* One byte at a time so that reading takes more than one 32 read budget. */
+  buf->base = &read_byte;
+  buf->len = 1;
+}
+
+
+static void read_byte_cb(uv_stream_t* stream,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  if (nread == UV_EOF) {
+    eof_cb_called++;
+    uv_close((uv_handle_t*) stream, NULL);
+    uv_close((uv_handle_t*) &restart_timer, NULL);
+    return;
+  }
+
+  ASSERT(nread >= 0);
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == 1);
+  ASSERT(read_byte == 'x');
+  bytes_read++;
+
+  /* Stop after the first byte.  By the time reading restarts, all data and
+   * the hangup have been seen by the kernel, nothing new is going to happen.
+   */
+  if (bytes_read == 1) {
+    ASSERT(0 == uv_read_stop(stream));
+    ASSERT(0 == uv_timer_start(&restart_timer, restart_timer_cb, 10, 0));
+  }
+}
+
+
+static void restart_timer_cb(uv_timer_t* handle) {
+  ASSERT(0 == uv_read_start((uv_stream_t*) &pipe_handle,
+                            alloc_byte_cb,
+                            read_byte_cb));
+}
+#endif
+
+
+TEST_IMPL(loop_configure_edge_triggered) {
+#ifdef _WIN32
+  RETURN_SKIP("Test does not currently work in Windows");
+#else
+  char data[100];
+  uv_loop_t loop;
+  int fds[2];
+  int r;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_EDGE_TRIGGERED);
+#ifdef __linux__
+  ASSERT(r == 0);
+#else
+  ASSERT(r == UV_ENOSYS);
+#endif
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT(0 == uv_pipe_init(&loop, &pipe_handle, 0));
+  ASSERT(0 == uv_pipe_open(&pipe_handle, fds[0]));
+  ASSERT(0 == uv_timer_init(&loop, &restart_timer));
+
+  memset(data, 'x', sizeof(data));
+  ASSERT(sizeof(data) == write(fds[1], data, sizeof(data)));
+  ASSERT(0 == shutdown(fds[1], SHUT_WR));
+
+  ASSERT(0 == uv_read_start((uv_stream_t*) &pipe_handle,
+                            alloc_byte_cb,
+                            read_byte_cb));
+
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(bytes_read == sizeof(data));
+  ASSERT(eof_cb_called == 1);
+
+  ASSERT(0 == close(fds[1]));
+  ASSERT(0 == uv_loop_close(&loop));
+  return 0;
+#endif
+}
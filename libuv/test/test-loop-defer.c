@@ -0,0 +1,117 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+static int order[64];
+static int norder;
+static int self_deferred;
+
+
+static void order_cb(uv_loop_t* loop, void* arg) {
+  ASSERT(loop == uv_default_loop());
+  ASSERT(norder < (int) ARRAY_SIZE(order));
+  order[norder++] = (int) (intptr_t) arg;
+}
+
+
+static void defer_again_cb(uv_loop_t* loop, void* arg) {
+  self_deferred++;
+  /* Runs on the next iteration, not in this one. */
+  ASSERT(0 == uv_loop_defer(loop, order_cb, arg));
+}
+
+
+TEST_IMPL(loop_defer) {
+  uv_loop_t* loop;
+  intptr_t i;
+
+  loop = uv_default_loop();
+  ASSERT(UV_EINVAL == uv_loop_defer(loop, NULL, NULL));
+  ASSERT(!uv_loop_alive(loop));
+
+  for (i = 0; i < 10; i++)
+    ASSERT(0 == uv_loop_defer(loop, order_cb, (void*) i));
+  ASSERT(0 == uv_loop_defer(loop, defer_again_cb, (void*) 100));
+
+  /* A queued callback keeps the loop alive without any handles. */
+  ASSERT(uv_loop_alive(loop));
+  ASSERT(0 == uv_backend_timeout(loop));
+  ASSERT(UV_EBUSY == uv_loop_close(loop));
+
+  ASSERT(0 != uv_run(loop, UV_RUN_ONCE));
+  ASSERT(norder == 10);
+  ASSERT(self_deferred == 1);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_ONCE));
+  ASSERT(norder == 11);
+  ASSERT(order[10] == 100);
+
+  /* The ring has wrapped around by now; growing it keeps the order. */
+  for (i = 11; i < 40; i++)
+    ASSERT(0 == uv_loop_defer(loop, order_cb, (void*) i));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(norder == 40);
+  for (i = 0; i < 10; i++)
+    ASSERT(order[i] == i);
+  for (i = 11; i < 40; i++)
+    ASSERT(order[i] == i);
+  ASSERT(!uv_loop_alive(loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_timer_t timer_handle;
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "timer_cb should not have been called");
+}
+
+
+static void close_timer_cb(uv_loop_t* loop, void* arg) {
+  ASSERT(arg == &timer_handle);
+  uv_close((uv_handle_t*) &timer_handle, NULL);
+}
+
+
+TEST_IMPL(loop_defer_timeout) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, timer_cb, 10000, 0));
+
+  /* An empty queue doesn't make the loop poll. */
+  ASSERT(uv_backend_timeout(loop) > 0);
+
+  ASSERT(0 == uv_loop_defer(loop, close_timer_cb, &timer_handle));
+  ASSERT(0 == uv_backend_timeout(loop));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,308 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+static uv_timer_t timer_handle;
+
+#ifndef _WIN32
+# include <sys/socket.h>
+# include <unistd.h>
+
+static uv_pipe_t pipe_handle;
+static int read_cb_called;
+static int fds[2];
+static char buf[1];
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* b) {
+  b->base = buf;
+  b->len = sizeof(buf);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* b);
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(0 == uv_read_start((uv_stream_t*) &pipe_handle, alloc_cb, read_cb));
+
+  /* Data that arrives after the restart. */
+  if (read_cb_called == 1)
+    ASSERT(1 == write(fds[1], "b", 1));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* b) {
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == 1);
+  read_cb_called++;
+
+  switch (read_cb_called) {
+    case 1:
+      ASSERT(buf[0] == 'a');
+      ASSERT(0 == uv_read_stop(stream));
+      ASSERT(0 == uv_timer_start(&timer_handle, timer_cb, 10, 0));
+      break;
+
+    case 2:
+      /* Data that arrives while reading is stopped. The kernel still reports
+       * it, it mustn't make it to the read callback.
+       */
+      ASSERT(buf[0] == 'b');
+      ASSERT(0 == uv_read_stop(stream));
+      ASSERT(1 == write(fds[1], "c", 1));
+      ASSERT(0 == uv_timer_start(&timer_handle, timer_cb, 10, 0));
+      break;
+
+    case 3:
+      ASSERT(buf[0] == 'c');
+      uv_close((uv_handle_t*) stream, NULL);
+      uv_close((uv_handle_t*) &timer_handle, NULL);
+      break;
+
+    default:
+      ASSERT(0 && "unreachable");
+  }
+}
+#endif
+
+
+TEST_IMPL(metrics_saved_syscalls) {
+#ifdef _WIN32
+  RETURN_SKIP("Test does not currently work in Windows");
+#else
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_metrics_saved_syscalls(loop));
+
+  ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT(0 == uv_pipe_init(loop, &pipe_handle, 0));
+  ASSERT(0 == uv_pipe_open(&pipe_handle, fds[0]));
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+
+  ASSERT(1 == write(fds[1], "a", 1));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &pipe_handle, alloc_cb, read_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(3 == read_cb_called);
+
+#ifdef __linux__
+  /* At least the first restart didn't need to touch the epoll set. The
+   * io_uring backend rearms its one-shot requests anyway.
+   */
+  if (getenv("UV_USE_IO_URING") == NULL)
+    ASSERT(uv_metrics_saved_syscalls(loop) >= 1);
+#else
+  ASSERT(0 == uv_metrics_saved_syscalls(loop));
+#endif
+
+  ASSERT(0 == close(fds[1]));
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+#define IDLE_TIMEOUT 100
+
+static uv_idle_t idle_handle;
+static int idle_cb_called;
+static int timer_cb_called;
+static uint64_t thread_idle_time;
+
+
+static void idle_timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+}
+
+
+static void sampler_thread(void* arg) {
+  uv_sleep(IDLE_TIMEOUT / 2);
+  /* The loop is still blocked in uv__io_poll(). */
+  thread_idle_time = uv_metrics_idle_time(arg);
+}
+
+
+TEST_IMPL(metrics_idle_time) {
+  uv_metrics_t metrics;
+  uv_thread_t tid;
+  uv_loop_t* loop;
+  uint64_t idle_time;
+
+  loop = uv_default_loop();
+  ASSERT(UV_ENOTSUP == uv_metrics_info(loop, &metrics));
+  ASSERT(0 == uv_metrics_idle_time(loop));
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_ENABLE_METRICS));
+
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, idle_timer_cb, IDLE_TIMEOUT, 0));
+  ASSERT(0 == uv_thread_create(&tid, sampler_thread, loop));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&tid));
+  ASSERT(1 == timer_cb_called);
+
+  ASSERT(thread_idle_time > 0);
+  idle_time = uv_metrics_idle_time(loop);
+  ASSERT(idle_time >= thread_idle_time);
+  /* Allow for a coarse clock, the loop was asleep for most of the timeout. */
+  ASSERT(idle_time >= (IDLE_TIMEOUT / 2) * (uint64_t) 1e6);
+
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  ASSERT(metrics.idle_time == idle_time);
+  ASSERT(metrics.phase_time[UV_LOOP_PHASE_POLL] >= idle_time);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void metrics_idle_cb(uv_idle_t* handle) {
+  if (++idle_cb_called == 3) {
+    uv_idle_stop(handle);
+    uv_close((uv_handle_t*) handle, NULL);
+  }
+}
+
+
+TEST_IMPL(metrics_info) {
+  uv_metrics_t metrics;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(UV_EINVAL == uv_metrics_info(loop, NULL));
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_ENABLE_METRICS));
+
+  ASSERT(0 == uv_idle_init(loop, &idle_handle));
+  ASSERT(0 == uv_idle_start(&idle_handle, metrics_idle_cb));
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, idle_timer_cb, 1, 0));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(3 == idle_cb_called);
+  ASSERT(1 == timer_cb_called);
+
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  ASSERT(metrics.loop_count >= 3);
+  ASSERT(metrics.poll_count >= metrics.loop_count);
+  ASSERT(metrics.phase_callbacks[UV_LOOP_PHASE_IDLE] == 3);
+  ASSERT(metrics.phase_callbacks[UV_LOOP_PHASE_TIMERS] == 1);
+  ASSERT(metrics.phase_callbacks[UV_LOOP_PHASE_CLOSING] == 1);
+  ASSERT(metrics.phase_callbacks[UV_LOOP_PHASE_CHECK] == 0);
+  ASSERT(metrics.saved_syscalls == uv_metrics_saved_syscalls(loop));
+
+  uv_close((uv_handle_t*) &timer_handle, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  ASSERT(metrics.phase_callbacks[UV_LOOP_PHASE_CLOSING] == 2);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void busy_poll_work_cb(uv_work_t* req) {
+  uv_sleep(1);
+}
+
+
+static void busy_poll_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+TEST_IMPL(metrics_busy_poll) {
+  uv_metrics_t metrics;
+  uv_work_t work_req;
+  uv_loop_t* loop;
+  int err;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_ENABLE_METRICS));
+
+  /* Long enough for the work item to finish while the loop spins. */
+  err = uv_loop_configure(loop, UV_LOOP_BUSY_POLL, 500 * 1000);
+  if (err == UV_ENOSYS || err == UV_ENOTSUP)
+    RETURN_SKIP("Busy polling is not supported");
+  ASSERT(err == 0);
+
+  ASSERT(0 == uv_queue_work(loop,
+                            &work_req,
+                            busy_poll_work_cb,
+                            busy_poll_after_work_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  ASSERT(metrics.spin_hits >= 1);
+
+  /* A short spin runs out and the loop blocks until the timer is due. */
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_BUSY_POLL, 100));
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, idle_timer_cb, 20, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == timer_cb_called);
+
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  ASSERT(metrics.spin_blocks >= 1);
+
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_BUSY_POLL, 0));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void enable_timer_cb(uv_timer_t* handle) {
+  ASSERT(0 == uv_loop_configure(handle->loop, UV_LOOP_ENABLE_METRICS));
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(metrics_enable_in_callback) {
+  uv_metrics_t metrics;
+  uv_loop_t* loop;
+  uint64_t start;
+  uint64_t duration;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  start = uv_hrtime();
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_timer_start(&timer_handle, enable_timer_cb, 1, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  duration = uv_hrtime() - start;
+
+  /* No phase can have taken longer than the whole run. */
+  ASSERT(0 == uv_metrics_info(loop, &metrics));
+  for (i = 0; i < ARRAY_SIZE(metrics.phase_time); i++)
+    ASSERT(metrics.phase_time[i] <= duration);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,226 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_LOOPS 2
+#define NUM_CLIENTS 20
+
+static uv_tcp_group_t group;
+static uv_mutex_t mutex;
+static unsigned int loop_cb_called[NUM_LOOPS];
+static unsigned int accepted;
+static unsigned int connect_cb_called;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+
+
+static void loop_cb(uv_tcp_group_t* g, uv_loop_t* loop, unsigned int index) {
+  ASSERT(g == &group);
+  ASSERT(index < NUM_LOOPS);
+  uv_mutex_lock(&mutex);
+  loop_cb_called[index]++;
+  uv_mutex_unlock(&mutex);
+}
+
+
+static void connection_cb(uv_stream_t* server, int status) {
+  uv_tcp_t* conn;
+
+  ASSERT(status == 0);
+  ASSERT(server->data == &group);
+
+  conn = malloc(sizeof(*conn));
+  ASSERT(conn != NULL);
+  ASSERT(0 == uv_tcp_init(server->loop, conn));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) conn, (uv_close_cb) free);
+
+  uv_mutex_lock(&mutex);
+  accepted++;
+  uv_mutex_unlock(&mutex);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, NULL);
+}
+
+
+static void wait_for_accepts(unsigned int n) {
+  unsigned int i;
+  unsigned int done;
+
+  for (i = 0; i < 500; i++) {
+    uv_mutex_lock(&mutex);
+    done = accepted;
+    uv_mutex_unlock(&mutex);
+    if (done == n)
+      return;
+    uv_sleep(10);
+  }
+
+  ASSERT(0 && "timed out waiting for the group to accept");
+}
+
+
+static int run_group(unsigned int flags, unsigned int nloops) {
+  uv_tcp_group_options_t options;
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  unsigned int i;
+  int err;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_mutex_init(&mutex));
+  memset(loop_cb_called, 0, sizeof(loop_cb_called));
+  accepted = 0;
+  connect_cb_called = 0;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nloops = nloops;
+  options.loop_cb = loop_cb;
+
+  err = uv_tcp_group_start(&group,
+                           (const struct sockaddr*) &addr,
+                           &options,
+                           connection_cb);
+  if (err != 0) {
+    uv_mutex_destroy(&mutex);
+    return err;
+  }
+
+  ASSERT(group.nloops == nloops);
+
+  loop = uv_default_loop();
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT(0 == uv_tcp_init(loop, clients + i));
+    ASSERT(0 == uv_tcp_connect(connect_reqs + i,
+                               clients + i,
+                               (const struct sockaddr*) &addr,
+                               connect_cb));
+  }
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(connect_cb_called == NUM_CLIENTS);
+
+  wait_for_accepts(NUM_CLIENTS);
+
+  ASSERT(0 == uv_tcp_group_stop(&group));
+  ASSERT(group.nloops == 0);
+  ASSERT(UV_EINVAL == uv_tcp_group_stop(&group));
+
+  for (i = 0; i < nloops; i++)
+    ASSERT(loop_cb_called[i] == 1);
+
+  uv_mutex_destroy(&mutex);
+  return 0;
+}
+
+
+TEST_IMPL(tcp_group) {
+#ifdef _WIN32
+  RETURN_SKIP("SO_REUSEPORT is not supported on Windows");
+#else
+  int err;
+
+  err = run_group(0, NUM_LOOPS);
+  if (err == UV_ENOTSUP)
+    RETURN_SKIP("SO_REUSEPORT load balancing is not supported");
+  ASSERT(err == 0);
+
+  /* The port is free again. */
+  err = run_group(0, 1);
+  ASSERT(err == 0);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+TEST_IMPL(tcp_group_steer_cpu) {
+#ifndef __linux__
+  RETURN_SKIP("CPU steering is Linux only");
+#else
+  int err;
+
+  /* Every machine has at least one CPU. */
+  err = run_group(UV_TCP_GROUP_STEER_CPU, 1);
+  if (err == UV_ENOPROTOOPT || err == UV_EINVAL || err == UV_EPERM)
+    RETURN_SKIP("Kernel doesn't support reuseport BPF programs");
+  ASSERT(err == 0);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static void unused_connection_cb(uv_stream_t* server, int status) {
+  ASSERT(0 && "unreachable");
+}
+
+
+TEST_IMPL(tcp_bind_reuseport) {
+  struct sockaddr_in addr;
+  uv_tcp_t server1;
+  uv_tcp_t server2;
+  uv_loop_t* loop;
+  int err;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_tcp_init(loop, &server1));
+  ASSERT(0 == uv_tcp_init(loop, &server2));
+
+  err = uv_tcp_bind(&server1, (const struct sockaddr*) &addr, UV_TCP_REUSEPORT);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &server1, NULL);
+    uv_close((uv_handle_t*) &server2, NULL);
+    ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("SO_REUSEPORT load balancing is not supported");
+  }
+
+  ASSERT(err == 0);
+  ASSERT(0 == uv_listen((uv_stream_t*) &server1, 128, unused_connection_cb));
+
+  ASSERT(0 == uv_tcp_bind(&server2,
+                          (const struct sockaddr*) &addr,
+                          UV_TCP_REUSEPORT));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server2, 128, unused_connection_cb));
+
+  uv_close((uv_handle_t*) &server1, NULL);
+  uv_close((uv_handle_t*) &server2, NULL);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,375 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+
+static uv_loop_t worker_loop;
+static uv_thread_t worker_thread;
+static uv_async_t worker_keepalive;
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_connect_t connect_req;
+static uv_write_t client_write_req;
+static uv_write_t conn_write_req;
+static char client_buf[8];
+static size_t client_nread;
+static char conn_buf[8];
+static size_t conn_nread;
+static int transfer_cb_called;
+static int conn_close_cb_called;
+static int client_close_cb_called;
+
+
+static void worker(void* arg) {
+  ASSERT(0 == uv_run(&worker_loop, UV_RUN_DEFAULT));
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void conn_close_cb(uv_handle_t* handle) {
+  ASSERT(handle->loop == &worker_loop);
+  conn_close_cb_called++;
+  uv_close((uv_handle_t*) &worker_keepalive, NULL);
+}
+
+
+static void conn_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) &conn, conn_close_cb);
+}
+
+
+static void conn_read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  uv_buf_t reply;
+
+  /* Reading was started on the default loop and carries on here. */
+  ASSERT(stream->loop == &worker_loop);
+  ASSERT(transfer_cb_called == 1);
+  ASSERT(nread > 0);
+  ASSERT(conn_nread + nread <= 4);
+  memcpy(conn_buf + conn_nread, buf->base, nread);
+  conn_nread += nread;
+
+  if (conn_nread < 4)
+    return;
+
+  ASSERT(0 == memcmp(conn_buf, "PING", 4));
+  reply = uv_buf_init("PONG", 4);
+  ASSERT(0 == uv_write(&conn_write_req, stream, &reply, 1, conn_write_cb));
+}
+
+
+static void transfer_cb(uv_tcp_t* handle, int status) {
+  ASSERT(handle == &conn);
+  ASSERT(status == 0);
+  ASSERT(handle->loop == &worker_loop);
+  ASSERT(uv_is_active((uv_handle_t*) handle));
+  transfer_cb_called++;
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &conn));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &conn, alloc_cb, conn_read_cb));
+
+  ASSERT(UV_EINVAL == uv_tcp_transfer(&conn, &worker_loop, NULL));
+  ASSERT(UV_EINVAL == uv_tcp_transfer(&server, &worker_loop, transfer_cb));
+  ASSERT(0 == uv_tcp_transfer(&conn, &worker_loop, transfer_cb));
+
+  uv_close((uv_handle_t*) &server, NULL);
+}
+
+
+static void client_close_cb(uv_handle_t* handle) {
+  client_close_cb_called++;
+}
+
+
+static void client_read_cb(uv_stream_t* stream,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  if (nread == UV_EOF) {
+    ASSERT(0 == memcmp(client_buf, "PONG", 4));
+    uv_close((uv_handle_t*) stream, client_close_cb);
+    return;
+  }
+
+  ASSERT(nread > 0);
+  ASSERT(client_nread + nread <= 4);
+  memcpy(client_buf + client_nread, buf->base, nread);
+  client_nread += nread;
+}
+
+
+static void client_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+  /* Sent right away, so it is waiting in the socket buffer while the
+   * connection moves to the other loop.
+   */
+  buf = uv_buf_init("PING", 4);
+  ASSERT(0 == uv_write(&client_write_req,
+                       req->handle,
+                       &buf,
+                       1,
+                       client_write_cb));
+  ASSERT(0 == uv_read_start(req->handle, alloc_cb, client_read_cb));
+}
+
+
+
+static int tcp_transfer(int option) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  /* Not connected. */
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(UV_EINVAL == uv_tcp_transfer(&client, &worker_loop, transfer_cb));
+
+  ASSERT(0 == uv_loop_init(&worker_loop));
+  if (option != -1) {
+    r = uv_loop_configure(&worker_loop, (uv_loop_option) option);
+    if (r == UV_ENOSYS) {
+      uv_close((uv_handle_t*) &client, NULL);
+      ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+      ASSERT(0 == uv_loop_close(&worker_loop));
+      MAKE_VALGRIND_HAPPY();
+      RETURN_SKIP("Loop option not supported on this platform.");
+    }
+    ASSERT(r == 0);
+  }
+
+  ASSERT(0 == uv_async_init(&worker_loop, &worker_keepalive, NULL));
+  ASSERT(0 == uv_thread_create(&worker_thread, worker, NULL));
+
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&worker_thread));
+
+  ASSERT(transfer_cb_called == 1);
+  ASSERT(conn_nread == 4);
+  ASSERT(client_nread == 4);
+  ASSERT(conn_close_cb_called == 1);
+  ASSERT(client_close_cb_called == 1);
+
+  ASSERT(0 == uv_loop_close(&worker_loop));
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define FED_DATA_SIZE (64 * 1024)
+
+static uv_check_t check_handle;
+static char fed_data[FED_DATA_SIZE];
+static size_t fed_nread;
+static int fed_write_cb_called;
+
+
+static void fed_maybe_close(void) {
+  if (fed_write_cb_called == 1 && fed_nread == FED_DATA_SIZE)
+    uv_close((uv_handle_t*) &conn, conn_close_cb);
+}
+
+
+static void fed_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT(conn.loop == &worker_loop);
+  fed_write_cb_called++;
+  fed_maybe_close();
+}
+
+
+static void fed_read_cb(uv_stream_t* stream,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  ASSERT(nread > 0);
+  fed_nread += nread;
+  ASSERT(fed_nread <= FED_DATA_SIZE);
+  fed_maybe_close();
+}
+
+
+static void fed_transfer_cb(uv_tcp_t* handle, int status) {
+  uv_buf_t reply;
+
+  ASSERT(status == 0);
+  ASSERT(handle->loop == &worker_loop);
+  transfer_cb_called++;
+
+  /* Finishing a write feeds the watcher too. */
+  reply = uv_buf_init("PONG", 4);
+  ASSERT(0 == uv_write(&conn_write_req,
+                       (uv_stream_t*) handle,
+                       &reply,
+                       1,
+                       fed_write_cb));
+}
+
+
+static void fed_check_cb(uv_check_t* handle) {
+  if (fed_nread == 0)
+    return;
+
+  /* The first read stopped at 32 reads of 64 bytes with data left, so the
+   * watcher waits on this loop's pending queue for the next tick.
+   */
+  ASSERT(fed_nread == 32 * 64);
+  ASSERT(0 == uv_tcp_transfer(&conn, &worker_loop, fed_transfer_cb));
+  uv_close((uv_handle_t*) handle, NULL);
+  uv_close((uv_handle_t*) &server, NULL);
+}
+
+
+static void fed_connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &conn));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &conn, alloc_cb, fed_read_cb));
+  ASSERT(0 == uv_check_init(stream->loop, &check_handle));
+  ASSERT(0 == uv_check_start(&check_handle, fed_check_cb));
+}
+
+
+static void fed_connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+  memset(fed_data, 'x', sizeof(fed_data));
+  buf = uv_buf_init(fed_data, sizeof(fed_data));
+  ASSERT(0 == uv_write(&client_write_req,
+                       req->handle,
+                       &buf,
+                       1,
+                       client_write_cb));
+  ASSERT(0 == uv_read_start(req->handle, alloc_cb, client_read_cb));
+}
+
+#endif
+
+
+TEST_IMPL(tcp_transfer) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_tcp_transfer() isn't supported on Windows.");
+#else
+  return tcp_transfer(-1);
+#endif
+}
+
+
+/* Data that is already waiting doesn't produce a new edge. */
+TEST_IMPL(tcp_transfer_edge_triggered) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_tcp_transfer() isn't supported on Windows.");
+#else
+  return tcp_transfer(UV_LOOP_USE_EDGE_TRIGGERED);
+#endif
+}
+
+
+/* Moves the connection while its edge-triggered watcher is queued to be fed
+ * on the old loop. It has to be fed on the new loop, for reads and for the
+ * completion of writes.
+ */
+TEST_IMPL(tcp_transfer_edge_triggered_fed) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_tcp_transfer() isn't supported on Windows.");
+#else
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+  r = uv_loop_configure(loop, UV_LOOP_USE_EDGE_TRIGGERED);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("Loop option not supported on this platform.");
+  ASSERT(r == 0);
+
+  ASSERT(0 == uv_loop_init(&worker_loop));
+  ASSERT(0 == uv_loop_configure(&worker_loop, UV_LOOP_USE_EDGE_TRIGGERED));
+  ASSERT(0 == uv_async_init(&worker_loop, &worker_keepalive, NULL));
+  ASSERT(0 == uv_thread_create(&worker_thread, worker, NULL));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, fed_connection_cb));
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             fed_connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&worker_thread));
+
+  ASSERT(transfer_cb_called == 1);
+  ASSERT(fed_write_cb_called == 1);
+  ASSERT(fed_nread == FED_DATA_SIZE);
+  ASSERT(client_nread == 4);
+  ASSERT(conn_close_cb_called == 1);
+  ASSERT(client_close_cb_called == 1);
+
+  ASSERT(0 == uv_loop_close(&worker_loop));
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+TEST_IMPL(tcp_transfer_io_uring) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_tcp_transfer() isn't supported on Windows.");
+#else
+  return tcp_transfer(UV_LOOP_USE_IO_URING);
+#endif
+}
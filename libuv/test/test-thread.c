@@ -283,3 +283,140 @@ TEST_IMPL(thread_stack_size_explicit) {
 
   return 0;
 }
+
+
+static char affinity_mask[8192];
+static int affinity_cpu;
+static int affinity_ok;
+
+
+static void thread_check_affinity(void* arg) {
+  uv_thread_t self;
+  char* mask;
+  int size;
+  int i;
+
+  size = uv_cpumask_size();
+  mask = malloc(size);
+  ASSERT(mask != NULL);
+
+  self = uv_thread_self();
+  ASSERT(0 == uv_thread_getaffinity(&self, mask, size));
+  for (i = 0; i < size; i++)
+    ASSERT(!!mask[i] == (i == affinity_cpu));
+  ASSERT(uv_thread_getcpu() == affinity_cpu);
+
+#if defined(__linux__)
+  if (arg != NULL) {
+    char name[16];
+    ASSERT(0 == pthread_getname_np(pthread_self(), name, sizeof(name)));
+    ASSERT(0 == strcmp(name, "uv-affinity-tes"));
+  }
+#endif
+
+  free(mask);
+  affinity_ok = 1;
+}
+
+
+TEST_IMPL(thread_affinity) {
+  uv_thread_options_t options;
+  uv_thread_t thread;
+  char* oldmask;
+  int size;
+  int i;
+
+  size = uv_cpumask_size();
+  if (size < 0)
+    RETURN_SKIP("Thread affinity is not supported on this platform");
+  ASSERT(size <= (int) sizeof(affinity_mask));
+
+  oldmask = malloc(size);
+  ASSERT(oldmask != NULL);
+
+  /* The thread runs on one of the CPUs it may use. */
+  thread = uv_thread_self();
+  ASSERT(0 == uv_thread_getaffinity(&thread, oldmask, size));
+  ASSERT(UV_EINVAL == uv_thread_getaffinity(&thread, oldmask, size - 1));
+  i = uv_thread_getcpu();
+  ASSERT(i >= 0 && i < size);
+  ASSERT(oldmask[i]);
+
+  affinity_cpu = 0;
+  while (!oldmask[affinity_cpu])
+    affinity_cpu++;
+
+  memset(affinity_mask, 0, sizeof(affinity_mask));
+  affinity_mask[affinity_cpu] = 1;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREAD_HAS_AFFINITY | UV_THREAD_HAS_NAME;
+  options.cpumask = affinity_mask;
+  options.mask_size = size;
+  options.name = "uv-affinity-test";
+  ASSERT(0 == uv_thread_create_ex(&thread, &options,
+                                  thread_check_affinity, &options));
+  ASSERT(0 == uv_thread_join(&thread));
+  ASSERT(affinity_ok == 1);
+
+  /* An empty mask or one that is too short is rejected. */
+  options.flags = UV_THREAD_HAS_AFFINITY;
+  options.mask_size = size - 1;
+  ASSERT(UV_EINVAL == uv_thread_create_ex(&thread, &options,
+                                          thread_check_affinity, NULL));
+  affinity_mask[affinity_cpu] = 0;
+  options.mask_size = size;
+  ASSERT(UV_EINVAL == uv_thread_create_ex(&thread, &options,
+                                          thread_check_affinity, NULL));
+
+  /* Pin this thread and restore its mask again. */
+  affinity_mask[affinity_cpu] = 1;
+  thread = uv_thread_self();
+  ASSERT(0 == uv_thread_setaffinity(&thread, affinity_mask, oldmask, size));
+  affinity_ok = 0;
+  thread_check_affinity(NULL);
+  ASSERT(affinity_ok == 1);
+  ASSERT(0 == uv_thread_setaffinity(&thread, oldmask, NULL, size));
+  ASSERT(0 == uv_thread_getaffinity(&thread, affinity_mask, size));
+  for (i = 0; i < size; i++)
+    ASSERT(!!affinity_mask[i] == !!oldmask[i]);
+
+  free(oldmask);
+  return 0;
+}
+
+
+static void thread_noop(void* arg) {
+  *(int*) arg = 1;
+}
+
+
+TEST_IMPL(thread_sched_policy) {
+  uv_thread_options_t options;
+  uv_thread_t thread;
+  int called;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREAD_HAS_SCHED;
+  options.sched_policy = UV_THREAD_SCHED_OTHER;
+  called = 0;
+  ASSERT(0 == uv_thread_create_ex(&thread, &options, thread_noop, &called));
+  ASSERT(0 == uv_thread_join(&thread));
+  ASSERT(called == 1);
+
+  /* SCHED_OTHER has no priorities. */
+  options.sched_priority = 42;
+  ASSERT(0 != uv_thread_create_ex(&thread, &options, thread_noop, &called));
+
+#if defined(__linux__)
+  /* Lowering the priority doesn't need privileges. */
+  options.sched_policy = UV_THREAD_SCHED_BATCH;
+  options.sched_priority = 0;
+  called = 0;
+  ASSERT(0 == uv_thread_create_ex(&thread, &options, thread_noop, &called));
+  ASSERT(0 == uv_thread_join(&thread));
+  ASSERT(called == 1);
+#endif
+
+  return 0;
+}
@@ -22,6 +22,8 @@
 #include "uv.h"
 #include "task.h"
 
+#include <string.h>
+
 static int work_cb_count;
 static int after_work_cb_count;
 static uv_work_t work_req;
@@ -74,3 +76,884 @@ TEST_IMPL(threadpool_queue_work_einval) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_threadpool_t pool;
+static uv_sem_t pool_sem;
+static uv_thread_t pool_threads[2];
+static int pool_work_cb_count;
+static int pool_after_work_cb_count;
+static int stat_cb_count;
+
+
+static void pool_work_cb(uv_work_t* req) {
+  uv_thread_t* self;
+
+  self = req->data;
+  *self = uv_thread_self();
+
+  /* Hold the only thread of the pool until the file system request, which
+   * still goes to the global pool, has finished.
+   */
+  if (self == &pool_threads[0])
+    uv_sem_wait(&pool_sem);
+
+  pool_work_cb_count++;
+}
+
+
+static void pool_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  pool_after_work_cb_count++;
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  ASSERT(pool_work_cb_count == 0);
+  stat_cb_count++;
+  uv_fs_req_cleanup(req);
+  uv_sem_post(&pool_sem);
+}
+
+
+TEST_IMPL(threadpool_per_loop) {
+  uv_threadpool_options_t options;
+  uv_work_t reqs[2];
+  uv_fs_t stat_req;
+  uv_loop_t* loop;
+  uv_loop_t other;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_sem_init(&pool_sem, 0));
+
+  memset(&options, 0, sizeof(options));
+  options.nthreads = 1;
+  options.name = "test-pool";
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(pool.nthreads == 1);
+
+  ASSERT(NULL == uv_loop_get_threadpool(loop, UV_WORK_CPU));
+  ASSERT(UV_EINVAL == uv_loop_set_threadpool(loop, UV_WORK_KIND_MAX, &pool));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+  ASSERT(&pool == uv_loop_get_threadpool(loop, UV_WORK_CPU));
+  ASSERT(NULL == uv_loop_get_threadpool(loop, UV_WORK_FAST_IO));
+
+  reqs[0].data = &pool_threads[0];
+  reqs[1].data = &pool_threads[1];
+  ASSERT(0 == uv_queue_work(loop, &reqs[0], pool_work_cb, pool_after_work_cb));
+  ASSERT(0 == uv_queue_work(loop, &reqs[1], pool_work_cb, pool_after_work_cb));
+  ASSERT(0 == uv_fs_stat(loop, &stat_req, ".", stat_cb));
+
+  ASSERT(UV_EBUSY == uv_threadpool_close(&pool));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(stat_cb_count == 1);
+  ASSERT(pool_work_cb_count == 2);
+  ASSERT(pool_after_work_cb_count == 2);
+  ASSERT(uv_thread_equal(&pool_threads[0], &pool_threads[1]));
+
+  /* Still routed to by the default loop. */
+  ASSERT(UV_EBUSY == uv_threadpool_close(&pool));
+
+  /* Work whose completion callback hasn't run yet keeps the pool too. */
+  ASSERT(0 == uv_queue_work(loop, &reqs[1], pool_work_cb, pool_after_work_cb));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(UV_EBUSY == uv_threadpool_close(&pool));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(pool_after_work_cb_count == 3);
+
+  /* Closing a loop drops its routes too. */
+  ASSERT(0 == uv_loop_init(&other));
+  ASSERT(0 == uv_loop_set_threadpool(&other, UV_WORK_SLOW_IO, &pool));
+  ASSERT(UV_EBUSY == uv_threadpool_close(&pool));
+  ASSERT(0 == uv_loop_close(&other));
+
+  ASSERT(0 == uv_threadpool_close(&pool));
+  ASSERT(pool.nthreads == 0);
+  ASSERT(UV_EINVAL == uv_threadpool_close(&pool));
+  ASSERT(UV_EINVAL == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+
+  uv_sem_destroy(&pool_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define STEAL_THREADS 4
+#define STEAL_WORK 1000
+
+static uv_mutex_t steal_mutex;
+static uv_sem_t steal_started;
+static uv_sem_t steal_release;
+static int steal_work_cb_count;
+static int steal_after_work_cb_count;
+static int steal_cancelled_count;
+static int steal_getaddrinfo_cb_count;
+
+
+static void steal_work_cb(uv_work_t* req) {
+  uv_mutex_lock(&steal_mutex);
+  steal_work_cb_count++;
+  uv_mutex_unlock(&steal_mutex);
+}
+
+
+static void steal_block_cb(uv_work_t* req) {
+  uv_sem_post(&steal_started);
+  uv_sem_wait(&steal_release);
+}
+
+
+static void steal_after_work_cb(uv_work_t* req, int status) {
+  if (status == UV_ECANCELED) {
+    steal_cancelled_count++;
+    return;
+  }
+
+  ASSERT(status == 0);
+  steal_after_work_cb_count++;
+}
+
+
+static void steal_getaddrinfo_cb(uv_getaddrinfo_t* req,
+                                 int status,
+                                 struct addrinfo* res) {
+  uv_freeaddrinfo(res);
+  steal_getaddrinfo_cb_count++;
+}
+
+
+TEST_IMPL(threadpool_work_stealing) {
+  uv_threadpool_options_t options;
+  uv_getaddrinfo_t getaddrinfo_reqs[4];
+  uv_work_t block_reqs[STEAL_THREADS];
+  uv_work_t cancel_req;
+  uv_work_t* reqs;
+  uv_loop_t* loop;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_mutex_init(&steal_mutex));
+  ASSERT(0 == uv_sem_init(&steal_started, 0));
+  ASSERT(0 == uv_sem_init(&steal_release, 0));
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREADPOOL_WORK_STEALING;
+  options.nthreads = STEAL_THREADS;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_SLOW_IO, &pool));
+
+  /* Occupy every thread, so the next item stays queued and can be
+   * cancelled.
+   */
+  for (i = 0; i < STEAL_THREADS; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              block_reqs + i,
+                              steal_block_cb,
+                              steal_after_work_cb));
+  for (i = 0; i < STEAL_THREADS; i++)
+    uv_sem_wait(&steal_started);
+
+  ASSERT(0 == uv_queue_work(loop,
+                            &cancel_req,
+                            steal_work_cb,
+                            steal_after_work_cb));
+  ASSERT(0 == uv_cancel((uv_req_t*) &cancel_req));
+
+  for (i = 0; i < STEAL_THREADS; i++)
+    uv_sem_post(&steal_release);
+
+  reqs = malloc(STEAL_WORK * sizeof(*reqs));
+  ASSERT(reqs != NULL);
+  for (i = 0; i < STEAL_WORK; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              reqs + i,
+                              steal_work_cb,
+                              steal_after_work_cb));
+
+  for (i = 0; i < ARRAY_SIZE(getaddrinfo_reqs); i++)
+    ASSERT(0 == uv_getaddrinfo(loop,
+                               getaddrinfo_reqs + i,
+                               steal_getaddrinfo_cb,
+                               "localhost",
+                               NULL,
+                               NULL));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(steal_cancelled_count == 1);
+  ASSERT(steal_work_cb_count == STEAL_WORK);
+  ASSERT(steal_after_work_cb_count == STEAL_WORK + STEAL_THREADS);
+  ASSERT(steal_getaddrinfo_cb_count == ARRAY_SIZE(getaddrinfo_reqs));
+
+  /* The pool can't be closed until the loop has run the completion
+   * callbacks of the work that was queued before.
+   */
+  for (i = 0; i < STEAL_WORK; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              reqs + i,
+                              steal_work_cb,
+                              steal_after_work_cb));
+
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_SLOW_IO, NULL));
+  ASSERT(UV_EBUSY == uv_threadpool_close(&pool));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(steal_work_cb_count == 2 * STEAL_WORK);
+  ASSERT(steal_after_work_cb_count == 2 * STEAL_WORK + STEAL_THREADS);
+  ASSERT(0 == uv_threadpool_close(&pool));
+
+  free(reqs);
+  uv_sem_destroy(&steal_release);
+  uv_sem_destroy(&steal_started);
+  uv_mutex_destroy(&steal_mutex);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define ELASTIC_THREADS 4
+
+static uv_barrier_t elastic_barrier;
+static int elastic_after_work_cb_count;
+
+
+static void elastic_work_cb(uv_work_t* req) {
+  /* Only returns once every item runs on a thread of its own. */
+  uv_barrier_wait(&elastic_barrier);
+}
+
+
+static void elastic_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  elastic_after_work_cb_count++;
+}
+
+
+static void wait_for_threads(unsigned int n) {
+  unsigned int i;
+
+  for (i = 0; i < 500; i++) {
+    if (uv_threadpool_running_threads(&pool) == n)
+      return;
+    uv_sleep(10);
+  }
+
+  ASSERT(0 && "timed out waiting for the pool to resize");
+}
+
+
+TEST_IMPL(threadpool_elastic) {
+  uv_threadpool_options_t options;
+  uv_work_t reqs[ELASTIC_THREADS];
+  uv_loop_t* loop;
+  unsigned int i;
+
+  loop = uv_default_loop();
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREADPOOL_ELASTIC | UV_THREADPOOL_WORK_STEALING;
+  ASSERT(UV_EINVAL == uv_threadpool_init(&pool, &options));
+
+  options.flags = UV_THREADPOOL_ELASTIC;
+  options.nthreads = ELASTIC_THREADS;
+  options.min_threads = ELASTIC_THREADS + 1;
+  ASSERT(UV_EINVAL == uv_threadpool_init(&pool, &options));
+
+  options.min_threads = 0;
+  options.slow_io_percent = 101;
+  ASSERT(UV_EINVAL == uv_threadpool_init(&pool, &options));
+
+  options.slow_io_percent = 0;
+  options.idle_timeout_ms = 50;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(pool.nthreads == ELASTIC_THREADS);
+  ASSERT(0 == uv_threadpool_running_threads(&pool));
+
+  /* The pool grows to one thread per item. */
+  ASSERT(0 == uv_barrier_init(&elastic_barrier, ELASTIC_THREADS));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+  for (i = 0; i < ELASTIC_THREADS; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              reqs + i,
+                              elastic_work_cb,
+                              elastic_after_work_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(elastic_after_work_cb_count == ELASTIC_THREADS);
+  uv_barrier_destroy(&elastic_barrier);
+
+  /* And shrinks back once the threads are idle. */
+  wait_for_threads(0);
+
+  ASSERT(UV_EINVAL == uv_threadpool_set_limits(&pool, 3, 2));
+  ASSERT(UV_EINVAL == uv_threadpool_set_limits(&pool, 0, 0));
+
+  ASSERT(0 == uv_threadpool_set_limits(&pool, 2, 3));
+  ASSERT(pool.nthreads == 3);
+  ASSERT(2 == uv_threadpool_running_threads(&pool));
+
+  ASSERT(0 == uv_threadpool_set_limits(&pool, 0, 1));
+  wait_for_threads(0);
+
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_threadpool_close(&pool));
+
+  /* The global pool starts its threads on demand too. */
+  ASSERT(0 == uv_threadpool_set_limits(NULL, 0, ELASTIC_THREADS));
+  ASSERT(0 == uv_barrier_init(&elastic_barrier, ELASTIC_THREADS));
+  for (i = 0; i < ELASTIC_THREADS; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              reqs + i,
+                              elastic_work_cb,
+                              elastic_after_work_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(elastic_after_work_cb_count == 2 * ELASTIC_THREADS);
+  uv_barrier_destroy(&elastic_barrier);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define PRIORITY_WORK 3
+#define STARVE_WORK 20
+
+static uv_sem_t priority_started;
+static uv_sem_t priority_release;
+static uv_work_t* priority_order[3 * PRIORITY_WORK + STARVE_WORK + 1];
+static unsigned int priority_count;
+static int priority_timedout_count;
+
+
+static void priority_block_cb(uv_work_t* req) {
+  uv_sem_post(&priority_started);
+  uv_sem_wait(&priority_release);
+}
+
+
+/* The pool has a single thread, so these don't race. */
+static void priority_work_cb(uv_work_t* req) {
+  ASSERT(priority_count < ARRAY_SIZE(priority_order));
+  priority_order[priority_count++] = req;
+}
+
+
+static void priority_after_work_cb(uv_work_t* req, int status) {
+  if (status == UV_ETIMEDOUT) {
+    priority_timedout_count++;
+    return;
+  }
+
+  ASSERT(status == 0);
+}
+
+
+static void priority_queue(uv_loop_t* loop,
+                           uv_work_t* req,
+                           uv_work_priority priority,
+                           uint64_t timeout) {
+  uv_work_options_t options;
+
+  memset(&options, 0, sizeof(options));
+  options.priority = priority;
+  options.timeout = timeout;
+  ASSERT(0 == uv_queue_work_ex(loop,
+                               req,
+                               &options,
+                               priority_work_cb,
+                               priority_after_work_cb));
+}
+
+
+static void priority_block(uv_loop_t* loop, uv_work_t* req) {
+  ASSERT(0 == uv_queue_work(loop,
+                            req,
+                            priority_block_cb,
+                            priority_after_work_cb));
+  uv_sem_wait(&priority_started);
+}
+
+
+TEST_IMPL(threadpool_priority) {
+  uv_threadpool_options_t options;
+  uv_work_options_t work_options;
+  uv_work_t reqs[3][PRIORITY_WORK];
+  uv_work_t starve_reqs[STARVE_WORK];
+  uv_work_t expired_req;
+  uv_work_t block_req;
+  uv_work_t low_req;
+  uv_loop_t* loop;
+  unsigned int i;
+  unsigned int p;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_sem_init(&priority_started, 0));
+  ASSERT(0 == uv_sem_init(&priority_release, 0));
+
+  memset(&work_options, 0, sizeof(work_options));
+  work_options.priority = (uv_work_priority) 42;
+  ASSERT(UV_EINVAL == uv_queue_work_ex(loop,
+                                       &block_req,
+                                       &work_options,
+                                       priority_work_cb,
+                                       NULL));
+
+  memset(&options, 0, sizeof(options));
+  options.nthreads = 1;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+
+  /* Queue from low to high behind a blocked thread, they run high to low. */
+  priority_block(loop, &block_req);
+  for (p = 3; p-- > 0;)
+    for (i = 0; i < PRIORITY_WORK; i++)
+      priority_queue(loop, &reqs[p][i], (uv_work_priority) p, 0);
+  uv_sem_post(&priority_release);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(priority_count == 3 * PRIORITY_WORK);
+  for (p = 0; p < 3; p++)
+    for (i = 0; i < PRIORITY_WORK; i++)
+      ASSERT(priority_order[p * PRIORITY_WORK + i] == &reqs[p][i]);
+
+  /* Low priority work isn't starved by a stream of high priority work. */
+  priority_count = 0;
+  priority_block(loop, &block_req);
+  priority_queue(loop, &low_req, UV_WORK_PRIORITY_LOW, 0);
+  for (i = 0; i < STARVE_WORK; i++)
+    priority_queue(loop, starve_reqs + i, UV_WORK_PRIORITY_HIGH, 0);
+  uv_sem_post(&priority_release);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(priority_count == STARVE_WORK + 1);
+  for (i = 0; i < STARVE_WORK; i++)
+    if (priority_order[i] == &low_req)
+      break;
+  ASSERT(i > 0);
+  ASSERT(i < STARVE_WORK);
+
+  /* Work that waited past its deadline completes without running. */
+  priority_count = 0;
+  priority_block(loop, &block_req);
+  priority_queue(loop, &expired_req, UV_WORK_PRIORITY_HIGH, 1);
+  priority_queue(loop, &low_req, UV_WORK_PRIORITY_LOW, 60 * 1000);
+  uv_sleep(20);
+  uv_sem_post(&priority_release);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(priority_timedout_count == 1);
+  ASSERT(priority_count == 1);
+  ASSERT(priority_order[0] == &low_req);
+
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_threadpool_close(&pool));
+  uv_sem_destroy(&priority_release);
+  uv_sem_destroy(&priority_started);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define BATCH_WORK 100
+#define BATCH_CANCEL 10
+
+static uv_mutex_t batch_mutex;
+static uv_sem_t batch_started;
+static uv_sem_t batch_release;
+static uv_work_batch_t batch;
+static int batch_work_cb_count;
+static int batch_after_work_cb_count;
+static int batch_cancelled_count;
+static int batch_cb_count;
+
+
+static void batch_block_cb(uv_work_t* req) {
+  uv_sem_post(&batch_started);
+  uv_sem_wait(&batch_release);
+}
+
+
+static void batch_work_cb(uv_work_t* req) {
+  uv_mutex_lock(&batch_mutex);
+  batch_work_cb_count++;
+  uv_mutex_unlock(&batch_mutex);
+}
+
+
+static void batch_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(batch_cb_count == 0);
+  if (status == UV_ECANCELED) {
+    batch_cancelled_count++;
+    return;
+  }
+
+  ASSERT(status == 0);
+  batch_after_work_cb_count++;
+}
+
+
+static void batch_cb(uv_work_batch_t* b) {
+  ASSERT(b == &batch);
+  ASSERT(b->data == &batch_cb_count);
+  ASSERT(b->nreqs == BATCH_WORK);
+  ASSERT(batch_after_work_cb_count + batch_cancelled_count == BATCH_WORK);
+  batch_cb_count++;
+}
+
+
+static void run_batch(uv_loop_t* loop, unsigned int flags) {
+  uv_threadpool_options_t options;
+  uv_work_t* reqs[BATCH_WORK];
+  uv_work_t block_req;
+  unsigned int i;
+
+  batch_work_cb_count = 0;
+  batch_after_work_cb_count = 0;
+  batch_cancelled_count = 0;
+  batch_cb_count = 0;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nthreads = 1;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+
+  for (i = 0; i < BATCH_WORK; i++) {
+    reqs[i] = malloc(sizeof(*reqs[i]));
+    ASSERT(reqs[i] != NULL);
+  }
+
+  /* Keep the only thread busy, so the batch stays queued. */
+  ASSERT(0 == uv_queue_work(loop, &block_req, batch_block_cb, NULL));
+  uv_sem_wait(&batch_started);
+
+  batch.data = &batch_cb_count;
+  ASSERT(0 == uv_queue_work_batch(loop,
+                                  reqs,
+                                  BATCH_WORK,
+                                  NULL,
+                                  batch_work_cb,
+                                  batch_after_work_cb,
+                                  &batch,
+                                  batch_cb));
+  for (i = 0; i < BATCH_CANCEL; i++)
+    ASSERT(0 == uv_cancel((uv_req_t*) reqs[2 * i]));
+  uv_sem_post(&batch_release);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(batch_work_cb_count == BATCH_WORK - BATCH_CANCEL);
+  ASSERT(batch_after_work_cb_count == BATCH_WORK - BATCH_CANCEL);
+  ASSERT(batch_cancelled_count == BATCH_CANCEL);
+  ASSERT(batch_cb_count == 1);
+  ASSERT(batch.nfailed == BATCH_CANCEL);
+
+  /* Without a batch the requests complete one by one. */
+  ASSERT(0 == uv_queue_work_batch(loop,
+                                  reqs,
+                                  BATCH_WORK,
+                                  NULL,
+                                  batch_work_cb,
+                                  NULL,
+                                  NULL,
+                                  NULL));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(batch_work_cb_count == 2 * BATCH_WORK - BATCH_CANCEL);
+  ASSERT(batch_cb_count == 1);
+
+  for (i = 0; i < BATCH_WORK; i++)
+    free(reqs[i]);
+
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_threadpool_close(&pool));
+}
+
+
+TEST_IMPL(threadpool_batch) {
+  uv_work_t* reqs[1];
+  uv_work_t req;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_mutex_init(&batch_mutex));
+  ASSERT(0 == uv_sem_init(&batch_started, 0));
+  ASSERT(0 == uv_sem_init(&batch_release, 0));
+
+  reqs[0] = &req;
+  ASSERT(UV_EINVAL == uv_queue_work_batch(loop, reqs, 0, NULL,
+                                          batch_work_cb, NULL, NULL, NULL));
+  ASSERT(UV_EINVAL == uv_queue_work_batch(loop, reqs, 1, NULL,
+                                          NULL, NULL, NULL, NULL));
+  ASSERT(UV_EINVAL == uv_queue_work_batch(loop, reqs, 1, NULL,
+                                          batch_work_cb, NULL, NULL, batch_cb));
+
+  run_batch(loop, 0);
+  run_batch(loop, UV_THREADPOOL_WORK_STEALING);
+  /* Spinning threads take work without being woken up. */
+  run_batch(loop, UV_THREADPOOL_SPIN);
+  run_batch(loop, UV_THREADPOOL_WORK_STEALING | UV_THREADPOOL_SPIN);
+
+  uv_sem_destroy(&batch_release);
+  uv_sem_destroy(&batch_started);
+  uv_mutex_destroy(&batch_mutex);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define METRICS_WORK 10
+
+static uv_sem_t metrics_started;
+static uv_sem_t metrics_release;
+static uv_work_t* metrics_block_req;
+static uv_work_t* metrics_cancel_req;
+static int metrics_timing_cb_count;
+static int metrics_cancelled_count;
+static int metrics_stat_cb_count;
+
+
+static void metrics_block_cb(uv_work_t* req) {
+  uv_sem_post(&metrics_started);
+  uv_sem_wait(&metrics_release);
+}
+
+
+static void metrics_work_cb(uv_work_t* req) {
+}
+
+
+static void metrics_after_work_cb(uv_work_t* req, int status) {
+  if (status == UV_ECANCELED)
+    metrics_cancelled_count++;
+  else
+    ASSERT(status == 0);
+}
+
+
+static void metrics_stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  metrics_stat_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void metrics_timing_cb(uv_req_t* req, const uv_work_timing_t* timing) {
+  /* Runs before the completion callback of the request. */
+  if (req->type == UV_FS) {
+    ASSERT(timing->kind == UV_WORK_FAST_IO);
+    ASSERT(metrics_stat_cb_count == 0);
+  } else {
+    ASSERT(req->type == UV_WORK);
+    ASSERT(timing->kind == UV_WORK_CPU);
+  }
+
+  /* Everything queued behind the blocked request waited for it, except for
+   * the request that was cancelled before.
+   */
+  if (req == (uv_req_t*) metrics_block_req)
+    ASSERT(timing->run_time >= 10 * 1000 * 1000);
+  else if (req == (uv_req_t*) metrics_cancel_req)
+    ASSERT(timing->run_time == 0);
+  else
+    ASSERT(timing->queue_time >= 10 * 1000 * 1000);
+
+  metrics_timing_cb_count++;
+}
+
+
+static uint64_t histogram_sum(const uv_work_histogram_t* h) {
+  uint64_t sum;
+  unsigned int i;
+
+  sum = 0;
+  for (i = 0; i < UV_WORK_HISTOGRAM_BUCKETS; i++)
+    sum += h->buckets[i];
+
+  return sum;
+}
+
+
+TEST_IMPL(threadpool_metrics) {
+  uv_threadpool_options_t options;
+  uv_threadpool_metrics_t metrics;
+  uv_work_t reqs[METRICS_WORK];
+  uv_work_t block_req;
+  uv_work_t cancel_req;
+  uv_fs_t stat_req;
+  uv_loop_t* loop;
+  unsigned int i;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_sem_init(&metrics_started, 0));
+  ASSERT(0 == uv_sem_init(&metrics_release, 0));
+  metrics_block_req = &block_req;
+  metrics_cancel_req = &cancel_req;
+
+  ASSERT(UV_EINVAL == uv_threadpool_metrics(NULL, NULL));
+  ASSERT(0 == uv_threadpool_metrics(NULL, &metrics));
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREADPOOL_ENABLE_METRICS;
+  options.nthreads = 1;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_FAST_IO, &pool));
+  ASSERT(0 == uv_loop_set_work_timing_cb(loop, metrics_timing_cb));
+
+  ASSERT(0 == uv_queue_work(loop,
+                            &block_req,
+                            metrics_block_cb,
+                            metrics_after_work_cb));
+  uv_sem_wait(&metrics_started);
+
+  for (i = 0; i < METRICS_WORK; i++)
+    ASSERT(0 == uv_queue_work(loop,
+                              reqs + i,
+                              metrics_work_cb,
+                              metrics_after_work_cb));
+  ASSERT(0 == uv_queue_work(loop,
+                            &cancel_req,
+                            metrics_work_cb,
+                            metrics_after_work_cb));
+  ASSERT(0 == uv_fs_stat(loop, &stat_req, ".", metrics_stat_cb));
+
+  ASSERT(0 == uv_threadpool_metrics(&pool, &metrics));
+  ASSERT(metrics.queued == METRICS_WORK + 2);
+  ASSERT(metrics.slow_io_queued == 0);
+  ASSERT(metrics.slow_io_running == 0);
+  ASSERT(metrics.idle_threads == 0);
+  ASSERT(metrics.threads == 1);
+  ASSERT(metrics.run_time[UV_WORK_CPU].count == 0);
+
+  ASSERT(0 == uv_cancel((uv_req_t*) &cancel_req));
+  uv_sleep(10);
+  uv_sem_post(&metrics_release);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(metrics_cancelled_count == 1);
+  ASSERT(metrics_stat_cb_count == 1);
+  ASSERT(metrics_timing_cb_count == METRICS_WORK + 3);
+
+  ASSERT(0 == uv_threadpool_metrics(&pool, &metrics));
+  ASSERT(metrics.queued == 0);
+
+  /* Cancelled work never ran and isn't counted. */
+  ASSERT(metrics.queue_time[UV_WORK_CPU].count == METRICS_WORK + 1);
+  ASSERT(metrics.run_time[UV_WORK_CPU].count == METRICS_WORK + 1);
+  ASSERT(histogram_sum(&metrics.queue_time[UV_WORK_CPU]) == METRICS_WORK + 1);
+  ASSERT(metrics.run_time[UV_WORK_CPU].max >= 10 * 1000 * 1000);
+  ASSERT(metrics.queue_time[UV_WORK_FAST_IO].count == 1);
+  ASSERT(metrics.queue_time[UV_WORK_FAST_IO].max >= 10 * 1000 * 1000);
+  ASSERT(metrics.run_time[UV_WORK_SLOW_IO].count == 0);
+
+  /* 10 ms is somewhere between 2^13 and 2^14 us. */
+  ASSERT(metrics.run_time[UV_WORK_CPU].buckets[14] +
+         metrics.run_time[UV_WORK_CPU].buckets[15] >= 1);
+
+  ASSERT(0 == uv_loop_set_work_timing_cb(loop, NULL));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_FAST_IO, NULL));
+  ASSERT(0 == uv_threadpool_close(&pool));
+  uv_sem_destroy(&metrics_release);
+  uv_sem_destroy(&metrics_started);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define PIN_WORK 64
+
+static int pin_mask_size;
+static int pin_pinned;
+static uv_mutex_t pin_mutex;
+
+
+static void pin_work_cb(uv_work_t* req) {
+  uv_thread_t self;
+  char* mask;
+  int n;
+  int i;
+
+  mask = malloc(pin_mask_size);
+  ASSERT(mask != NULL);
+
+  self = uv_thread_self();
+  ASSERT(0 == uv_thread_getaffinity(&self, mask, pin_mask_size));
+
+  n = 0;
+  for (i = 0; i < pin_mask_size; i++)
+    n += mask[i] != 0;
+  ASSERT(mask[uv_thread_getcpu()]);
+
+  uv_mutex_lock(&pin_mutex);
+  pin_pinned += n == 1;
+  uv_mutex_unlock(&pin_mutex);
+
+  free(mask);
+}
+
+
+static void pin_after_work_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  after_work_cb_count++;
+}
+
+
+static void run_pinned(uv_loop_t* loop, unsigned int flags) {
+  uv_threadpool_options_t options;
+  uv_work_t reqs[PIN_WORK];
+  unsigned int i;
+
+  memset(&options, 0, sizeof(options));
+  options.flags = flags;
+  options.nthreads = 3;
+  ASSERT(0 == uv_threadpool_init(&pool, &options));
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, &pool));
+
+  pin_pinned = 0;
+  after_work_cb_count = 0;
+  for (i = 0; i < PIN_WORK; i++)
+    ASSERT(0 == uv_queue_work(loop, reqs + i, pin_work_cb, pin_after_work_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(after_work_cb_count == PIN_WORK);
+  ASSERT(pin_pinned == PIN_WORK);
+
+  ASSERT(0 == uv_loop_set_threadpool(loop, UV_WORK_CPU, NULL));
+  ASSERT(0 == uv_threadpool_close(&pool));
+}
+
+
+TEST_IMPL(threadpool_pin_threads) {
+  uv_threadpool_options_t options;
+  uv_loop_t* loop;
+
+  pin_mask_size = uv_cpumask_size();
+  if (pin_mask_size < 0)
+    RETURN_SKIP("Thread affinity is not supported on this platform");
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_mutex_init(&pin_mutex));
+
+  /* Work only goes to threads on a node with UV_THREADPOOL_WORK_STEALING. */
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_THREADPOOL_NUMA_LOCAL;
+  ASSERT(UV_EINVAL == uv_threadpool_init(&pool, &options));
+
+  run_pinned(loop, UV_THREADPOOL_PIN_THREADS);
+  run_pinned(loop, UV_THREADPOOL_PIN_THREADS | UV_THREADPOOL_ELASTIC);
+  run_pinned(loop, UV_THREADPOOL_WORK_STEALING | UV_THREADPOOL_NUMA_LOCAL);
+
+  uv_mutex_destroy(&pin_mutex);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -341,3 +341,214 @@ TEST_IMPL(timer_early_check) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static int wheel_order[8];
+static int wheel_cb_called;
+
+
+static void wheel_cb(uv_timer_t* handle) {
+  wheel_order[wheel_cb_called++] = (int) (intptr_t) handle->data;
+}
+
+
+TEST_IMPL(timer_wheel) {
+  static const uint64_t timeouts[] = { 130, 65, 1, 65, 130, 0, 65, 1 };
+  static const int expected[] = { 5, 2, 7, 1, 6, 0, 4 };
+  uv_timer_t handles[8];
+  uv_timer_t far_handle;
+  uv_loop_t loop;
+  int timeout;
+  int i;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_timer_init(&loop, &far_handle));
+
+  /* Timers can't move between the heap and the wheel. */
+  ASSERT(0 == uv_timer_start(&far_handle, wheel_cb, 10000, 0));
+  ASSERT(UV_EBUSY == uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+  ASSERT(0 == uv_timer_stop(&far_handle));
+  ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+  ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  /* A timer on a high level of the wheel still sets the poll timeout. */
+  ASSERT(0 == uv_timer_start(&far_handle, wheel_cb, 10000, 0));
+  timeout = uv_backend_timeout(&loop);
+  ASSERT(timeout > 9900 && timeout <= 10000);
+  ASSERT(0 == uv_timer_stop(&far_handle));
+
+  /* Timers with the same due time run in the order they were started, also
+   * after being cascaded from a higher level.
+   */
+  for (i = 0; i < 8; i++) {
+    ASSERT(0 == uv_timer_init(&loop, handles + i));
+    handles[i].data = (void*) (intptr_t) i;
+    ASSERT(0 == uv_timer_start(handles + i, wheel_cb, timeouts[i], 0));
+  }
+
+  ASSERT(0 == uv_backend_timeout(&loop));
+  ASSERT(0 == uv_timer_stop(handles + 3));
+  ASSERT(0 == uv_timer_start(&far_handle, wheel_cb, 100000, 0));
+  uv_unref((uv_handle_t*) &far_handle);
+
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(wheel_cb_called == 7);
+  for (i = 0; i < 7; i++)
+    ASSERT(wheel_order[i] == expected[i]);
+
+  /* Restarting pushes a timer back. */
+  wheel_cb_called = 0;
+  ASSERT(0 == uv_timer_start(handles + 0, wheel_cb, 1, 0));
+  ASSERT(0 == uv_timer_start(handles + 1, wheel_cb, 5, 0));
+  ASSERT(0 == uv_timer_start(handles + 0, wheel_cb, 10, 0));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(wheel_cb_called == 2);
+  ASSERT(wheel_order[0] == 1);
+  ASSERT(wheel_order[1] == 0);
+
+  for (i = 0; i < 8; i++)
+    uv_close((uv_handle_t*) (handles + i), NULL);
+  uv_close((uv_handle_t*) &far_handle, NULL);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uint64_t slack_start;
+static uint64_t slack_fired[10];
+static int slack_cb_called;
+
+
+static void slack_cb(uv_timer_t* handle) {
+  uint64_t due;
+  uint64_t now;
+
+  now = uv_now(handle->loop);
+  due = slack_start + (uintptr_t) handle->data;
+  ASSERT(now >= due);
+  slack_fired[slack_cb_called++] = now;
+}
+
+
+TEST_IMPL(timer_slack) {
+  uv_timer_t handles[10];
+  uv_loop_t loop;
+  int batches;
+  int i;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  slack_start = uv_now(&loop);
+
+  /* Staggered deadlines 1 ms apart coalesce into at most two batches, one
+   * on each side of a 64 ms boundary.
+   */
+  for (i = 0; i < 10; i++) {
+    ASSERT(0 == uv_timer_init(&loop, handles + i));
+    ASSERT(0 == uv_timer_get_slack(handles + i));
+    uv_timer_set_slack(handles + i, 100);
+    ASSERT(100 == uv_timer_get_slack(handles + i));
+    handles[i].data = (void*) (uintptr_t) (i + 1);
+    ASSERT(0 == uv_timer_start(handles + i, slack_cb, i + 1, 0));
+  }
+
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(slack_cb_called == 10);
+
+  batches = 1;
+  for (i = 1; i < 10; i++)
+    if (slack_fired[i] != slack_fired[i - 1])
+      batches++;
+  ASSERT(batches <= 2);
+
+  for (i = 0; i < 10; i++)
+    uv_close((uv_handle_t*) (handles + i), NULL);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define NS_TIMER_REPEATS 50
+
+static uint64_t ns_start;
+static int ns_cb_called;
+
+
+static void ns_cb(uv_timer_t* handle) {
+  /* Each run is scheduled 100 us after the previous one ran. */
+  ns_cb_called++;
+  ASSERT(uv_hrtime() - ns_start >= (uint64_t) ns_cb_called * 100000);
+  if (ns_cb_called == NS_TIMER_REPEATS)
+    uv_timer_stop(handle);
+}
+
+
+/* Only Linux 5.11 and newer can sleep for less than a millisecond. */
+static int can_sleep_ns(void) {
+#if defined(__linux__)
+  uv_utsname_t uname;
+  int major;
+  int minor;
+
+  ASSERT(0 == uv_os_uname(&uname));
+  ASSERT(2 == sscanf(uname.release, "%d.%d", &major, &minor));
+  return major > 5 || (major == 5 && minor >= 11);
+#else
+  return 0;
+#endif
+}
+
+
+TEST_IMPL(timer_ns) {
+  uv_timer_t handle;
+  uv_loop_t loop;
+  uint64_t elapsed;
+  int err;
+
+  ASSERT(0 == uv_loop_init(&loop));
+  ASSERT(0 == uv_timer_init(&loop, &handle));
+
+  /* Without the option, nanoseconds are rounded up to milliseconds. */
+  ASSERT(0 == uv_timer_start_ns(&handle, ns_cb, 1, 1500000));
+  ASSERT(2 == uv_timer_get_repeat(&handle));
+  ASSERT(UV_EBUSY == uv_loop_configure(&loop, UV_LOOP_USE_HRTIME));
+  ASSERT(0 == uv_timer_stop(&handle));
+
+  err = uv_loop_configure(&loop, UV_LOOP_USE_HRTIME);
+  if (err == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &handle, NULL);
+    ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+    ASSERT(0 == uv_loop_close(&loop));
+    RETURN_SKIP("Nanosecond timers are not supported on this platform");
+  }
+  ASSERT(err == 0);
+  ASSERT(UV_EINVAL == uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  /* The millisecond API keeps working. */
+  uv_timer_set_repeat(&handle, 7);
+  ASSERT(7 == uv_timer_get_repeat(&handle));
+
+  ns_start = uv_hrtime();
+  uv_update_time(&loop);
+  ASSERT(0 == uv_timer_start_ns(&handle, ns_cb, 100000, 100000));
+  ASSERT(1 == uv_timer_get_repeat(&handle));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  elapsed = uv_hrtime() - ns_start;
+
+  ASSERT(ns_cb_called == NS_TIMER_REPEATS);
+  /* Millisecond timers would need at least one millisecond per run. */
+  if (can_sleep_ns())
+    ASSERT(elapsed < NS_TIMER_REPEATS * (uint64_t) 1000000);
+
+  uv_close((uv_handle_t*) &handle, NULL);
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -15,6 +15,7 @@
         'test-active.c',
         'test-async.c',
         'test-async-null-cb.c',
+        'test-channel.c',
         'test-callback-stack.c',
         'test-callback-order.c',
         'test-close-fd.c',
@@ -63,8 +64,10 @@
         'test-loop-stop.c',
         'test-loop-time.c',
         'test-loop-configure.c',
+        'test-loop-defer.c',
         'test-walk-handles.c',
         'test-watcher-cross-stop.c',
+        'test-metrics.c',
         'test-multiple-listen.c',
         'test-osx-select.c',
         'test-pass-always.c',
@@ -115,6 +118,7 @@
         'test-tcp-connect-error-after-write.c',
         'test-tcp-shutdown-after-write.c',
         'test-tcp-flags.c',
+        'test-tcp-group.c',
         'test-tcp-connect-error.c',
         'test-tcp-connect-timeout.c',
         'test-tcp-connect6-error.c',
@@ -123,6 +127,7 @@
         'test-tcp-write-after-connect.c',
         'test-tcp-writealot.c',
         'test-tcp-write-fail.c',
+        'test-tcp-transfer.c',
         'test-tcp-try-write.c',
         'test-tcp-try-write-error.c',
         'test-tcp-unexpected-read.c',
@@ -236,12 +241,18 @@
         'benchmark-getaddrinfo.c',
         'benchmark-list.h',
         'benchmark-loop-count.c',
+        'benchmark-channel.c',
+        'benchmark-loop-defer.c',
         'benchmark-million-async.c',
+        'benchmark-tcp-transfer.c',
         'benchmark-million-timers.c',
+        'benchmark-timer-churn.c',
+        'benchmark-timer-slack.c',
         'benchmark-multi-accept.c',
         'benchmark-ping-pongs.c',
         'benchmark-pound.c',
         'benchmark-pump.c',
+        'benchmark-queue-work.c',
         'benchmark-sizes.c',
         'benchmark-spawn.c',
         'benchmark-thread.c',
@@ -69,8 +69,8 @@
         'include/uv/errno.h',
         'include/uv/threadpool.h',
         'include/uv/version.h',
+        'src/channel.c',
         'src/fs-poll.c',
-        'src/heap-inl.h',
         'src/idna.c',
         'src/idna.h',
         'src/inet.c',
@@ -79,6 +79,8 @@
         'src/strscpy.h',
         'src/threadpool.c',
         'src/timer.c',
+        'src/timer-heap.c',
+        'src/timer-wheel.c',
         'src/uv-data-getter-setters.c',
         'src/uv-common.c',
         'src/uv-common.h',
@@ -171,6 +173,7 @@
             'src/unix/spinlock.h',
             'src/unix/stream.c',
             'src/unix/tcp.c',
+            'src/unix/tcp-group.c',
             'src/unix/thread.c',
             'src/unix/tty.c',
             'src/unix/udp.c',
@@ -238,6 +241,7 @@
           'sources': [
             'src/unix/linux-core.c',
             'src/unix/linux-inotify.c',
+            'src/unix/linux-io-uring.c',
             'src/unix/linux-syscalls.c',
             'src/unix/linux-syscalls.h',
             'src/unix/procfs-exepath.c',
@@ -251,6 +255,7 @@
           'sources': [
             'src/unix/linux-core.c',
             'src/unix/linux-inotify.c',
+            'src/unix/linux-io-uring.c',
             'src/unix/linux-syscalls.c',
             'src/unix/linux-syscalls.h',
             'src/unix/pthread-fixes.c',